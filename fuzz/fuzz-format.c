@@ -0,0 +1,90 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+
+/* libFuzzer harness for os_version_format_full(). The first byte of the input
+ * selects the #OsVersionFormatFlags, and the rest is split into fields at nul
+ * bytes. The formatted report must parse back to the same fields. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+	OsVersionFormatFlags flags;
+	GPtrArray/*<owned string>*/ *fields;
+	gchar **parsed;
+	gchar *report;
+	const gchar *p, *end;
+	guint i;
+
+	if (size == 0) {
+		return 0;
+	}
+
+	flags = (data[0] & 1) ? OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8 :
+	                        OS_VERSION_FORMAT_FLAGS_NONE;
+	p = (const gchar *) data + 1;
+	end = (const gchar *) data + size;
+	fields = g_ptr_array_new_with_free_func (g_free);
+
+	while (TRUE) {
+		const gchar *field_end = memchr (p, '\0', end - p);
+
+		if (field_end == NULL) {
+			field_end = end;
+		}
+
+		g_ptr_array_add (fields, g_strndup (p, field_end - p));
+
+		if (field_end == end) {
+			break;
+		}
+
+		p = field_end + 1;
+	}
+
+	report = os_version_format_full ((const gchar * const *) fields->pdata,
+	                                 fields->len, flags);
+	parsed = os_version_parse (report, -1, NULL);
+
+	g_assert (parsed != NULL);
+	g_assert_cmpuint (g_strv_length (parsed), ==, fields->len);
+
+	for (i = 0; i < fields->len; i++) {
+		g_assert_cmpstr (parsed[i], ==, fields->pdata[i]);
+	}
+
+	g_strfreev (parsed);
+	g_free (report);
+	g_ptr_array_unref (fields);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+
+/* libFuzzer harness for os_version_parse(). Any input which parses must format
+ * back to a report which parses to the same fields, and each field must be
+ * accepted by os_version_collation_key() and os_version_compare(). */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+
+
+int
+LLVMFuzzerTestOneInput (const uint8_t *data, size_t size)
+{
+	gchar **fields, **reparsed;
+	gchar *report;
+	guint i;
+
+	fields = os_version_parse ((const gchar *) data, size, NULL);
+
+	if (fields == NULL) {
+		return 0;
+	}
+
+	report = os_version_format ((const gchar * const *) fields, -1);
+	reparsed = os_version_parse (report, -1, NULL);
+
+	g_assert (reparsed != NULL);
+	g_assert_cmpuint (g_strv_length (reparsed), ==,
+	                  g_strv_length (fields));
+
+	for (i = 0; fields[i] != NULL; i++) {
+		gchar *key;
+
+		g_assert_cmpstr (reparsed[i], ==, fields[i]);
+
+		key = os_version_collation_key (fields[i], -1);
+		g_free (key);
+
+		/* The order must be antisymmetric. */
+		if (i > 0) {
+			gint forward, backward;
+
+			forward = os_version_compare (fields[i - 1], fields[i]);
+			backward = os_version_compare (fields[i], fields[i - 1]);
+
+			g_assert_cmpint ((forward > 0) - (forward < 0), ==,
+			                 (backward < 0) - (backward > 0));
+		}
+	}
+
+	g_strfreev (reparsed);
+	g_free (report);
+	g_strfreev (fields);
+
+	return 0;
+}
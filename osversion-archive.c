@@ -0,0 +1,1657 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "osversion.h"
+#include "osversion-archive.h"
+
+
+/*
+ * Archive format
+ *
+ * An archive stores a sequence of records, each being the fields of one
+ * report. Each field position is a column, with a dictionary of the distinct
+ * values seen in it; records store a fixed-width 32-bit code per column,
+ * indexing into that dictionary. Code 0 (%OS_VERSION_ARCHIVE_CODE_ABSENT) means
+ * the record has no such field; code n refers to the nth dictionary entry.
+ *
+ * Records are grouped into blocks of up to %ARCHIVE_BLOCK_SIZE, written as
+ * soon as they fill up. Within a block, codes are stored column by column, so
+ * a scan over one field reads contiguous memory. The dictionaries and an index
+ * of the blocks and columns are written in a footer when the archive is
+ * closed:
+ * |[
+ * ArchiveHeader
+ * block 0: guint32 codes[n_columns][n_rows]
+ * …
+ * column 0: nul-terminated values; padding; guint32 offsets[n_values]
+ * …
+ * ArchiveFooter
+ * ArchiveBlock blocks[n_blocks]
+ * ArchiveColumn columns[n_columns]
+ * ArchiveTrailer
+ * ]|
+ *
+ * All integers are stored in the writer’s native byte order, so the archive
+ * can be used in place once mapped. Archives written on a machine with a
+ * different byte order are rejected.
+ */
+
+#define ARCHIVE_MAGIC 0x4156534fu  /* ‘OSVA’ */
+#define ARCHIVE_FORMAT_VERSION 1
+#define ARCHIVE_BYTE_ORDER_MARK 0x01020304u
+#define ARCHIVE_BLOCK_SIZE 65536
+
+/* Every record stores a code for every column, so a single hostile report with
+ * a huge number of fields would inflate every record after it. Real reports
+ * have a dozen or so fields. */
+#define ARCHIVE_MAX_COLUMNS 256
+
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	guint32 byte_order_mark;
+	guint32 reserved;
+} ArchiveHeader;
+
+typedef struct {
+	guint32 n_columns;
+	guint32 n_blocks;
+	guint64 n_records;
+} ArchiveFooter;
+
+typedef struct {
+	guint64 offset;
+	guint32 n_rows;
+	guint32 n_columns;  /* may be less than the archive’s n_columns */
+} ArchiveBlock;
+
+typedef struct {
+	guint64 strings_offset;
+	guint64 strings_length;
+	guint64 offsets_offset;
+	guint32 n_values;
+	guint32 reserved;
+} ArchiveColumn;
+
+typedef struct {
+	guint64 footer_offset;
+	guint32 magic;
+	guint32 reserved;
+} ArchiveTrailer;
+
+G_STATIC_ASSERT (sizeof (ArchiveHeader) == 16);
+G_STATIC_ASSERT (sizeof (ArchiveFooter) == 16);
+G_STATIC_ASSERT (sizeof (ArchiveBlock) == 16);
+G_STATIC_ASSERT (sizeof (ArchiveColumn) == 32);
+G_STATIC_ASSERT (sizeof (ArchiveTrailer) == 16);
+
+
+/*
+ * Writer
+ */
+
+typedef struct {
+	GHashTable/*<owned string, code>*/ *codes;
+	GPtrArray/*<unowned string>*/ *values;  /* indexed by code - 1 */
+	GArray/*<guint32>*/ *block_codes;  /* codes for the current block */
+} WriterColumn;
+
+struct _OsVersionArchiveWriter {
+	FILE *file;  /* NULL once closed */
+	gchar *path;
+	guint64 offset;
+	GPtrArray/*<owned WriterColumn>*/ *columns;
+	GArray/*<ArchiveBlock>*/ *blocks;
+	guint block_n_rows;
+	guint64 n_records;
+};
+
+static WriterColumn *
+writer_column_new (guint block_n_rows)
+{
+	WriterColumn *column;
+
+	column = g_slice_new0 (WriterColumn);
+	column->codes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                       NULL);
+	column->values = g_ptr_array_new ();
+	column->block_codes = g_array_sized_new (FALSE, TRUE, sizeof (guint32),
+	                                         ARCHIVE_BLOCK_SIZE);
+
+	/* Earlier records in the block did not have this field. */
+	g_array_set_size (column->block_codes, block_n_rows);
+
+	return column;
+}
+
+static void
+writer_column_free (WriterColumn *column)
+{
+	g_hash_table_unref (column->codes);
+	g_ptr_array_unref (column->values);
+	g_array_unref (column->block_codes);
+	g_slice_free (WriterColumn, column);
+}
+
+static gboolean
+writer_write (OsVersionArchiveWriter *self, gconstpointer data, gsize length,
+              GError **error)
+{
+	if (length > 0 && fwrite (data, 1, length, self->file) != length) {
+		gint errsv = errno;
+
+		g_set_error (error, G_FILE_ERROR,
+		             g_file_error_from_errno (errsv),
+		             "Error writing archive ‘%s’: %s",
+		             self->path, g_strerror (errsv));
+		return FALSE;
+	}
+
+	self->offset += length;
+
+	return TRUE;
+}
+
+/* Pad the file with zeros up to the next multiple of @alignment. */
+static gboolean
+writer_align (OsVersionArchiveWriter *self, gsize alignment, GError **error)
+{
+	static const guint8 zeros[8] = { 0, };
+	gsize padding;
+
+	padding = (alignment - (self->offset % alignment)) % alignment;
+
+	return writer_write (self, zeros, padding, error);
+}
+
+static gboolean
+writer_flush_block (OsVersionArchiveWriter *self, GError **error)
+{
+	ArchiveBlock block;
+	guint i;
+
+	if (self->block_n_rows == 0) {
+		return TRUE;
+	}
+
+	block.offset = self->offset;
+	block.n_rows = self->block_n_rows;
+	block.n_columns = self->columns->len;
+
+	for (i = 0; i < self->columns->len; i++) {
+		WriterColumn *column = g_ptr_array_index (self->columns, i);
+
+		if (!writer_write (self, column->block_codes->data,
+		                   sizeof (guint32) * self->block_n_rows,
+		                   error)) {
+			return FALSE;
+		}
+
+		g_array_set_size (column->block_codes, 0);
+	}
+
+	g_array_append_val (self->blocks, block);
+	self->block_n_rows = 0;
+
+	return TRUE;
+}
+
+/**
+ * os_version_archive_writer_new:
+ * @path: path of the archive file to create
+ * @error: return location for a #GError, or %NULL
+ *
+ * Create a new archive at @path, replacing any existing file. Records can then
+ * be added incrementally with os_version_archive_writer_add_report() or
+ * os_version_archive_writer_add_fields(); they are written out in blocks as
+ * they are added, so memory use is bounded by the size of the dictionaries.
+ * The archive is not valid until os_version_archive_writer_close() is called.
+ *
+ * Returns: (transfer full): a new #OsVersionArchiveWriter, or %NULL on error
+ *
+ * Since: UNRELEASED
+ */
+OsVersionArchiveWriter *
+os_version_archive_writer_new (const gchar *path, GError **error)
+{
+	OsVersionArchiveWriter *self;
+	ArchiveHeader header;
+	FILE *file;
+
+	g_return_val_if_fail (path != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	file = g_fopen (path, "wb");
+
+	if (file == NULL) {
+		gint errsv = errno;
+
+		g_set_error (error, G_FILE_ERROR,
+		             g_file_error_from_errno (errsv),
+		             "Error creating archive ‘%s’: %s",
+		             path, g_strerror (errsv));
+		return NULL;
+	}
+
+	self = g_slice_new0 (OsVersionArchiveWriter);
+	self->file = file;
+	self->path = g_strdup (path);
+	self->offset = 0;
+	self->columns = g_ptr_array_new_with_free_func ((GDestroyNotify) writer_column_free);
+	self->blocks = g_array_new (FALSE, FALSE, sizeof (ArchiveBlock));
+
+	memset (&header, 0, sizeof (header));
+	header.magic = ARCHIVE_MAGIC;
+	header.version = ARCHIVE_FORMAT_VERSION;
+	header.byte_order_mark = ARCHIVE_BYTE_ORDER_MARK;
+
+	if (!writer_write (self, &header, sizeof (header), error)) {
+		os_version_archive_writer_free (self);
+		return NULL;
+	}
+
+	return self;
+}
+
+/**
+ * os_version_archive_writer_add_fields:
+ * @self: an #OsVersionArchiveWriter
+ * @fields: (array length=n_fields): fields of a report, as returned by
+ *    os_version_parse()
+ * @n_fields: number of elements in @fields, or -1 if it is %NULL-terminated
+ * @error: return location for a #GError, or %NULL
+ *
+ * Append a record to the archive. Records with more than 256 fields are
+ * rejected with %OS_VERSION_ERROR_INVALID_REPORT.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_archive_writer_add_fields (OsVersionArchiveWriter *self,
+                                      const gchar * const *fields,
+                                      gssize n_fields,
+                                      GError **error)
+{
+	guint i;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (self->file != NULL, FALSE);
+	g_return_val_if_fail (fields != NULL || n_fields == 0, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (n_fields < 0) {
+		n_fields = g_strv_length ((gchar **) fields);
+	}
+
+	if (n_fields > ARCHIVE_MAX_COLUMNS) {
+		g_set_error (error, OS_VERSION_ERROR,
+		             OS_VERSION_ERROR_INVALID_REPORT,
+		             "Report has %" G_GSSIZE_FORMAT " fields; at most %u "
+		             "are supported.", n_fields, ARCHIVE_MAX_COLUMNS);
+		return FALSE;
+	}
+
+	while (self->columns->len < (guint) n_fields) {
+		g_ptr_array_add (self->columns,
+		                 writer_column_new (self->block_n_rows));
+	}
+
+	for (i = 0; i < self->columns->len; i++) {
+		WriterColumn *column = g_ptr_array_index (self->columns, i);
+		guint32 code;
+
+		if (i >= (guint) n_fields) {
+			code = OS_VERSION_ARCHIVE_CODE_ABSENT;
+		} else {
+			gpointer value;
+
+			if (g_hash_table_lookup_extended (column->codes,
+			                                  fields[i], NULL,
+			                                  &value)) {
+				code = GPOINTER_TO_UINT (value);
+			} else {
+				gchar *copy = g_strdup (fields[i]);
+
+				g_ptr_array_add (column->values, copy);
+				code = column->values->len;
+				g_hash_table_insert (column->codes, copy,
+				                     GUINT_TO_POINTER (code));
+			}
+		}
+
+		g_array_append_val (column->block_codes, code);
+	}
+
+	self->block_n_rows++;
+	self->n_records++;
+
+	if (self->block_n_rows == ARCHIVE_BLOCK_SIZE) {
+		return writer_flush_block (self, error);
+	}
+
+	return TRUE;
+}
+
+/**
+ * os_version_archive_writer_add_report:
+ * @self: an #OsVersionArchiveWriter
+ * @report: a report string, as returned by get_os_version()
+ * @length: length of @report in bytes, or -1 if it is nul-terminated
+ * @error: return location for a #GError, or %NULL
+ *
+ * Parse @report using os_version_parse() and append it to the archive.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_archive_writer_add_report (OsVersionArchiveWriter *self,
+                                      const gchar *report,
+                                      gssize length,
+                                      GError **error)
+{
+	gchar **fields;
+	gboolean success;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (report != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	fields = os_version_parse (report, length, error);
+
+	if (fields == NULL) {
+		return FALSE;
+	}
+
+	success = os_version_archive_writer_add_fields (self,
+	                                                (const gchar * const *) fields,
+	                                                -1, error);
+	g_strfreev (fields);
+
+	return success;
+}
+
+/**
+ * os_version_archive_writer_close:
+ * @self: an #OsVersionArchiveWriter
+ * @error: return location for a #GError, or %NULL
+ *
+ * Write out any outstanding records, the dictionaries and the index, and close
+ * the archive file. No more records may be added afterwards.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_archive_writer_close (OsVersionArchiveWriter *self, GError **error)
+{
+	GArray/*<ArchiveColumn>*/ *columns = NULL;
+	ArchiveFooter footer;
+	ArchiveTrailer trailer;
+	FILE *file;
+	guint i, j;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (self->file != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (!writer_flush_block (self, error)) {
+		goto error;
+	}
+
+	/* Dictionaries. */
+	columns = g_array_sized_new (FALSE, TRUE, sizeof (ArchiveColumn),
+	                             self->columns->len);
+
+	for (i = 0; i < self->columns->len; i++) {
+		WriterColumn *writer_column = g_ptr_array_index (self->columns,
+		                                                 i);
+		ArchiveColumn column;
+		guint32 offset;
+
+		memset (&column, 0, sizeof (column));
+		column.n_values = writer_column->values->len;
+		column.strings_offset = self->offset;
+
+		for (j = 0; j < writer_column->values->len; j++) {
+			const gchar *value = g_ptr_array_index (writer_column->values,
+			                                        j);
+
+			if (!writer_write (self, value, strlen (value) + 1,
+			                   error)) {
+				goto error;
+			}
+		}
+
+		column.strings_length = self->offset - column.strings_offset;
+
+		if (column.strings_length > G_MAXUINT32) {
+			g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+			             "Dictionary for column %u of archive ‘%s’ "
+			             "is too big.", i, self->path);
+			goto error;
+		}
+
+		if (!writer_align (self, sizeof (guint32), error)) {
+			goto error;
+		}
+
+		column.offsets_offset = self->offset;
+		offset = 0;
+
+		for (j = 0; j < writer_column->values->len; j++) {
+			const gchar *value = g_ptr_array_index (writer_column->values,
+			                                        j);
+
+			if (!writer_write (self, &offset, sizeof (offset),
+			                   error)) {
+				goto error;
+			}
+
+			offset += strlen (value) + 1;
+		}
+
+		g_array_append_val (columns, column);
+	}
+
+	if (!writer_align (self, sizeof (guint64), error)) {
+		goto error;
+	}
+
+	/* Index. */
+	memset (&footer, 0, sizeof (footer));
+	footer.n_columns = self->columns->len;
+	footer.n_blocks = self->blocks->len;
+	footer.n_records = self->n_records;
+
+	memset (&trailer, 0, sizeof (trailer));
+	trailer.footer_offset = self->offset;
+	trailer.magic = ARCHIVE_MAGIC;
+
+	if (!writer_write (self, &footer, sizeof (footer), error) ||
+	    !writer_write (self, self->blocks->data,
+	                   sizeof (ArchiveBlock) * self->blocks->len, error) ||
+	    !writer_write (self, columns->data,
+	                   sizeof (ArchiveColumn) * columns->len, error) ||
+	    !writer_write (self, &trailer, sizeof (trailer), error)) {
+		goto error;
+	}
+
+	g_array_unref (columns);
+
+	file = self->file;
+	self->file = NULL;
+
+	if (fclose (file) != 0) {
+		gint errsv = errno;
+
+		g_set_error (error, G_FILE_ERROR,
+		             g_file_error_from_errno (errsv),
+		             "Error closing archive ‘%s’: %s",
+		             self->path, g_strerror (errsv));
+		return FALSE;
+	}
+
+	return TRUE;
+
+error:
+	if (columns != NULL) {
+		g_array_unref (columns);
+	}
+
+	return FALSE;
+}
+
+/**
+ * os_version_archive_writer_free:
+ * @self: (transfer full): an #OsVersionArchiveWriter
+ *
+ * Free an archive writer. If os_version_archive_writer_close() has not been
+ * called, the archive file is left incomplete.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_writer_free (OsVersionArchiveWriter *self)
+{
+	g_return_if_fail (self != NULL);
+
+	if (self->file != NULL) {
+		fclose (self->file);
+	}
+
+	g_free (self->path);
+	g_ptr_array_unref (self->columns);
+	g_array_unref (self->blocks);
+	g_slice_free (OsVersionArchiveWriter, self);
+}
+
+/**
+ * os_version_archive_convert:
+ * @log_path: path of a file containing one report per line
+ * @archive_path: path of the archive file to create
+ * @n_invalid: (out) (optional): return location for the number of lines
+ *    which were skipped because they could not be parsed or had too many
+ *    fields
+ * @error: return location for a #GError, or %NULL
+ *
+ * Convert a newline-delimited log of reports, as returned by
+ * get_os_version(), to an archive. Empty lines are ignored. Lines which are
+ * rejected by os_version_archive_writer_add_report() are skipped and counted
+ * in @n_invalid, so one corrupt line does not prevent the rest of the log
+ * being converted.
+ *
+ * Returns: %TRUE on success, %FALSE if the log could not be read or the
+ *    archive could not be written
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_archive_convert (const gchar *log_path,
+                            const gchar *archive_path,
+                            guint64 *n_invalid,
+                            GError **error)
+{
+	GMappedFile *log_file;
+	OsVersionArchiveWriter *writer;
+	const gchar *p, *end;
+	guint64 line_number, n_skipped = 0;
+	gboolean success = FALSE;
+
+	g_return_val_if_fail (log_path != NULL, FALSE);
+	g_return_val_if_fail (archive_path != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	log_file = g_mapped_file_new (log_path, FALSE, error);
+
+	if (log_file == NULL) {
+		return FALSE;
+	}
+
+	writer = os_version_archive_writer_new (archive_path, error);
+
+	if (writer == NULL) {
+		g_mapped_file_unref (log_file);
+		return FALSE;
+	}
+
+	p = g_mapped_file_get_contents (log_file);
+	end = p + g_mapped_file_get_length (log_file);
+
+	for (line_number = 1; p < end; line_number++) {
+		const gchar *line_end;
+		gsize length;
+		GError *local_error = NULL;
+
+		line_end = memchr (p, '\n', end - p);
+
+		if (line_end == NULL) {
+			line_end = end;
+		}
+
+		length = line_end - p;
+
+		if (length > 0 && p[length - 1] == '\r') {
+			length--;
+		}
+
+		if (length > 0 &&
+		    !os_version_archive_writer_add_report (writer, p, length,
+		                                           &local_error)) {
+			/* Errors in the report itself leave the writer
+			 * untouched; anything else is an I/O error. */
+			if (local_error->domain == OS_VERSION_ERROR) {
+				g_debug ("%s:%" G_GUINT64_FORMAT ": %s",
+				         log_path, line_number,
+				         local_error->message);
+				g_error_free (local_error);
+				n_skipped++;
+			} else {
+				g_propagate_prefixed_error (error, local_error,
+				                            "%s:%" G_GUINT64_FORMAT ": ",
+				                            log_path,
+				                            line_number);
+				goto done;
+			}
+		}
+
+		p = line_end + 1;
+	}
+
+	success = os_version_archive_writer_close (writer, error);
+
+done:
+	os_version_archive_writer_free (writer);
+	g_mapped_file_unref (log_file);
+
+	if (n_invalid != NULL) {
+		*n_invalid = n_skipped;
+	}
+
+	return success;
+}
+
+
+/*
+ * Reader
+ */
+
+struct _OsVersionArchive {
+	GMappedFile *mapped_file;
+	const guint8 *data;
+	gsize length;
+	const ArchiveFooter *footer;
+	const ArchiveBlock *blocks;  /* array of length footer->n_blocks */
+	const ArchiveColumn *columns;  /* array of length footer->n_columns */
+};
+
+/* Check that [offset, offset + length) is within [0, limit) without
+ * overflowing. */
+static gboolean
+range_is_valid (guint64 offset, guint64 length, guint64 limit)
+{
+	return (offset <= limit && length <= limit - offset);
+}
+
+static gboolean
+archive_validate (OsVersionArchive *self)
+{
+	const ArchiveHeader *header;
+	const ArchiveTrailer *trailer;
+	guint64 index_length, n_records;
+	guint i, j;
+
+	/* The footer, index and trailer are all multiples of 8 bytes long
+	 * and 8-aligned, so a valid archive’s length is too. */
+	if (self->length < sizeof (ArchiveHeader) + sizeof (ArchiveFooter) +
+	                   sizeof (ArchiveTrailer) ||
+	    self->length % sizeof (guint64) != 0) {
+		return FALSE;
+	}
+
+	header = (const ArchiveHeader *) self->data;
+	trailer = (const ArchiveTrailer *) (self->data + self->length -
+	                                    sizeof (ArchiveTrailer));
+
+	if (header->magic != ARCHIVE_MAGIC ||
+	    header->version != ARCHIVE_FORMAT_VERSION ||
+	    header->byte_order_mark != ARCHIVE_BYTE_ORDER_MARK ||
+	    trailer->magic != ARCHIVE_MAGIC ||
+	    trailer->footer_offset % sizeof (guint64) != 0 ||
+	    !range_is_valid (trailer->footer_offset, sizeof (ArchiveFooter),
+	                     self->length - sizeof (ArchiveTrailer))) {
+		return FALSE;
+	}
+
+	self->footer = (const ArchiveFooter *) (self->data +
+	                                        trailer->footer_offset);
+	index_length = (guint64) sizeof (ArchiveBlock) * self->footer->n_blocks +
+	               (guint64) sizeof (ArchiveColumn) * self->footer->n_columns;
+
+	if (index_length != self->length - sizeof (ArchiveTrailer) -
+	                    trailer->footer_offset - sizeof (ArchiveFooter)) {
+		return FALSE;
+	}
+
+	self->blocks = (const ArchiveBlock *) (self->footer + 1);
+	self->columns = (const ArchiveColumn *) (self->blocks +
+	                                         self->footer->n_blocks);
+
+	n_records = 0;
+
+	for (i = 0; i < self->footer->n_blocks; i++) {
+		const ArchiveBlock *block = &self->blocks[i];
+
+		/* Readers may size per-block buffers for at most
+		 * %ARCHIVE_BLOCK_SIZE rows, so this must be checked even when
+		 * the block has no columns and hence no data. */
+		if (block->offset % sizeof (guint32) != 0 ||
+		    block->n_rows == 0 || block->n_rows > ARCHIVE_BLOCK_SIZE ||
+		    block->n_columns > self->footer->n_columns ||
+		    !range_is_valid (block->offset,
+		                     (guint64) sizeof (guint32) * block->n_rows *
+		                     block->n_columns,
+		                     trailer->footer_offset)) {
+			return FALSE;
+		}
+
+		n_records += block->n_rows;
+	}
+
+	if (n_records != self->footer->n_records) {
+		return FALSE;
+	}
+
+	for (i = 0; i < self->footer->n_columns; i++) {
+		const ArchiveColumn *column = &self->columns[i];
+		const gchar *strings;
+		const guint32 *offsets;
+
+		if (column->offsets_offset % sizeof (guint32) != 0 ||
+		    column->strings_length > G_MAXUINT32 ||
+		    !range_is_valid (column->strings_offset,
+		                     column->strings_length,
+		                     trailer->footer_offset) ||
+		    !range_is_valid (column->offsets_offset,
+		                     (guint64) sizeof (guint32) *
+		                     column->n_values,
+		                     trailer->footer_offset) ||
+		    (column->n_values > 0 &&
+		     (column->strings_length == 0 ||
+		      self->data[column->strings_offset +
+		                 column->strings_length - 1] != '\0'))) {
+			return FALSE;
+		}
+
+		strings = (const gchar *) self->data + column->strings_offset;
+		offsets = (const guint32 *) (self->data +
+		                             column->offsets_offset);
+
+		for (j = 0; j < column->n_values; j++) {
+			if (offsets[j] >= column->strings_length ||
+			    (j > 0 && strings[offsets[j] - 1] != '\0')) {
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/**
+ * os_version_archive_new:
+ * @path: path of an archive file written by #OsVersionArchiveWriter
+ * @error: return location for a #GError, or %NULL
+ *
+ * Open an archive for reading. The file is memory-mapped, and all data
+ * returned by the archive points directly into the mapping, so no records are
+ * copied or parsed. The file’s index is validated on opening; if it is
+ * invalid, %OS_VERSION_ERROR_INVALID_DATA is returned.
+ *
+ * Returns: (transfer full): the opened #OsVersionArchive, or %NULL on error
+ *
+ * Since: UNRELEASED
+ */
+OsVersionArchive *
+os_version_archive_new (const gchar *path, GError **error)
+{
+	OsVersionArchive *self;
+	GMappedFile *mapped_file;
+
+	g_return_val_if_fail (path != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	mapped_file = g_mapped_file_new (path, FALSE, error);
+
+	if (mapped_file == NULL) {
+		return NULL;
+	}
+
+	self = g_slice_new0 (OsVersionArchive);
+	self->mapped_file = mapped_file;
+	self->data = (const guint8 *) g_mapped_file_get_contents (mapped_file);
+	self->length = g_mapped_file_get_length (mapped_file);
+
+	if (!archive_validate (self)) {
+		g_set_error (error, OS_VERSION_ERROR,
+		             OS_VERSION_ERROR_INVALID_DATA,
+		             "Invalid archive ‘%s’.", path);
+		os_version_archive_free (self);
+
+		return NULL;
+	}
+
+	return self;
+}
+
+/**
+ * os_version_archive_free:
+ * @self: (transfer full): an #OsVersionArchive
+ *
+ * Close an archive. Any pointers returned by it become invalid.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_free (OsVersionArchive *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_mapped_file_unref (self->mapped_file);
+	g_slice_free (OsVersionArchive, self);
+}
+
+/**
+ * os_version_archive_get_n_records:
+ * @self: an #OsVersionArchive
+ *
+ * Get the number of records in the archive.
+ *
+ * Returns: number of records
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_archive_get_n_records (const OsVersionArchive *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->footer->n_records;
+}
+
+/**
+ * os_version_archive_get_n_columns:
+ * @self: an #OsVersionArchive
+ *
+ * Get the number of columns in the archive; this is the number of fields in
+ * the longest report it contains.
+ *
+ * Returns: number of columns
+ *
+ * Since: UNRELEASED
+ */
+guint
+os_version_archive_get_n_columns (const OsVersionArchive *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->footer->n_columns;
+}
+
+/**
+ * os_version_archive_get_n_blocks:
+ * @self: an #OsVersionArchive
+ *
+ * Get the number of blocks of records in the archive.
+ *
+ * Returns: number of blocks
+ *
+ * Since: UNRELEASED
+ */
+guint
+os_version_archive_get_n_blocks (const OsVersionArchive *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->footer->n_blocks;
+}
+
+/**
+ * os_version_archive_get_block_codes:
+ * @self: an #OsVersionArchive
+ * @block: index of the block
+ * @column: index of the column
+ * @n_rows: (out): return location for the number of records in the block
+ *
+ * Get the dictionary codes of @column for every record in @block. The codes
+ * point directly into the mapped archive file.
+ *
+ * If none of the records in the block have this field, %NULL is returned, and
+ * all the codes should be treated as %OS_VERSION_ARCHIVE_CODE_ABSENT.
+ *
+ * Codes are not validated when the archive is opened; callers must check
+ * them against os_version_archive_get_n_values() before use as an index.
+ *
+ * Returns: (array length=n_rows) (nullable): codes for the block
+ *
+ * Since: UNRELEASED
+ */
+const guint32 *
+os_version_archive_get_block_codes (const OsVersionArchive *self,
+                                    guint block,
+                                    guint column,
+                                    guint *n_rows)
+{
+	const ArchiveBlock *archive_block;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (block < self->footer->n_blocks, NULL);
+	g_return_val_if_fail (column < self->footer->n_columns, NULL);
+	g_return_val_if_fail (n_rows != NULL, NULL);
+
+	archive_block = &self->blocks[block];
+	*n_rows = archive_block->n_rows;
+
+	if (column >= archive_block->n_columns) {
+		return NULL;
+	}
+
+	return (const guint32 *) (self->data + archive_block->offset) +
+	       (gsize) column * archive_block->n_rows;
+}
+
+/**
+ * os_version_archive_get_n_values:
+ * @self: an #OsVersionArchive
+ * @column: index of the column
+ *
+ * Get the number of distinct values in the dictionary for @column. Valid
+ * codes for the column range from %OS_VERSION_ARCHIVE_CODE_ABSENT to this
+ * number, inclusive.
+ *
+ * Returns: number of distinct values
+ *
+ * Since: UNRELEASED
+ */
+guint32
+os_version_archive_get_n_values (const OsVersionArchive *self, guint column)
+{
+	g_return_val_if_fail (self != NULL, 0);
+	g_return_val_if_fail (column < self->footer->n_columns, 0);
+
+	return self->columns[column].n_values;
+}
+
+/**
+ * os_version_archive_get_value:
+ * @self: an #OsVersionArchive
+ * @column: index of the column
+ * @code: dictionary code
+ *
+ * Look up the field value for @code in the dictionary for @column. The
+ * returned string points directly into the mapped archive file.
+ *
+ * Returns: (nullable): the field value, or %NULL if @code is
+ *    %OS_VERSION_ARCHIVE_CODE_ABSENT
+ *
+ * Since: UNRELEASED
+ */
+const gchar *
+os_version_archive_get_value (const OsVersionArchive *self,
+                              guint column,
+                              guint32 code)
+{
+	const ArchiveColumn *archive_column;
+	const guint32 *offsets;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (column < self->footer->n_columns, NULL);
+	g_return_val_if_fail (code <= self->columns[column].n_values, NULL);
+
+	if (code == OS_VERSION_ARCHIVE_CODE_ABSENT) {
+		return NULL;
+	}
+
+	archive_column = &self->columns[column];
+	offsets = (const guint32 *) (self->data +
+	                             archive_column->offsets_offset);
+
+	return (const gchar *) self->data + archive_column->strings_offset +
+	       offsets[code - 1];
+}
+
+
+/*
+ * Queries
+ *
+ * Each predicate is evaluated once per distinct value of its column, giving a
+ * mask over the column’s dictionary codes. A query is then run block by
+ * block: each constrained column’s codes are turned into a bitmap of matching
+ * records, the bitmaps are intersected a word at a time, and the result is
+ * counted with popcount or used to select records for grouping.
+ */
+
+typedef struct {
+	guint column;
+	guint8 *mask;  /* indexed by code; length n_values + 1 */
+	guint32 n_selected;  /* number of non-zero elements in @mask */
+	guint32 selected_code;  /* the selected code, if n_selected == 1 */
+} QueryColumn;
+
+struct _OsVersionArchiveQuery {
+	const OsVersionArchive *archive;  /* unowned */
+	GArray/*<QueryColumn>*/ *columns;
+	guint64 *bitmap;  /* one bit per record in a block */
+};
+
+#define BITMAP_N_WORDS(n_rows) (((n_rows) + 63) / 64)
+
+static guint
+count_bits (guint64 word)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll (word);
+#else
+	guint n = 0;
+
+	for (; word != 0; word &= word - 1) {
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+static guint
+count_trailing_zeros (guint64 word)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll (word);
+#else
+	guint n = 0;
+
+	while ((word & 1) == 0) {
+		word >>= 1;
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+static void
+query_column_clear (QueryColumn *query_column)
+{
+	g_free (query_column->mask);
+}
+
+/**
+ * os_version_archive_query_new:
+ * @archive: an #OsVersionArchive
+ *
+ * Create a new query over @archive, initially matching all records. Add
+ * predicates to it using os_version_archive_query_add_predicate() and
+ * os_version_archive_query_add_equals(), then run it using
+ * os_version_archive_query_count() or os_version_archive_query_group_by().
+ *
+ * @archive must remain open for the lifetime of the query.
+ *
+ * Returns: (transfer full): a new #OsVersionArchiveQuery
+ *
+ * Since: UNRELEASED
+ */
+OsVersionArchiveQuery *
+os_version_archive_query_new (const OsVersionArchive *archive)
+{
+	OsVersionArchiveQuery *self;
+
+	g_return_val_if_fail (archive != NULL, NULL);
+
+	self = g_slice_new0 (OsVersionArchiveQuery);
+	self->archive = archive;
+	self->columns = g_array_new (FALSE, FALSE, sizeof (QueryColumn));
+	g_array_set_clear_func (self->columns,
+	                        (GDestroyNotify) query_column_clear);
+	self->bitmap = g_new (guint64, BITMAP_N_WORDS (ARCHIVE_BLOCK_SIZE));
+
+	return self;
+}
+
+/**
+ * os_version_archive_query_free:
+ * @self: (transfer full): an #OsVersionArchiveQuery
+ *
+ * Free a query.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_query_free (OsVersionArchiveQuery *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_array_unref (self->columns);
+	g_free (self->bitmap);
+	g_slice_free (OsVersionArchiveQuery, self);
+}
+
+static QueryColumn *
+query_get_column (OsVersionArchiveQuery *self, guint column)
+{
+	QueryColumn query_column;
+	guint i;
+
+	for (i = 0; i < self->columns->len; i++) {
+		QueryColumn *existing = &g_array_index (self->columns,
+		                                        QueryColumn, i);
+
+		if (existing->column == column) {
+			return existing;
+		}
+	}
+
+	query_column.column = column;
+	query_column.n_selected = os_version_archive_get_n_values (self->archive,
+	                                                           column) + 1;
+	query_column.mask = g_malloc (query_column.n_selected);
+	query_column.selected_code = 0;
+	memset (query_column.mask, 1, query_column.n_selected);
+
+	g_array_append_val (self->columns, query_column);
+
+	return &g_array_index (self->columns, QueryColumn,
+	                       self->columns->len - 1);
+}
+
+/**
+ * os_version_archive_query_add_predicate:
+ * @self: an #OsVersionArchiveQuery
+ * @column: index of the column to constrain
+ * @predicate: (scope call): predicate on values of the column
+ * @user_data: user data to pass to @predicate
+ *
+ * Restrict the query to records whose field in @column satisfies @predicate.
+ * Predicates are combined with a logical AND.
+ *
+ * @predicate is called immediately, once for each distinct value in the
+ * column’s dictionary (and once with %NULL for absent fields), rather than
+ * once per record.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_query_add_predicate (OsVersionArchiveQuery *self,
+                                        guint column,
+                                        OsVersionArchivePredicate predicate,
+                                        gpointer user_data)
+{
+	QueryColumn *query_column;
+	guint32 code, n_values;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (column <
+	                  os_version_archive_get_n_columns (self->archive));
+	g_return_if_fail (predicate != NULL);
+
+	query_column = query_get_column (self, column);
+	n_values = os_version_archive_get_n_values (self->archive, column);
+
+	query_column->n_selected = 0;
+
+	for (code = 0; code <= n_values; code++) {
+		if (query_column->mask[code]) {
+			const gchar *value;
+
+			value = os_version_archive_get_value (self->archive,
+			                                      column, code);
+			query_column->mask[code] = predicate (value, user_data);
+		}
+
+		if (query_column->mask[code]) {
+			query_column->n_selected++;
+			query_column->selected_code = code;
+		}
+	}
+}
+
+static gboolean
+predicate_equals (const gchar *value, gpointer user_data)
+{
+	return (g_strcmp0 (value, user_data) == 0);
+}
+
+/**
+ * os_version_archive_query_add_equals:
+ * @self: an #OsVersionArchiveQuery
+ * @column: index of the column to constrain
+ * @value: (nullable): value to match, or %NULL to match absent fields
+ *
+ * Restrict the query to records whose field in @column equals @value.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_query_add_equals (OsVersionArchiveQuery *self,
+                                     guint column,
+                                     const gchar *value)
+{
+	os_version_archive_query_add_predicate (self, column, predicate_equals,
+	                                        (gpointer) value);
+}
+
+/* Intersect self->bitmap with the records in @block matching @query_column. */
+static void
+query_filter_block (OsVersionArchiveQuery *self,
+                    const QueryColumn *query_column,
+                    guint block)
+{
+	const guint32 *codes;
+	guint n_rows, n_words, w;
+
+	codes = os_version_archive_get_block_codes (self->archive, block,
+	                                            query_column->column,
+	                                            &n_rows);
+	n_words = BITMAP_N_WORDS (n_rows);
+
+	if (codes == NULL) {
+		/* The field is absent from every record in the block. */
+		if (!query_column->mask[OS_VERSION_ARCHIVE_CODE_ABSENT]) {
+			memset (self->bitmap, 0, sizeof (guint64) * n_words);
+		}
+
+		return;
+	}
+
+	for (w = 0; w < n_words; w++) {
+		const guint32 *word_codes = codes + (gsize) w * 64;
+		guint k, n = MIN (64, n_rows - w * 64);
+		guint64 bits = 0;
+
+		if (self->bitmap[w] == 0) {
+			continue;
+		}
+
+		if (query_column->n_selected == 1) {
+			/* The common equality case: a straight compare, which
+			 * the compiler can vectorise. */
+			guint32 selected_code = query_column->selected_code;
+
+			for (k = 0; k < n; k++) {
+				bits |= (guint64) (word_codes[k] == selected_code) << k;
+			}
+		} else {
+			guint32 mask_length = os_version_archive_get_n_values (self->archive,
+			                                                       query_column->column) + 1;
+
+			for (k = 0; k < n; k++) {
+				guint32 code = word_codes[k];
+
+				bits |= (guint64) (code < mask_length &&
+				                   query_column->mask[code]) << k;
+			}
+		}
+
+		self->bitmap[w] &= bits;
+	}
+}
+
+/* Compute self->bitmap for @block, returning its number of records. */
+static guint
+query_scan_block (OsVersionArchiveQuery *self, guint block)
+{
+	guint n_rows, n_words, i;
+
+	n_rows = self->archive->blocks[block].n_rows;
+	n_words = BITMAP_N_WORDS (n_rows);
+
+	memset (self->bitmap, 0xff, sizeof (guint64) * n_words);
+
+	if (n_rows % 64 != 0) {
+		self->bitmap[n_words - 1] = (G_GUINT64_CONSTANT (1) << (n_rows % 64)) - 1;
+	}
+
+	for (i = 0; i < self->columns->len; i++) {
+		const QueryColumn *query_column = &g_array_index (self->columns,
+		                                                  QueryColumn,
+		                                                  i);
+
+		query_filter_block (self, query_column, block);
+	}
+
+	return n_rows;
+}
+
+static gboolean
+query_is_empty (OsVersionArchiveQuery *self)
+{
+	guint i;
+
+	for (i = 0; i < self->columns->len; i++) {
+		if (g_array_index (self->columns, QueryColumn,
+		                   i).n_selected == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**
+ * os_version_archive_query_count:
+ * @self: an #OsVersionArchiveQuery
+ *
+ * Count the records in the archive which match the query.
+ *
+ * Returns: number of matching records
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_archive_query_count (OsVersionArchiveQuery *self)
+{
+	guint64 count = 0;
+	guint block, n_blocks;
+
+	g_return_val_if_fail (self != NULL, 0);
+
+	if (self->columns->len == 0) {
+		return os_version_archive_get_n_records (self->archive);
+	} else if (query_is_empty (self)) {
+		return 0;
+	}
+
+	n_blocks = os_version_archive_get_n_blocks (self->archive);
+
+	for (block = 0; block < n_blocks; block++) {
+		guint n_rows, w;
+
+		n_rows = query_scan_block (self, block);
+
+		for (w = 0; w < BITMAP_N_WORDS (n_rows); w++) {
+			count += count_bits (self->bitmap[w]);
+		}
+	}
+
+	return count;
+}
+
+/**
+ * os_version_archive_query_group_by:
+ * @self: an #OsVersionArchiveQuery
+ * @column: index of the column to group by
+ * @n_groups: (out): return location for the number of groups
+ *
+ * Count the records in the archive which match the query, grouped by their
+ * value in @column. The result is indexed by dictionary code, so element 0
+ * counts records where the field is absent, and element n counts records with
+ * the value returned by os_version_archive_get_value() for code n.
+ *
+ * Returns: (transfer full) (array length=n_groups): count of matching records
+ *    per code; free with g_free()
+ *
+ * Since: UNRELEASED
+ */
+guint64 *
+os_version_archive_query_group_by (OsVersionArchiveQuery *self,
+                                   guint column,
+                                   guint32 *n_groups)
+{
+	guint64 *counts;
+	guint block, n_blocks;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (column <
+	                      os_version_archive_get_n_columns (self->archive),
+	                      NULL);
+	g_return_val_if_fail (n_groups != NULL, NULL);
+
+	*n_groups = os_version_archive_get_n_values (self->archive, column) + 1;
+	counts = g_new0 (guint64, *n_groups);
+
+	if (query_is_empty (self)) {
+		return counts;
+	}
+
+	n_blocks = os_version_archive_get_n_blocks (self->archive);
+
+	for (block = 0; block < n_blocks; block++) {
+		const guint32 *codes;
+		guint n_rows, w;
+
+		n_rows = query_scan_block (self, block);
+		codes = os_version_archive_get_block_codes (self->archive,
+		                                            block, column,
+		                                            &n_rows);
+
+		for (w = 0; w < BITMAP_N_WORDS (n_rows); w++) {
+			guint64 bits = self->bitmap[w];
+
+			if (codes == NULL) {
+				counts[OS_VERSION_ARCHIVE_CODE_ABSENT] += count_bits (bits);
+				continue;
+			}
+
+			while (bits != 0) {
+				guint32 code = codes[w * 64 + count_trailing_zeros (bits)];
+
+				if (code < *n_groups) {
+					counts[code]++;
+				}
+
+				bits &= bits - 1;
+			}
+		}
+	}
+
+	return counts;
+}
+
+
+/*
+ * Version indexes
+ *
+ * The collation key of each distinct value in a column is computed once, and
+ * the column’s codes are sorted by it. Version range predicates are then two
+ * binary searches over the sorted codes.
+ */
+
+struct _OsVersionArchiveVersionIndex {
+	const OsVersionArchive *archive;  /* unowned */
+	guint column;
+	gchar **keys;  /* indexed by code - 1; length n_codes */
+	guint32 *sorted_codes;  /* length n_codes */
+	guint32 n_codes;
+};
+
+static gint
+compare_codes_by_key (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	gchar **keys = user_data;
+	guint32 code_a = *((const guint32 *) a);
+	guint32 code_b = *((const guint32 *) b);
+	gint result;
+
+	result = strcmp (keys[code_a - 1], keys[code_b - 1]);
+
+	/* Break ties by code, for a stable order. */
+	if (result == 0) {
+		result = (code_a < code_b) ? -1 : (code_a > code_b);
+	}
+
+	return result;
+}
+
+/**
+ * os_version_archive_version_index_new:
+ * @archive: an #OsVersionArchive
+ * @column: index of a column containing version numbers
+ *
+ * Build an index of the distinct values in @column, sorted by version using
+ * os_version_collation_key(). This is proportional to the number of distinct
+ * values, not the number of records.
+ *
+ * @archive must remain open for the lifetime of the index.
+ *
+ * Returns: (transfer full): a new #OsVersionArchiveVersionIndex
+ *
+ * Since: UNRELEASED
+ */
+OsVersionArchiveVersionIndex *
+os_version_archive_version_index_new (const OsVersionArchive *archive,
+                                      guint column)
+{
+	OsVersionArchiveVersionIndex *self;
+	guint32 code;
+
+	g_return_val_if_fail (archive != NULL, NULL);
+	g_return_val_if_fail (column < os_version_archive_get_n_columns (archive),
+	                      NULL);
+
+	self = g_slice_new0 (OsVersionArchiveVersionIndex);
+	self->archive = archive;
+	self->column = column;
+	self->n_codes = os_version_archive_get_n_values (archive, column);
+	self->keys = g_new0 (gchar *, self->n_codes + 1);
+	self->sorted_codes = g_new (guint32, self->n_codes);
+
+	for (code = 1; code <= self->n_codes; code++) {
+		const gchar *value;
+
+		value = os_version_archive_get_value (archive, column, code);
+		self->keys[code - 1] = os_version_collation_key (value, -1);
+		self->sorted_codes[code - 1] = code;
+	}
+
+	g_qsort_with_data (self->sorted_codes, self->n_codes,
+	                   sizeof (*self->sorted_codes), compare_codes_by_key,
+	                   self->keys);
+
+	return self;
+}
+
+/**
+ * os_version_archive_version_index_free:
+ * @self: (transfer full): an #OsVersionArchiveVersionIndex
+ *
+ * Free a version index.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_version_index_free (OsVersionArchiveVersionIndex *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_strfreev (self->keys);
+	g_free (self->sorted_codes);
+	g_slice_free (OsVersionArchiveVersionIndex, self);
+}
+
+/**
+ * os_version_archive_version_index_get_sorted_codes:
+ * @self: an #OsVersionArchiveVersionIndex
+ * @n_codes: (out): return location for the number of codes
+ *
+ * Get the dictionary codes of the indexed column, in ascending order of
+ * version. %OS_VERSION_ARCHIVE_CODE_ABSENT is not included. This can be used
+ * to order the results of os_version_archive_query_group_by().
+ *
+ * Returns: (array length=n_codes) (transfer none): the sorted codes
+ *
+ * Since: UNRELEASED
+ */
+const guint32 *
+os_version_archive_version_index_get_sorted_codes (const OsVersionArchiveVersionIndex *self,
+                                                   guint32 *n_codes)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (n_codes != NULL, NULL);
+
+	*n_codes = self->n_codes;
+
+	return self->sorted_codes;
+}
+
+/* Find the position of the first sorted code whose key is not less than
+ * @key. */
+static guint32
+version_index_lower_bound (const OsVersionArchiveVersionIndex *self,
+                           const gchar *key)
+{
+	guint32 low = 0, high = self->n_codes;
+
+	while (low < high) {
+		guint32 mid = low + (high - low) / 2;
+
+		if (strcmp (self->keys[self->sorted_codes[mid] - 1], key) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * os_version_archive_query_add_version_range:
+ * @self: an #OsVersionArchiveQuery
+ * @index: version index for the column to constrain, over the same archive
+ *    as @self
+ * @min_version: (nullable): inclusive lower bound, or %NULL for no bound
+ * @max_version: (nullable): exclusive upper bound, or %NULL for no bound
+ *
+ * Restrict the query to records whose field in the indexed column is a
+ * version in the range [@min_version, @max_version), compared as by
+ * os_version_collation_key(). Note that this is not quite the order of
+ * os_version_compare(); see os_version_collation_key(). Records without the
+ * field do not match.
+ *
+ * For example, ‘kernel older than 5.4’ is a range with no lower bound and an
+ * upper bound of ‘5.4’.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_archive_query_add_version_range (OsVersionArchiveQuery *self,
+                                            const OsVersionArchiveVersionIndex *index,
+                                            const gchar *min_version,
+                                            const gchar *max_version)
+{
+	QueryColumn *query_column;
+	guint8 *in_range;
+	guint32 start, end, i, code;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (index->archive == self->archive);
+
+	start = 0;
+	end = index->n_codes;
+
+	if (min_version != NULL) {
+		gchar *key = os_version_collation_key (min_version, -1);
+		start = version_index_lower_bound (index, key);
+		g_free (key);
+	}
+
+	if (max_version != NULL) {
+		gchar *key = os_version_collation_key (max_version, -1);
+		end = version_index_lower_bound (index, key);
+		g_free (key);
+	}
+
+	in_range = g_malloc0 (index->n_codes + 1);
+
+	for (i = start; i < end; i++) {
+		in_range[index->sorted_codes[i]] = 1;
+	}
+
+	query_column = query_get_column (self, index->column);
+	query_column->n_selected = 0;
+
+	for (code = 0; code <= index->n_codes; code++) {
+		query_column->mask[code] &= in_range[code];
+
+		if (query_column->mask[code]) {
+			query_column->n_selected++;
+			query_column->selected_code = code;
+		}
+	}
+
+	g_free (in_range);
+}
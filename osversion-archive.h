@@ -0,0 +1,197 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_ARCHIVE_H_
+#define _OS_VERSION_ARCHIVE_H_
+
+
+/**
+ * OsVersionArchiveWriter:
+ *
+ * Writes parsed reports to an archive file. All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionArchiveWriter OsVersionArchiveWriter;
+
+/**
+ * OsVersionArchive:
+ *
+ * A read-only, memory-mapped archive of parsed reports. All the fields are
+ * private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionArchive OsVersionArchive;
+
+/**
+ * OS_VERSION_ARCHIVE_CODE_ABSENT:
+ *
+ * Dictionary code used for a field which is not present in a record, because
+ * its report had fewer fields than others in the archive.
+ *
+ * Since: UNRELEASED
+ */
+#define OS_VERSION_ARCHIVE_CODE_ABSENT 0
+
+OsVersionArchiveWriter *
+os_version_archive_writer_new (const gchar *path, GError **error);
+
+gboolean
+os_version_archive_writer_add_fields (OsVersionArchiveWriter *self,
+                                      const gchar * const *fields,
+                                      gssize n_fields,
+                                      GError **error);
+
+gboolean
+os_version_archive_writer_add_report (OsVersionArchiveWriter *self,
+                                      const gchar *report,
+                                      gssize length,
+                                      GError **error);
+
+gboolean
+os_version_archive_writer_close (OsVersionArchiveWriter *self,
+                                 GError **error);
+
+void
+os_version_archive_writer_free (OsVersionArchiveWriter *self);
+
+gboolean
+os_version_archive_convert (const gchar *log_path,
+                            const gchar *archive_path,
+                            guint64 *n_invalid,
+                            GError **error);
+
+OsVersionArchive *
+os_version_archive_new (const gchar *path, GError **error);
+
+void
+os_version_archive_free (OsVersionArchive *self);
+
+guint64
+os_version_archive_get_n_records (const OsVersionArchive *self);
+
+guint
+os_version_archive_get_n_columns (const OsVersionArchive *self);
+
+guint
+os_version_archive_get_n_blocks (const OsVersionArchive *self);
+
+const guint32 *
+os_version_archive_get_block_codes (const OsVersionArchive *self,
+                                    guint block,
+                                    guint column,
+                                    guint *n_rows);
+
+guint32
+os_version_archive_get_n_values (const OsVersionArchive *self,
+                                 guint column);
+
+const gchar *
+os_version_archive_get_value (const OsVersionArchive *self,
+                              guint column,
+                              guint32 code);
+
+
+/**
+ * OsVersionArchiveQuery:
+ *
+ * A query counting records in an #OsVersionArchive which match a set of
+ * predicates. All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionArchiveQuery OsVersionArchiveQuery;
+
+/**
+ * OsVersionArchivePredicate:
+ * @value: (nullable): a field value, or %NULL if the field is absent
+ * @user_data: user data passed to os_version_archive_query_add_predicate()
+ *
+ * Predicate on the value of a single field.
+ *
+ * Returns: %TRUE if records with this field value match, %FALSE otherwise
+ *
+ * Since: UNRELEASED
+ */
+typedef gboolean (*OsVersionArchivePredicate) (const gchar *value,
+                                               gpointer user_data);
+
+OsVersionArchiveQuery *
+os_version_archive_query_new (const OsVersionArchive *archive);
+
+void
+os_version_archive_query_free (OsVersionArchiveQuery *self);
+
+void
+os_version_archive_query_add_predicate (OsVersionArchiveQuery *self,
+                                        guint column,
+                                        OsVersionArchivePredicate predicate,
+                                        gpointer user_data);
+
+void
+os_version_archive_query_add_equals (OsVersionArchiveQuery *self,
+                                     guint column,
+                                     const gchar *value);
+
+guint64
+os_version_archive_query_count (OsVersionArchiveQuery *self);
+
+guint64 *
+os_version_archive_query_group_by (OsVersionArchiveQuery *self,
+                                   guint column,
+                                   guint32 *n_groups);
+
+
+/**
+ * OsVersionArchiveVersionIndex:
+ *
+ * An index of the values in one column of an #OsVersionArchive, sorted by
+ * version. All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionArchiveVersionIndex OsVersionArchiveVersionIndex;
+
+OsVersionArchiveVersionIndex *
+os_version_archive_version_index_new (const OsVersionArchive *archive,
+                                      guint column);
+
+void
+os_version_archive_version_index_free (OsVersionArchiveVersionIndex *self);
+
+const guint32 *
+os_version_archive_version_index_get_sorted_codes (const OsVersionArchiveVersionIndex *self,
+                                                   guint32 *n_codes);
+
+void
+os_version_archive_query_add_version_range (OsVersionArchiveQuery *self,
+                                            const OsVersionArchiveVersionIndex *index,
+                                            const gchar *min_version,
+                                            const gchar *max_version);
+
+
+#endif /* _OS_VERSION_ARCHIVE_H_ */
@@ -0,0 +1,297 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-batch.h"
+#include "osversion-private.h"
+
+
+/* Files under a root providing the same data as the fields of uname(), in the
+ * order get_os_version() reports them on Linux. The machine is only exposed
+ * by Linux 6.1 and later. */
+static const gchar * const root_field_paths[] = {
+	"proc/sys/kernel/ostype",
+	"proc/sys/kernel/osrelease",
+	"proc/sys/kernel/version",
+	"proc/sys/kernel/arch",
+};
+
+#define N_ROOT_FIELDS G_N_ELEMENTS (root_field_paths)
+
+/* Scratch space reused by each thread between probes. */
+typedef struct {
+	GString *path;
+	GString *report;
+	gchar *fields[1 + N_ROOT_FIELDS + 1];
+} ProbeBuffers;
+
+static void
+probe_buffers_free (gpointer data)
+{
+	ProbeBuffers *buffers = data;
+
+	g_string_free (buffers->report, TRUE);
+	g_string_free (buffers->path, TRUE);
+	g_slice_free (ProbeBuffers, buffers);
+}
+
+static GPrivate probe_buffers = G_PRIVATE_INIT (probe_buffers_free);
+
+static ProbeBuffers *
+get_probe_buffers (void)
+{
+	ProbeBuffers *buffers = g_private_get (&probe_buffers);
+
+	if (buffers == NULL) {
+		buffers = g_slice_new0 (ProbeBuffers);
+		buffers->path = g_string_sized_new (256);
+		buffers->report = g_string_sized_new (256);
+		g_private_set (&probe_buffers, buffers);
+	}
+
+	return buffers;
+}
+
+/* Format the report for @root into the calling thread’s report buffer, and
+ * return the buffer. It is only valid until the thread’s next probe. */
+static const GString *
+probe_root (const gchar *root)
+{
+	ProbeBuffers *buffers = get_probe_buffers ();
+	gsize i, root_length;
+
+	g_string_assign (buffers->path, root);
+
+	if (buffers->path->len == 0 ||
+	    buffers->path->str[buffers->path->len - 1] != G_DIR_SEPARATOR) {
+		g_string_append_c (buffers->path, G_DIR_SEPARATOR);
+	}
+
+	root_length = buffers->path->len;
+	buffers->fields[0] = g_strdup ("Linux");
+
+	for (i = 0; i < N_ROOT_FIELDS; i++) {
+		gchar *contents;
+		gsize length;
+
+		g_string_truncate (buffers->path, root_length);
+		g_string_append (buffers->path, root_field_paths[i]);
+
+		if (g_file_get_contents (buffers->path->str, &contents,
+		                         &length, NULL)) {
+			/* Strip the trailing newline. */
+			if (length > 0 && contents[length - 1] == '\n') {
+				contents[length - 1] = '\0';
+			}
+		} else {
+			contents = g_strdup ("Unknown");
+		}
+
+		buffers->fields[i + 1] = contents;
+	}
+
+	buffers->fields[N_ROOT_FIELDS + 1] = NULL;
+
+	g_string_truncate (buffers->report, 0);
+	os_version_append_formatted (buffers->report,
+	                             (const gchar * const *) buffers->fields,
+	                             -1, OS_VERSION_FORMAT_FLAGS_NONE);
+
+	for (i = 0; i < N_ROOT_FIELDS + 1; i++) {
+		g_clear_pointer (&buffers->fields[i], g_free);
+	}
+
+	return buffers->report;
+}
+
+/**
+ * os_version_get_for_root:
+ * @root: path of the root directory of a Linux system or snapshot
+ *
+ * Get a report for the Linux system whose root directory is @root, containing
+ * the fields which get_os_version() would return from uname() on that system.
+ * @root may be ‘/’ for the running system, a sysroot, or a test fixture. The
+ * kernel fields are read from `proc/sys/kernel` under @root, rather than from
+ * uname(). Fields which are missing are reported as ‘Unknown’.
+ *
+ * Returns: (transfer full): the report string
+ *
+ * Since: UNRELEASED
+ */
+gchar *
+os_version_get_for_root (const gchar *root)
+{
+	const GString *report;
+
+	g_return_val_if_fail (root != NULL, NULL);
+
+	report = probe_root (root);
+
+	return g_strndup (report->str, report->len);
+}
+
+typedef struct {
+	const gchar * const *roots;
+
+	GMutex lock;
+	GCond cond;
+	GString *arena;  /* lock; the nul-terminated reports, in the order
+	                  * they were probed */
+	gsize *offsets;  /* lock; of each root’s report in @arena */
+	gsize n_remaining;  /* lock */
+} Batch;
+
+typedef struct {
+	Batch *batch;
+	gsize index;
+} BatchJob;
+
+static void
+batch_job_run (gpointer data, gpointer user_data)
+{
+	BatchJob *job = data;
+	Batch *batch = job->batch;
+	const GString *report;
+
+	report = probe_root (batch->roots[job->index]);
+
+	g_mutex_lock (&batch->lock);
+
+	batch->offsets[job->index] = batch->arena->len;
+	g_string_append_len (batch->arena, report->str, report->len + 1);
+
+	if (--batch->n_remaining == 0) {
+		g_cond_signal (&batch->cond);
+	}
+
+	g_mutex_unlock (&batch->lock);
+}
+
+/* Shared between all batches, so its threads are only started once. */
+static GThreadPool *
+get_pool (void)
+{
+	static gsize pool_once = 0;
+	static GThreadPool *pool = NULL;
+
+	if (g_once_init_enter (&pool_once)) {
+		pool = g_thread_pool_new (batch_job_run, NULL,
+		                          g_get_num_processors (), FALSE,
+		                          NULL);
+		g_once_init_leave (&pool_once, 1);
+	}
+
+	return pool;
+}
+
+/**
+ * os_version_get_for_roots:
+ * @roots: (array length=n_roots): paths of root directories
+ * @n_roots: number of elements in @roots, or -1 if it is %NULL-terminated
+ *
+ * Get reports for many roots at once, as os_version_get_for_root() does for
+ * each of them. The roots are probed concurrently on a thread pool which is
+ * shared by all calls. Each thread formats reports into a buffer it reuses
+ * between probes, and copies them into a shared arena.
+ *
+ * The returned array and all the reports in it are a single allocation, so
+ * the result must be freed with g_free(), not g_strfreev().
+ *
+ * Returns: (transfer full) (array zero-terminated=1): the reports, in the
+ *    same order as @roots; free with g_free()
+ *
+ * Since: UNRELEASED
+ */
+gchar **
+os_version_get_for_roots (const gchar * const *roots,
+                          gssize n_roots)
+{
+	Batch batch;
+	BatchJob *jobs;
+	gchar **out;
+	gchar *arena;
+	gsize i, n, pointers_length;
+
+	g_return_val_if_fail (roots != NULL || n_roots == 0, NULL);
+
+	n = (n_roots < 0) ? g_strv_length ((gchar **) roots) : (gsize) n_roots;
+
+	batch.roots = roots;
+	/* Reports are typically a couple of hundred bytes. */
+	batch.arena = g_string_sized_new (n * 256);
+	batch.offsets = g_new (gsize, n);
+	batch.n_remaining = n;
+	g_mutex_init (&batch.lock);
+	g_cond_init (&batch.cond);
+	jobs = g_new (BatchJob, n);
+
+	for (i = 0; i < n; i++) {
+		jobs[i].batch = &batch;
+		jobs[i].index = i;
+	}
+
+	if (n == 1) {
+		/* Not worth a round trip to the pool. */
+		batch_job_run (&jobs[0], NULL);
+	} else if (n > 1) {
+		GThreadPool *pool = get_pool ();
+
+		for (i = 0; i < n; i++) {
+			g_thread_pool_push (pool, &jobs[i], NULL);
+		}
+
+		g_mutex_lock (&batch.lock);
+
+		while (batch.n_remaining > 0) {
+			g_cond_wait (&batch.cond, &batch.lock);
+		}
+
+		g_mutex_unlock (&batch.lock);
+	}
+
+	g_free (jobs);
+	g_cond_clear (&batch.cond);
+	g_mutex_clear (&batch.lock);
+
+	/* Pack the pointer array and the reports into one block. */
+	pointers_length = (n + 1) * sizeof (gchar *);
+	out = g_malloc (pointers_length + batch.arena->len);
+	arena = (gchar *) out + pointers_length;
+	memcpy (arena, batch.arena->str, batch.arena->len);
+
+	for (i = 0; i < n; i++) {
+		out[i] = arena + batch.offsets[i];
+	}
+
+	out[n] = NULL;
+	g_string_free (batch.arena, TRUE);
+	g_free (batch.offsets);
+
+	return out;
+}
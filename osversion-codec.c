@@ -0,0 +1,683 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-codec.h"
+
+
+/* Unsigned LEB128 variable-length integers. */
+static void
+append_varint (GByteArray *buf, guint64 value)
+{
+	do {
+		guint8 byte = value & 0x7f;
+
+		value >>= 7;
+
+		if (value != 0) {
+			byte |= 0x80;
+		}
+
+		g_byte_array_append (buf, &byte, 1);
+	} while (value != 0);
+}
+
+static gboolean
+read_varint (const guint8 **p, const guint8 *end, guint64 *value)
+{
+	guint shift;
+
+	*value = 0;
+
+	for (shift = 0; *p < end && shift < 64; shift += 7) {
+		guint8 byte = *((*p)++);
+
+		*value |= (guint64) (byte & 0x7f) << shift;
+
+		if ((byte & 0x80) == 0) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gsize
+count_fields (const gchar * const *fields, gssize n_fields)
+{
+	return (n_fields < 0) ? g_strv_length ((gchar **) fields) : (gsize) n_fields;
+}
+
+
+/*
+ * Delta encoding
+ *
+ * Most reports from a fleet differ from a typical report in only a few fields,
+ * such as the build number. A delta names a baseline report, already known to
+ * the server, and carries only the fields which differ from it:
+ * |[
+ * varint baseline_id
+ * varint n_fields
+ * varint n_changed
+ * n_changed × (varint index, varint length, length bytes)
+ * ]|
+ * Fields at indices not listed are copied from the baseline. Indices are in
+ * ascending order.
+ */
+
+/**
+ * os_version_delta_encode:
+ * @baseline_id: identifier of the baseline report, as agreed with the server
+ * @baseline_fields: (array length=n_baseline_fields): fields of the baseline
+ *    report
+ * @n_baseline_fields: number of elements in @baseline_fields, or -1 if it is
+ *    %NULL-terminated
+ * @fields: (array length=n_fields): fields of the report to encode, as returned
+ *    by os_version_parse()
+ * @n_fields: number of elements in @fields, or -1 if it is %NULL-terminated
+ *
+ * Encode a report as a delta against a baseline report, so that only the
+ * fields which differ from the baseline are sent. Decode it using
+ * os_version_delta_decode() with the same baseline fields.
+ *
+ * For a report identical to its baseline, the delta is typically three bytes,
+ * compared to several hundred for the full report string.
+ *
+ * Returns: (transfer full): the encoded delta
+ *
+ * Since: UNRELEASED
+ */
+GBytes *
+os_version_delta_encode (guint64 baseline_id,
+                         const gchar * const *baseline_fields,
+                         gssize n_baseline_fields,
+                         const gchar * const *fields,
+                         gssize n_fields)
+{
+	GByteArray *buf;
+	gsize i, n_changed;
+
+	g_return_val_if_fail (baseline_fields != NULL || n_baseline_fields == 0,
+	                      NULL);
+	g_return_val_if_fail (fields != NULL || n_fields == 0, NULL);
+
+	n_baseline_fields = count_fields (baseline_fields, n_baseline_fields);
+	n_fields = count_fields (fields, n_fields);
+
+	for (i = 0, n_changed = 0; i < (gsize) n_fields; i++) {
+		if (i >= (gsize) n_baseline_fields ||
+		    strcmp (fields[i], baseline_fields[i]) != 0) {
+			n_changed++;
+		}
+	}
+
+	buf = g_byte_array_new ();
+
+	append_varint (buf, baseline_id);
+	append_varint (buf, n_fields);
+	append_varint (buf, n_changed);
+
+	for (i = 0; i < (gsize) n_fields; i++) {
+		gsize length;
+
+		if (i < (gsize) n_baseline_fields &&
+		    strcmp (fields[i], baseline_fields[i]) == 0) {
+			continue;
+		}
+
+		length = strlen (fields[i]);
+
+		append_varint (buf, i);
+		append_varint (buf, length);
+		g_byte_array_append (buf, (const guint8 *) fields[i], length);
+	}
+
+	return g_byte_array_free_to_bytes (buf);
+}
+
+/**
+ * os_version_delta_get_baseline_id:
+ * @delta: a delta, from os_version_delta_encode()
+ * @baseline_id: (out): return location for the baseline identifier
+ * @error: return location for a #GError, or %NULL
+ *
+ * Get the identifier of the baseline report which @delta was encoded
+ * against, so its fields can be looked up before calling
+ * os_version_delta_decode().
+ *
+ * Returns: %TRUE on success, %FALSE if @delta is invalid
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_delta_get_baseline_id (GBytes *delta,
+                                  guint64 *baseline_id,
+                                  GError **error)
+{
+	const guint8 *p, *end;
+	gsize length;
+
+	g_return_val_if_fail (delta != NULL, FALSE);
+	g_return_val_if_fail (baseline_id != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	p = g_bytes_get_data (delta, &length);
+	end = p + length;
+
+	if (!read_varint (&p, end, baseline_id)) {
+		g_set_error_literal (error, OS_VERSION_ERROR,
+		                     OS_VERSION_ERROR_INVALID_DATA,
+		                     "Invalid report delta.");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * os_version_delta_decode:
+ * @delta: a delta, from os_version_delta_encode()
+ * @baseline_fields: (array length=n_baseline_fields): fields of the baseline
+ *    report identified by os_version_delta_get_baseline_id()
+ * @n_baseline_fields: number of elements in @baseline_fields, or -1 if it is
+ *    %NULL-terminated
+ * @error: return location for a #GError, or %NULL
+ *
+ * Decode a delta produced by os_version_delta_encode() back into the fields
+ * of the report. Use os_version_format() to turn them back into a report
+ * string. If @delta is invalid or does not match the baseline,
+ * %OS_VERSION_ERROR_INVALID_DATA is returned.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): the report fields; free
+ *    with g_strfreev()
+ *
+ * Since: UNRELEASED
+ */
+gchar **
+os_version_delta_decode (GBytes *delta,
+                         const gchar * const *baseline_fields,
+                         gssize n_baseline_fields,
+                         GError **error)
+{
+	const guint8 *p, *end;
+	gsize length;
+	guint64 baseline_id, n_fields, n_changed, i, next_index;
+	gchar **fields = NULL;
+
+	g_return_val_if_fail (delta != NULL, NULL);
+	g_return_val_if_fail (baseline_fields != NULL || n_baseline_fields == 0,
+	                      NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	n_baseline_fields = count_fields (baseline_fields, n_baseline_fields);
+
+	p = g_bytes_get_data (delta, &length);
+	end = p + length;
+
+	/* Each field needs at least two bytes in the delta, unless it comes
+	 * from the baseline, which bounds the allocation below. */
+	if (!read_varint (&p, end, &baseline_id) ||
+	    !read_varint (&p, end, &n_fields) ||
+	    !read_varint (&p, end, &n_changed) ||
+	    n_changed > n_fields ||
+	    n_changed > (guint64) (end - p) / 2 ||
+	    n_fields - n_changed > (guint64) n_baseline_fields) {
+		goto invalid;
+	}
+
+	fields = g_new0 (gchar *, n_fields + 1);
+	next_index = 0;
+
+	for (i = 0; i < n_changed; i++) {
+		guint64 index, field_length;
+
+		if (!read_varint (&p, end, &index) ||
+		    !read_varint (&p, end, &field_length) ||
+		    index < next_index || index >= n_fields ||
+		    field_length > (guint64) (end - p) ||
+		    memchr (p, '\0', field_length) != NULL) {
+			goto invalid;
+		}
+
+		fields[index] = g_strndup ((const gchar *) p, field_length);
+		p += field_length;
+		next_index = index + 1;
+	}
+
+	if (p != end) {
+		goto invalid;
+	}
+
+	for (i = 0; i < n_fields; i++) {
+		if (fields[i] != NULL) {
+			continue;
+		} else if (i >= (guint64) n_baseline_fields) {
+			goto invalid;
+		}
+
+		fields[i] = g_strdup (baseline_fields[i]);
+	}
+
+	return fields;
+
+invalid:
+	if (fields != NULL) {
+		/* Some elements may still be %NULL, so g_strfreev() can’t be
+		 * used. */
+		for (i = 0; i < n_fields; i++) {
+			g_free (fields[i]);
+		}
+
+		g_free (fields);
+	}
+
+	g_set_error_literal (error, OS_VERSION_ERROR,
+	                     OS_VERSION_ERROR_INVALID_DATA,
+	                     "Invalid report delta.");
+
+	return NULL;
+}
+
+
+/*
+ * Dictionary compression
+ *
+ * Reports are too short for a general-purpose compressor to find much
+ * redundancy within a single one, but almost all of their content is drawn
+ * from a small vocabulary: OS names, kernel version suffixes, build date
+ * formats, architecture names and so on. This is an LZ77 compressor whose
+ * window is primed with a static dictionary of that vocabulary, so even the
+ * first occurrence of a common string in a report can be encoded as a match.
+ *
+ * The compressed format is a version byte identifying the dictionary, then a
+ * sequence of LZ4-style sequences:
+ * |[
+ * token: (literal length << 4) | (match length - MIN_MATCH)
+ * [varint extra literal length, if literal length is 15]
+ * literal bytes
+ * varint match offset, counting back from the current position into the
+ * dictionary followed by the output so far
+ * [varint extra match length, if match length - MIN_MATCH is 15]
+ * ]|
+ * The final sequence has no match: the input ends after its literals.
+ */
+
+#define COMPRESSION_FORMAT_VERSION 2
+#define MIN_MATCH 4
+#define HASH_BITS 10
+#define MAX_CHAIN_DEPTH 32
+
+/* Limit on the decompressed size, so corrupt input can’t exhaust memory.
+ * Reports are typically a few hundred bytes. */
+#define MAX_DECOMPRESSED_LENGTH 65536
+
+/* The dictionary is assembled from substrings common in get_os_version()
+ * output across the supported platforms. Matches are cheaper the nearer they
+ * are to the end of the window, so the most common strings come last. Changing
+ * it requires a new %COMPRESSION_FORMAT_VERSION. */
+static const gchar compression_dictionary[] =
+	/* Windows and Apple. */
+	"\"Windows\", \"156\", \"10.0.19045\", \"2\", \"\", \"0.0\", \"256\", "
+	"\"1\", \"9\", \"6.1.7601\", \"Service Pack 1\", \"6\", \"0\", \"4\", "
+	"\"iOS\", \"Darwin\", \"Darwin Kernel Version 23.1.0: "
+	"root:xnu-10002.41.9~6/RELEASE_ARM64_T6000\", \"iPhone14,2\", "
+	"\"MacBookPro18,3\", \"Mac14,2\", \"arm64\", \"x86_64\", "
+	"/RELEASE_X86_64\", \"iPad13,4\", \"D63AP\", \"J314sAP\", "
+	/* Android. */
+	"\"Android\", \"33\", \"Linux\", \"5.10.157-android13-4-00001-g\", "
+	"\"#1 SMP PREEMPT Mon Jan 1 00:00:00 UTC 2024\", \"aarch64\", "
+	"\"SM-G991B\", \"samsung\", \"o1sxeea\", \"o1s\", \"exynos2100\", "
+	"\"Pixel 7\", \"google\", \"panther\", \"gs201\", \"Google\", "
+	"\"TP1A.220624.014\", \"release-keys\", \"userdebug\", \"user\", "
+	"\"Xiaomi\", \"Redmi\", \"qcom\", \"kona\", \"lahaina\", \"taro\", "
+	"\"OnePlus\", \"OPPO\", \"vivo\", \"HUAWEI\", \"motorola\", \"LGE\", "
+	"-perf+\", \"4.19.157-perf-g\", \"4.14.190-\", \"REL\", \"12\", "
+	"\"13\", \"14\", \"31\", \"32\", \"34\", \"armv8l\", \"armv7l\", "
+	/* Desktop and server Linux. */
+	"\"Linux\", \"6.5.0-1-amd64\", \"#1 SMP PREEMPT_DYNAMIC Debian "
+	"6.5.3-1 (2023-09-13)\", \"4.18.0-513.5.1.el8_9.x86_64\", \"#1 SMP "
+	"Thu Nov 16 12:34:56 EST 2023\", \"6.6.8-200.fc39.x86_64\", "
+	"\"5.15.0-91-generic\", \"#101-Ubuntu SMP Tue Nov 14 13:30:08 UTC "
+	"2023\", \"6.2.0-39-generic\", \"#40~22.04.1-Ubuntu SMP "
+	"PREEMPT_DYNAMIC Thu Nov 16 10:53:04 UTC 2\", \"i686\", \"ppc64le\", "
+	"\"s390x\", \"riscv64\", \"-azure\", \"-aws\", \"-gcp\", "
+	"-lowlatency\", \"-raspi\", \"-microsoft-standard-WSL2\", "
+	"Jan Feb Mar Apr May Jun Jul Aug Sep Oct Nov Dec "
+	"Mon Tue Wed Thu Fri Sat Sun "
+	"\", \"Linux\", \"5.4.0-generic\", \"#1 SMP \", \"x86_64\", "
+	/* CPU vulnerabilities, clocksource, THP mode and hugepages, which
+	 * end every Linux report. */
+	"\"NNNNNNNNNNNNNNNN\", \"MMMMMMMM\", \"hpet\", \"xen\", "
+	"\"arch_sys_counter\", \"kvm-clock\", \"tsc\", \"always\", "
+	"\"never\", \"madvise\", \"512\", \"1048576\", \"0\", \"2097152\"";
+
+#define DICTIONARY_LENGTH (sizeof (compression_dictionary) - 1)
+
+/* Hash chains over the dictionary, built once and copied for each call. Both
+ * store window positions plus one, so that zero means ‘none’. */
+typedef struct {
+	guint32 head[1 << HASH_BITS];
+	guint32 chain[DICTIONARY_LENGTH];
+} DictionaryIndex;
+
+static guint32
+hash_prefix (const guint8 *p)
+{
+	guint32 value;
+
+	memcpy (&value, p, sizeof (value));
+
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static const DictionaryIndex *
+get_dictionary_index (void)
+{
+	static gsize initialised = 0;
+	static DictionaryIndex index;
+
+	if (g_once_init_enter (&initialised)) {
+		const guint8 *dictionary = (const guint8 *) compression_dictionary;
+		gsize i;
+
+		memset (&index, 0, sizeof (index));
+
+		for (i = 0; i + MIN_MATCH <= DICTIONARY_LENGTH; i++) {
+			guint32 hash = hash_prefix (dictionary + i);
+
+			index.chain[i] = index.head[hash];
+			index.head[hash] = i + 1;
+		}
+
+		g_once_init_leave (&initialised, 1);
+	}
+
+	return &index;
+}
+
+static void
+append_sequence (GByteArray *buf,
+                 const guint8 *literals,
+                 gsize n_literals,
+                 gsize match_length,
+                 gsize match_offset)
+{
+	guint8 token;
+	gsize extra_match_length = 0;
+
+	token = MIN (n_literals, 15) << 4;
+
+	if (match_length > 0) {
+		extra_match_length = match_length - MIN_MATCH;
+		token |= MIN (extra_match_length, 15);
+	}
+
+	g_byte_array_append (buf, &token, 1);
+
+	if (n_literals >= 15) {
+		append_varint (buf, n_literals - 15);
+	}
+
+	g_byte_array_append (buf, literals, n_literals);
+
+	if (match_length > 0) {
+		append_varint (buf, match_offset);
+
+		if (extra_match_length >= 15) {
+			append_varint (buf, extra_match_length - 15);
+		}
+	}
+}
+
+/**
+ * os_version_compress:
+ * @report: a report string, as returned by get_os_version()
+ * @length: length of @report in bytes, or -1 if it is nul-terminated
+ *
+ * Compress a single report, using a built-in dictionary of strings common in
+ * reports so that it compresses well without being batched with others.
+ * Decompress it with os_version_decompress().
+ *
+ * Any string can be compressed, but ones which are not reports will compress
+ * poorly.
+ *
+ * Returns: (transfer full): the compressed report
+ *
+ * Since: UNRELEASED
+ */
+GBytes *
+os_version_compress (const gchar *report, gssize length)
+{
+	const DictionaryIndex *index;
+	GByteArray *buf;
+	guint8 *window;
+	guint32 *head, *chain;
+	gsize pos, end, literal_start;
+	guint8 version = COMPRESSION_FORMAT_VERSION;
+
+	g_return_val_if_fail (report != NULL || length == 0, NULL);
+
+	if (length < 0) {
+		length = strlen (report);
+	}
+
+	index = get_dictionary_index ();
+
+	/* The window is the dictionary followed by the input. */
+	end = DICTIONARY_LENGTH + length;
+	window = g_malloc (end);
+	memcpy (window, compression_dictionary, DICTIONARY_LENGTH);
+	memcpy (window + DICTIONARY_LENGTH, report, length);
+
+	head = g_new (guint32, G_N_ELEMENTS (index->head));
+	memcpy (head, index->head, sizeof (index->head));
+	chain = g_new (guint32, end);
+	memcpy (chain, index->chain, sizeof (index->chain));
+
+	buf = g_byte_array_sized_new (length / 2 + 8);
+	g_byte_array_append (buf, &version, 1);
+
+	pos = literal_start = DICTIONARY_LENGTH;
+
+	while (pos + MIN_MATCH <= end) {
+		guint32 hash, candidate;
+		gsize best_length = 0, best_pos = 0;
+		guint depth;
+
+		hash = hash_prefix (window + pos);
+
+		for (candidate = head[hash], depth = 0;
+		     candidate != 0 && depth < MAX_CHAIN_DEPTH;
+		     candidate = chain[candidate - 1], depth++) {
+			gsize match_length = 0;
+
+			while (pos + match_length < end &&
+			       window[candidate - 1 + match_length] ==
+			       window[pos + match_length]) {
+				match_length++;
+			}
+
+			if (match_length > best_length) {
+				best_length = match_length;
+				best_pos = candidate - 1;
+			}
+		}
+
+		if (best_length < MIN_MATCH) {
+			chain[pos] = head[hash];
+			head[hash] = pos + 1;
+			pos++;
+
+			continue;
+		}
+
+		append_sequence (buf, window + literal_start,
+		                 pos - literal_start, best_length,
+		                 pos - best_pos);
+
+		/* Index the positions covered by the match. */
+		for (literal_start = pos + best_length;
+		     pos < literal_start && pos + MIN_MATCH <= end; pos++) {
+			hash = hash_prefix (window + pos);
+			chain[pos] = head[hash];
+			head[hash] = pos + 1;
+		}
+
+		pos = literal_start;
+	}
+
+	append_sequence (buf, window + literal_start, end - literal_start, 0, 0);
+
+	g_free (chain);
+	g_free (head);
+	g_free (window);
+
+	return g_byte_array_free_to_bytes (buf);
+}
+
+/**
+ * os_version_decompress:
+ * @compressed: a compressed report, from os_version_compress()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Decompress a report compressed with os_version_compress(). If @compressed
+ * is invalid, was produced with an unsupported dictionary, or decompresses to
+ * more than 64KiB, %OS_VERSION_ERROR_INVALID_DATA is returned.
+ *
+ * Returns: (transfer full): the decompressed report
+ *
+ * Since: UNRELEASED
+ */
+gchar *
+os_version_decompress (GBytes *compressed, GError **error)
+{
+	GByteArray *window;
+	const guint8 *p, *end;
+	gsize length;
+	gchar *out;
+
+	g_return_val_if_fail (compressed != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	p = g_bytes_get_data (compressed, &length);
+	end = p + length;
+
+	if (length == 0 || *p++ != COMPRESSION_FORMAT_VERSION) {
+		goto invalid_no_window;
+	}
+
+	window = g_byte_array_sized_new (DICTIONARY_LENGTH + length * 4);
+	g_byte_array_append (window, (const guint8 *) compression_dictionary,
+	                     DICTIONARY_LENGTH);
+
+	while (p < end) {
+		guint8 token = *p++;
+		guint64 n_literals = token >> 4;
+		guint64 match_length = token & 0x0f;
+		guint64 offset, i, start;
+
+		if (n_literals == 15) {
+			guint64 extra;
+
+			if (!read_varint (&p, end, &extra) ||
+			    extra > (guint64) (end - p)) {
+				goto invalid;
+			}
+
+			n_literals += extra;
+		}
+
+		if (n_literals > (guint64) (end - p) ||
+		    window->len + n_literals >
+		    DICTIONARY_LENGTH + MAX_DECOMPRESSED_LENGTH) {
+			goto invalid;
+		}
+
+		g_byte_array_append (window, p, n_literals);
+		p += n_literals;
+
+		/* The last sequence has no match. */
+		if (p == end) {
+			break;
+		}
+
+		if (!read_varint (&p, end, &offset) ||
+		    offset == 0 || offset > window->len) {
+			goto invalid;
+		}
+
+		if (match_length == 15) {
+			guint64 extra;
+
+			if (!read_varint (&p, end, &extra) ||
+			    extra > MAX_DECOMPRESSED_LENGTH) {
+				goto invalid;
+			}
+
+			match_length += extra;
+		}
+
+		match_length += MIN_MATCH;
+
+		if (window->len + match_length >
+		    DICTIONARY_LENGTH + MAX_DECOMPRESSED_LENGTH) {
+			goto invalid;
+		}
+
+		/* Copy byte by byte, as the match may overlap its own
+		 * output. */
+		start = window->len - offset;
+		g_byte_array_set_size (window, window->len + match_length);
+
+		for (i = 0; i < match_length; i++) {
+			window->data[window->len - match_length + i] =
+				window->data[start + i];
+		}
+	}
+
+	if (memchr (window->data + DICTIONARY_LENGTH, '\0',
+	            window->len - DICTIONARY_LENGTH) != NULL) {
+		goto invalid;
+	}
+
+	out = g_strndup ((const gchar *) window->data + DICTIONARY_LENGTH,
+	                 window->len - DICTIONARY_LENGTH);
+	g_byte_array_unref (window);
+
+	return out;
+
+invalid:
+	g_byte_array_unref (window);
+invalid_no_window:
+	g_set_error_literal (error, OS_VERSION_ERROR,
+	                     OS_VERSION_ERROR_INVALID_DATA,
+	                     "Invalid compressed report.");
+
+	return NULL;
+}
@@ -0,0 +1,56 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_CODEC_H_
+#define _OS_VERSION_CODEC_H_
+
+
+GBytes *
+os_version_delta_encode (guint64 baseline_id,
+                         const gchar * const *baseline_fields,
+                         gssize n_baseline_fields,
+                         const gchar * const *fields,
+                         gssize n_fields);
+
+gboolean
+os_version_delta_get_baseline_id (GBytes *delta,
+                                  guint64 *baseline_id,
+                                  GError **error);
+
+gchar **
+os_version_delta_decode (GBytes *delta,
+                         const gchar * const *baseline_fields,
+                         gssize n_baseline_fields,
+                         GError **error);
+
+GBytes *
+os_version_compress (const gchar *report, gssize length);
+
+gchar *
+os_version_decompress (GBytes *compressed, GError **error);
+
+
+#endif /* _OS_VERSION_CODEC_H_ */
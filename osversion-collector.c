@@ -0,0 +1,591 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#ifdef G_OS_UNIX
+#include <sys/socket.h>
+#include <gio/gunixsocketaddress.h>
+#include <glib/gstdio.h>
+#endif
+
+#include "osversion.h"
+#include "osversion-collector.h"
+
+
+/*
+ * Each worker thread owns a socket (or shares the collector’s single socket,
+ * for Unix datagram addresses) and receives batches of datagrams with
+ * g_socket_receive_messages(), which uses recvmmsg() where available. On a
+ * blocking socket, that waits until a whole batch has arrived, so the sockets
+ * are non-blocking: each worker waits for its socket to become readable, then
+ * receives whatever datagrams are queued. Reports
+ * are validated and counted into a hash table private to the worker; its lock
+ * is only ever contended by os_version_collector_snapshot(), which merges the
+ * workers’ tables.
+ */
+
+/* Number of datagrams to receive per system call. */
+#define BATCH_SIZE 64
+
+/* Datagrams this long or longer are assumed to be truncated. Reports are
+ * typically a few hundred bytes. */
+#define MAX_DATAGRAM_SIZE 8192
+
+/* Bounds on how long a worker waits before receiving again after a transient
+ * error, in milliseconds. The wait doubles with each consecutive error. */
+#define MIN_BACKOFF_MS 1
+#define MAX_BACKOFF_MS 1000
+
+typedef struct {
+	OsVersionCollector *collector;  /* unowned */
+	GSocket *socket;  /* owned */
+	GThread *thread;  /* owned */
+
+	GMutex lock;
+	GHashTable/*<owned string, owned guint64>*/ *counts;  /* lock */
+	guint64 n_invalid;  /* lock */
+} Worker;
+
+struct _OsVersionCollector {
+	GCancellable *cancellable;  /* owned */
+	GSocketAddress *address;  /* owned */
+	gchar *unix_path;  /* owned; filesystem path bound to, or NULL */
+	Worker *workers;  /* array of length @n_workers */
+	guint n_workers;
+};
+
+static GHashTable/*<owned string, owned guint64>*/ *
+counts_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+counts_add (GHashTable/*<owned string, owned guint64>*/ *counts,
+            const gchar *report,
+            guint64 count)
+{
+	guint64 *value;
+
+	value = g_hash_table_lookup (counts, report);
+
+	if (value == NULL) {
+		value = g_new0 (guint64, 1);
+		g_hash_table_insert (counts, g_strdup (report), value);
+	}
+
+	*value += count;
+}
+
+/* Strip a trailing newline, if the client sent one, and check the report can
+ * be parsed. */
+static gboolean
+validate_report (gchar *report, gsize length)
+{
+	gchar **fields;
+
+	if (length > 0 && report[length - 1] == '\n') {
+		length--;
+	}
+
+	report[length] = '\0';
+
+	if (length == 0 || memchr (report, '\0', length) != NULL) {
+		return FALSE;
+	}
+
+	fields = os_version_parse (report, length, NULL);
+
+	if (fields == NULL) {
+		return FALSE;
+	}
+
+	g_strfreev (fields);
+
+	return TRUE;
+}
+
+/* Whether a receive error may clear up by itself, such as an ICMP error
+ * queued on a UDP socket or a temporary shortage of kernel memory. Any other
+ * error is assumed to recur on every call. */
+static gboolean
+error_is_transient (const GError *error)
+{
+	return (g_error_matches (error, G_IO_ERROR,
+	                         G_IO_ERROR_CONNECTION_REFUSED) ||
+	        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_HOST_UNREACHABLE) ||
+	        g_error_matches (error, G_IO_ERROR,
+	                         G_IO_ERROR_NETWORK_UNREACHABLE) ||
+	        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE) ||
+	        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+	        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BUSY));
+}
+
+/* Wait for @timeout_ms, returning early if @cancellable is cancelled. */
+static void
+wait_cancellable (GCancellable *cancellable, guint timeout_ms)
+{
+	GPollFD poll_fd;
+
+	if (g_cancellable_make_pollfd (cancellable, &poll_fd)) {
+		g_poll (&poll_fd, 1, timeout_ms);
+		g_cancellable_release_fd (cancellable);
+	} else {
+		g_usleep (timeout_ms * 1000);
+	}
+}
+
+static gpointer
+worker_thread (gpointer user_data)
+{
+	Worker *worker = user_data;
+	GInputMessage messages[BATCH_SIZE];
+	GInputVector vectors[BATCH_SIZE];
+	gboolean valid[BATCH_SIZE];
+	gchar *buffers;
+	guint backoff_ms = 0;
+
+	/* Leave room to nul-terminate each datagram in place. */
+	buffers = g_malloc ((MAX_DATAGRAM_SIZE + 1) * BATCH_SIZE);
+
+	while (TRUE) {
+		GError *error = NULL;
+		gint n_messages, i;
+		guint n_invalid = 0;
+
+		for (i = 0; i < BATCH_SIZE; i++) {
+			vectors[i].buffer = buffers + (MAX_DATAGRAM_SIZE + 1) * i;
+			vectors[i].size = MAX_DATAGRAM_SIZE;
+
+			memset (&messages[i], 0, sizeof (messages[i]));
+			messages[i].vectors = &vectors[i];
+			messages[i].num_vectors = 1;
+		}
+
+		if (g_socket_condition_wait (worker->socket, G_IO_IN,
+		                             worker->collector->cancellable,
+		                             &error)) {
+			n_messages = g_socket_receive_messages (worker->socket,
+			                                        messages,
+			                                        BATCH_SIZE, 0,
+			                                        NULL, &error);
+		} else {
+			n_messages = -1;
+		}
+
+		if (n_messages < 0) {
+			if (g_error_matches (error, G_IO_ERROR,
+			                     G_IO_ERROR_CANCELLED)) {
+				g_error_free (error);
+				break;
+			}
+
+			/* Another worker sharing the socket took the
+			 * datagrams first. */
+			if (g_error_matches (error, G_IO_ERROR,
+			                     G_IO_ERROR_WOULD_BLOCK)) {
+				g_error_free (error);
+				continue;
+			}
+
+			if (!error_is_transient (error)) {
+				g_warning ("Error receiving reports; stopping "
+				           "worker: %s", error->message);
+				g_error_free (error);
+				break;
+			}
+
+			g_debug ("Error receiving reports: %s", error->message);
+			g_error_free (error);
+
+			/* Back off rather than spin if the error persists. */
+			backoff_ms = CLAMP (backoff_ms * 2, MIN_BACKOFF_MS,
+			                    MAX_BACKOFF_MS);
+			wait_cancellable (worker->collector->cancellable,
+			                  backoff_ms);
+
+			continue;
+		}
+
+		backoff_ms = 0;
+
+		/* Parse outside the lock. */
+		for (i = 0; i < n_messages; i++) {
+			valid[i] = (messages[i].bytes_received < MAX_DATAGRAM_SIZE &&
+			            validate_report (vectors[i].buffer,
+			                             messages[i].bytes_received));
+		}
+
+		g_mutex_lock (&worker->lock);
+
+		for (i = 0; i < n_messages; i++) {
+			if (valid[i]) {
+				counts_add (worker->counts, vectors[i].buffer,
+				            1);
+			} else {
+				n_invalid++;
+			}
+		}
+
+		worker->n_invalid += n_invalid;
+
+		g_mutex_unlock (&worker->lock);
+	}
+
+	g_free (buffers);
+
+	return NULL;
+}
+
+static GSocket *
+create_socket (GSocketAddress *address, gboolean reuse_port, GError **error)
+{
+	GSocket *socket;
+
+	socket = g_socket_new (g_socket_address_get_family (address),
+	                       G_SOCKET_TYPE_DATAGRAM,
+	                       G_SOCKET_PROTOCOL_DEFAULT, error);
+
+	if (socket == NULL) {
+		return NULL;
+	}
+
+	g_socket_set_blocking (socket, FALSE);
+
+#ifdef SO_REUSEPORT
+	/* Let the kernel distribute datagrams between the workers’ sockets. */
+	if (reuse_port &&
+	    !g_socket_set_option (socket, SOL_SOCKET, SO_REUSEPORT, 1,
+	                          error)) {
+		g_object_unref (socket);
+		return NULL;
+	}
+#endif
+
+	if (!g_socket_bind (socket, address, TRUE, error)) {
+		g_object_unref (socket);
+		return NULL;
+	}
+
+	return socket;
+}
+
+/**
+ * os_version_collector_new:
+ * @address: address to listen on; either an IP address, to receive UDP
+ *    datagrams, or a Unix socket address, to receive Unix datagrams
+ * @n_workers: number of worker threads, or 0 to use one per processor
+ * @error: return location for a #GError, or %NULL
+ *
+ * Create a collector which receives reports, one per datagram, on @address
+ * and counts them. Datagrams which are not valid reports are counted
+ * separately; see os_version_collector_get_n_invalid().
+ *
+ * For UDP, each worker binds its own socket with `SO_REUSEPORT` (where
+ * supported) so the kernel spreads load across them. If @address has port 0,
+ * an unused port is chosen; see os_version_collector_get_address(). For Unix
+ * datagrams, the workers share a single socket.
+ *
+ * This is intended for testing and small deployments. To output counts
+ * periodically, call os_version_collector_snapshot() from a timeout.
+ *
+ * Returns: (transfer full): a new, running #OsVersionCollector, or %NULL on
+ *    error
+ *
+ * Since: UNRELEASED
+ */
+OsVersionCollector *
+os_version_collector_new (GSocketAddress *address,
+                          guint n_workers,
+                          GError **error)
+{
+	OsVersionCollector *self;
+	gboolean is_unix;
+	GSocket *first_socket;
+	guint i;
+
+	g_return_val_if_fail (address != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	if (n_workers == 0) {
+		n_workers = g_get_num_processors ();
+	}
+
+	is_unix = (g_socket_address_get_family (address) ==
+	           G_SOCKET_FAMILY_UNIX);
+
+	first_socket = create_socket (address, !is_unix && n_workers > 1,
+	                              error);
+
+	if (first_socket == NULL) {
+		return NULL;
+	}
+
+	self = g_slice_new0 (OsVersionCollector);
+	self->cancellable = g_cancellable_new ();
+
+#ifdef G_OS_UNIX
+	/* Remember the socket file so it can be removed again; abstract
+	 * addresses have no file. */
+	if (is_unix) {
+		GUnixSocketAddress *unix_address;
+
+		unix_address = G_UNIX_SOCKET_ADDRESS (address);
+
+		if (g_unix_socket_address_get_address_type (unix_address) ==
+		    G_UNIX_SOCKET_ADDRESS_PATH) {
+			self->unix_path = g_strdup (g_unix_socket_address_get_path (unix_address));
+		}
+	}
+#endif
+
+	self->address = g_socket_get_local_address (first_socket, error);
+	self->workers = g_new0 (Worker, n_workers);
+	self->n_workers = 0;
+
+	if (self->address == NULL) {
+		g_object_unref (first_socket);
+		os_version_collector_free (self);
+
+		return NULL;
+	}
+
+	for (i = 0; i < n_workers; i++) {
+		Worker *worker = &self->workers[i];
+
+		if (i == 0) {
+			worker->socket = first_socket;
+		} else if (is_unix) {
+			worker->socket = g_object_ref (first_socket);
+		} else {
+			/* Bind to the local address of the first socket, so
+			 * any port chosen by the kernel is reused. */
+			worker->socket = create_socket (self->address, TRUE,
+			                                error);
+
+			if (worker->socket == NULL) {
+				os_version_collector_free (self);
+				return NULL;
+			}
+		}
+
+		worker->collector = self;
+		worker->counts = counts_new ();
+		g_mutex_init (&worker->lock);
+
+		worker->thread = g_thread_try_new ("os-version-collector",
+		                                   worker_thread, worker,
+		                                   error);
+
+		if (worker->thread == NULL) {
+			g_object_unref (worker->socket);
+			g_hash_table_unref (worker->counts);
+			g_mutex_clear (&worker->lock);
+			os_version_collector_free (self);
+
+			return NULL;
+		}
+
+		self->n_workers++;
+	}
+
+	return self;
+}
+
+/**
+ * os_version_collector_free:
+ * @self: (transfer full): an #OsVersionCollector
+ *
+ * Stop the collector’s worker threads, close its sockets and free it. If it
+ * was listening on a Unix socket path, the socket file is removed, so a new
+ * collector can be created on the same path. Any counts not yet retrieved
+ * with os_version_collector_snapshot() are lost.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_collector_free (OsVersionCollector *self)
+{
+	guint i;
+
+	g_return_if_fail (self != NULL);
+
+	g_cancellable_cancel (self->cancellable);
+
+	for (i = 0; i < self->n_workers; i++) {
+		Worker *worker = &self->workers[i];
+
+		g_thread_join (worker->thread);
+		g_object_unref (worker->socket);
+		g_hash_table_unref (worker->counts);
+		g_mutex_clear (&worker->lock);
+	}
+
+	if (self->unix_path != NULL) {
+		g_unlink (self->unix_path);
+		g_free (self->unix_path);
+	}
+
+	g_free (self->workers);
+	g_clear_object (&self->address);
+	g_object_unref (self->cancellable);
+	g_slice_free (OsVersionCollector, self);
+}
+
+/**
+ * os_version_collector_get_address:
+ * @self: an #OsVersionCollector
+ *
+ * Get the address the collector is listening on. This differs from the
+ * address passed to os_version_collector_new() if that had port 0.
+ *
+ * Returns: (transfer none): the listening address
+ *
+ * Since: UNRELEASED
+ */
+GSocketAddress *
+os_version_collector_get_address (OsVersionCollector *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+
+	return self->address;
+}
+
+/**
+ * os_version_collector_snapshot:
+ * @self: an #OsVersionCollector
+ * @reset: %TRUE to reset the counts to zero after taking the snapshot
+ * @func: (scope call): function to call for each distinct report
+ * @user_data: user data to pass to @func
+ *
+ * Take a snapshot of the reports received so far, and call @func with the
+ * count of each distinct report. The workers continue receiving while @func is
+ * being called. If @reset is %TRUE, each report and each invalid datagram is
+ * included in exactly one snapshot.
+ *
+ * Returns: number of datagrams which were not valid reports, received over
+ *    the same period as the counts in the snapshot
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_collector_snapshot (OsVersionCollector *self,
+                               gboolean reset,
+                               OsVersionCollectorFunc func,
+                               gpointer user_data)
+{
+	GHashTable/*<owned string, owned guint64>*/ *merged;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint64 n_invalid = 0;
+	guint i;
+
+	g_return_val_if_fail (self != NULL, 0);
+	g_return_val_if_fail (func != NULL, 0);
+
+	merged = counts_new ();
+
+	for (i = 0; i < self->n_workers; i++) {
+		Worker *worker = &self->workers[i];
+		GHashTable/*<owned string, owned guint64>*/ *counts;
+
+		g_mutex_lock (&worker->lock);
+
+		n_invalid += worker->n_invalid;
+
+		if (reset) {
+			/* Swap the table out, so the worker is only blocked
+			 * for a moment. */
+			counts = worker->counts;
+			worker->counts = counts_new ();
+			worker->n_invalid = 0;
+		} else {
+			counts = g_hash_table_ref (worker->counts);
+
+			g_hash_table_iter_init (&iter, counts);
+
+			while (g_hash_table_iter_next (&iter, &key, &value)) {
+				counts_add (merged, key, *((guint64 *) value));
+			}
+
+			g_hash_table_unref (counts);
+			counts = NULL;
+		}
+
+		g_mutex_unlock (&worker->lock);
+
+		if (counts != NULL) {
+			g_hash_table_iter_init (&iter, counts);
+
+			while (g_hash_table_iter_next (&iter, &key, &value)) {
+				counts_add (merged, key, *((guint64 *) value));
+			}
+
+			g_hash_table_unref (counts);
+		}
+	}
+
+	g_hash_table_iter_init (&iter, merged);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		func (key, *((guint64 *) value), user_data);
+	}
+
+	g_hash_table_unref (merged);
+
+	return n_invalid;
+}
+
+/**
+ * os_version_collector_get_n_invalid:
+ * @self: an #OsVersionCollector
+ *
+ * Get the number of datagrams received which were not valid reports, since
+ * the collector was created or last reset by os_version_collector_snapshot().
+ *
+ * Returns: number of invalid datagrams
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_collector_get_n_invalid (OsVersionCollector *self)
+{
+	guint64 n_invalid = 0;
+	guint i;
+
+	g_return_val_if_fail (self != NULL, 0);
+
+	for (i = 0; i < self->n_workers; i++) {
+		g_mutex_lock (&self->workers[i].lock);
+		n_invalid += self->workers[i].n_invalid;
+		g_mutex_unlock (&self->workers[i].lock);
+	}
+
+	return n_invalid;
+}
@@ -0,0 +1,77 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+
+#ifndef _OS_VERSION_COLLECTOR_H_
+#define _OS_VERSION_COLLECTOR_H_
+
+
+/**
+ * OsVersionCollector:
+ *
+ * Receives reports over datagram sockets and counts them. All the fields are
+ * private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionCollector OsVersionCollector;
+
+/**
+ * OsVersionCollectorFunc:
+ * @report: a report string, as returned by get_os_version()
+ * @count: number of times @report was received
+ * @user_data: user data passed to os_version_collector_snapshot()
+ *
+ * Called for each distinct report in a snapshot.
+ *
+ * Since: UNRELEASED
+ */
+typedef void (*OsVersionCollectorFunc) (const gchar *report,
+                                        guint64 count,
+                                        gpointer user_data);
+
+OsVersionCollector *
+os_version_collector_new (GSocketAddress *address,
+                          guint n_workers,
+                          GError **error);
+
+void
+os_version_collector_free (OsVersionCollector *self);
+
+GSocketAddress *
+os_version_collector_get_address (OsVersionCollector *self);
+
+guint64
+os_version_collector_snapshot (OsVersionCollector *self,
+                               gboolean reset,
+                               OsVersionCollectorFunc func,
+                               gpointer user_data);
+
+guint64
+os_version_collector_get_n_invalid (OsVersionCollector *self);
+
+
+#endif /* _OS_VERSION_COLLECTOR_H_ */
@@ -0,0 +1,347 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+#include "osversion.h"
+#include "osversion-ingest.h"
+
+
+/* Nominal size of the chunks the file is divided into. Chunks are small
+ * enough that the threads stay evenly loaded until the end of the file, and
+ * large enough that claiming one is negligible next to parsing it. */
+#define CHUNK_SIZE (1 << 20)
+
+/* Maximum number of chunks per thread which may be parsed ahead of the
+ * callback in ordered mode, bounding the memory used by parsed reports. */
+#define ORDERED_WINDOW 4
+
+typedef struct {
+	guint64 offset;
+	gchar **fields;  /* owned */
+} ParsedReport;
+
+typedef struct {
+	GArray/*<ParsedReport>*/ *reports;  /* owned; NULL until parsed */
+} ParsedChunk;
+
+typedef struct {
+	const gchar *contents;
+	gsize length;
+	guint n_chunks;
+	OsVersionIngestFlags flags;
+	OsVersionIngestFunc func;
+	gpointer user_data;
+
+	gint next_chunk;  /* atomic */
+	guint64 n_invalid;  /* lock */
+
+	/* Ordered mode only. */
+	GMutex lock;
+	GCond cond;
+	ParsedChunk *chunks;  /* lock */
+	guint n_delivered;  /* lock */
+	guint window;
+} Ingest;
+
+static void
+parsed_report_clear (ParsedReport *report)
+{
+	g_strfreev (report->fields);
+}
+
+/* A line belongs to the chunk containing its first byte, so each chunk can be
+ * found independently of the others: it starts after the first newline before
+ * its nominal start, and ends with the line containing its nominal end. */
+static void
+parse_chunk (Ingest *ingest, guint chunk, GArray *reports)
+{
+	const gchar *contents = ingest->contents;
+	const gchar *end = contents + ingest->length;
+	const gchar *p, *chunk_end;
+	guint64 n_invalid = 0;
+
+	p = contents + (gsize) chunk * CHUNK_SIZE;
+	chunk_end = contents + MIN ((gsize) (chunk + 1) * CHUNK_SIZE,
+	                            ingest->length);
+
+	if (chunk > 0) {
+		const gchar *newline = memchr (p - 1, '\n', end - (p - 1));
+
+		p = (newline != NULL) ? newline + 1 : end;
+	}
+
+	while (p < chunk_end) {
+		const gchar *line_end;
+		gsize length;
+		gchar **fields;
+
+		line_end = memchr (p, '\n', end - p);
+
+		if (line_end == NULL) {
+			line_end = end;
+		}
+
+		length = line_end - p;
+
+		if (length > 0 && p[length - 1] == '\r') {
+			length--;
+		}
+
+		if (length > 0) {
+			fields = os_version_parse (p, length, NULL);
+
+			if (fields == NULL) {
+				n_invalid++;
+			} else if (reports != NULL) {
+				ParsedReport report = { p - contents, fields };
+
+				g_array_append_val (reports, report);
+			} else {
+				ingest->func (fields, p - contents,
+				              ingest->user_data);
+				g_strfreev (fields);
+			}
+		}
+
+		p = line_end + 1;
+	}
+
+	if (n_invalid > 0) {
+		g_mutex_lock (&ingest->lock);
+		ingest->n_invalid += n_invalid;
+		g_mutex_unlock (&ingest->lock);
+	}
+}
+
+static gpointer
+worker_thread (gpointer user_data)
+{
+	Ingest *ingest = user_data;
+	gboolean ordered = (ingest->flags & OS_VERSION_INGEST_FLAGS_ORDERED);
+	gint chunk;
+
+	while ((chunk = g_atomic_int_add (&ingest->next_chunk, 1)) <
+	       (gint) ingest->n_chunks) {
+		GArray *reports = NULL;
+
+		if (ordered) {
+			/* Don’t get too far ahead of the callback. */
+			g_mutex_lock (&ingest->lock);
+
+			while ((guint) chunk >=
+			       ingest->n_delivered + ingest->window) {
+				g_cond_wait (&ingest->cond, &ingest->lock);
+			}
+
+			g_mutex_unlock (&ingest->lock);
+
+			reports = g_array_new (FALSE, FALSE,
+			                       sizeof (ParsedReport));
+			g_array_set_clear_func (reports,
+			                        (GDestroyNotify) parsed_report_clear);
+		}
+
+		parse_chunk (ingest, chunk, reports);
+
+		if (ordered) {
+			g_mutex_lock (&ingest->lock);
+			ingest->chunks[chunk].reports = reports;
+			g_cond_broadcast (&ingest->cond);
+			g_mutex_unlock (&ingest->lock);
+		}
+	}
+
+	return NULL;
+}
+
+/* Pass parsed chunks to the callback in order, as the workers finish them. */
+static void
+deliver_ordered (Ingest *ingest)
+{
+	guint chunk;
+
+	for (chunk = 0; chunk < ingest->n_chunks; chunk++) {
+		GArray *reports;
+		guint i;
+
+		g_mutex_lock (&ingest->lock);
+
+		while (ingest->chunks[chunk].reports == NULL) {
+			g_cond_wait (&ingest->cond, &ingest->lock);
+		}
+
+		reports = ingest->chunks[chunk].reports;
+		ingest->chunks[chunk].reports = NULL;
+		g_mutex_unlock (&ingest->lock);
+
+		for (i = 0; i < reports->len; i++) {
+			ParsedReport *report = &g_array_index (reports,
+			                                       ParsedReport, i);
+
+			ingest->func (report->fields, report->offset,
+			              ingest->user_data);
+		}
+
+		g_array_unref (reports);
+
+		g_mutex_lock (&ingest->lock);
+		ingest->n_delivered = chunk + 1;
+		g_cond_broadcast (&ingest->cond);
+		g_mutex_unlock (&ingest->lock);
+	}
+}
+
+/**
+ * os_version_ingest_file:
+ * @path: path of a file containing one report per line
+ * @n_threads: number of threads to parse with, or 0 to use one per processor
+ * @flags: flags affecting the ingest
+ * @func: function to call for each valid report
+ * @user_data: user data to pass to @func
+ * @n_invalid: (out) (optional): return location for the number of lines
+ *    which could not be parsed
+ * @error: return location for a #GError, or %NULL
+ *
+ * Parse every report in a newline-delimited log, such as one collected by
+ * appending the output of get_os_version() as a line for each client. This is
+ * the same format os_version_archive_convert() reads. Several threads are
+ * used: the file is mapped into memory and divided into chunks at line
+ * boundaries, which the threads claim in turn until none are left. Empty lines
+ * are ignored, and lines which cannot be parsed are counted in @n_invalid.
+ *
+ * Unless %OS_VERSION_INGEST_FLAGS_ORDERED is set, @func is called from all
+ * the threads concurrently, so must be thread-safe. With it set, @func is
+ * called only from the calling thread, in file order; parsing continues in
+ * the other threads meanwhile.
+ *
+ * Returns: %TRUE on success, %FALSE if the file could not be read
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_ingest_file (const gchar *path,
+                        guint n_threads,
+                        OsVersionIngestFlags flags,
+                        OsVersionIngestFunc func,
+                        gpointer user_data,
+                        guint64 *n_invalid,
+                        GError **error)
+{
+	GMappedFile *mapped_file;
+	Ingest ingest = { NULL, };
+	GPtrArray/*<GThread>*/ *threads;
+	gboolean ordered = (flags & OS_VERSION_INGEST_FLAGS_ORDERED);
+	gsize n_chunks;
+	guint i;
+
+	g_return_val_if_fail (path != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	mapped_file = g_mapped_file_new (path, FALSE, error);
+
+	if (mapped_file == NULL) {
+		return FALSE;
+	}
+
+	ingest.contents = g_mapped_file_get_contents (mapped_file);
+	ingest.length = g_mapped_file_get_length (mapped_file);
+
+#if defined(G_OS_UNIX) && defined(MADV_SEQUENTIAL)
+	/* Advisory only; the mapping is page-aligned as it starts at the
+	 * beginning of the file. */
+	if (ingest.length > 0) {
+		madvise ((gpointer) ingest.contents, ingest.length,
+		         MADV_SEQUENTIAL);
+	}
+#endif
+
+	n_chunks = (ingest.length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	if (n_chunks > G_MAXINT) {
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+		             "File ‘%s’ is too large to ingest.", path);
+		g_mapped_file_unref (mapped_file);
+
+		return FALSE;
+	}
+
+	if (n_threads == 0) {
+		n_threads = g_get_num_processors ();
+	}
+
+	n_threads = MAX (1, MIN (n_threads, n_chunks));
+
+	ingest.n_chunks = n_chunks;
+	ingest.flags = flags;
+	ingest.func = func;
+	ingest.user_data = user_data;
+	ingest.window = n_threads * ORDERED_WINDOW;
+	g_mutex_init (&ingest.lock);
+	g_cond_init (&ingest.cond);
+
+	if (ordered) {
+		ingest.chunks = g_new0 (ParsedChunk, n_chunks);
+	}
+
+	/* In unordered mode, the calling thread parses too. In ordered mode,
+	 * it runs the callback. */
+	threads = g_ptr_array_new ();
+
+	for (i = ordered ? 0 : 1; i < n_threads; i++) {
+		g_ptr_array_add (threads,
+		                 g_thread_new ("os-version-ingest",
+		                               worker_thread, &ingest));
+	}
+
+	if (ordered) {
+		deliver_ordered (&ingest);
+	} else {
+		worker_thread (&ingest);
+	}
+
+	for (i = 0; i < threads->len; i++) {
+		g_thread_join (threads->pdata[i]);
+	}
+
+	g_ptr_array_unref (threads);
+	g_free (ingest.chunks);
+	g_cond_clear (&ingest.cond);
+	g_mutex_clear (&ingest.lock);
+	g_mapped_file_unref (mapped_file);
+
+	if (n_invalid != NULL) {
+		*n_invalid = ingest.n_invalid;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,73 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_INGEST_H_
+#define _OS_VERSION_INGEST_H_
+
+
+/**
+ * OsVersionIngestFlags:
+ * @OS_VERSION_INGEST_FLAGS_NONE: No flags set. Reports are passed to the
+ *    callback concurrently from several threads, in no particular order.
+ * @OS_VERSION_INGEST_FLAGS_ORDERED: Reports are passed to the callback from
+ *    the calling thread, in file order.
+ *
+ * Flags affecting os_version_ingest_file().
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_INGEST_FLAGS_NONE = 0,
+	OS_VERSION_INGEST_FLAGS_ORDERED = (1 << 0),
+} OsVersionIngestFlags;
+
+/**
+ * OsVersionIngestFunc:
+ * @fields: (array zero-terminated=1) (transfer none): parsed fields of the
+ *    report
+ * @offset: offset of the report’s line in the file, in bytes
+ * @user_data: user data passed to os_version_ingest_file()
+ *
+ * Called for each valid report in a file. @fields is freed when the callback
+ * returns.
+ *
+ * Since: UNRELEASED
+ */
+typedef void (*OsVersionIngestFunc) (gchar **fields,
+                                     guint64 offset,
+                                     gpointer user_data);
+
+gboolean
+os_version_ingest_file (const gchar *path,
+                        guint n_threads,
+                        OsVersionIngestFlags flags,
+                        OsVersionIngestFunc func,
+                        gpointer user_data,
+                        guint64 *n_invalid,
+                        GError **error);
+
+
+#endif /* _OS_VERSION_INGEST_H_ */
@@ -0,0 +1,551 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-intern.h"
+#include "osversion-private.h"
+
+
+/*
+ * The table is split into %N_SHARDS shards, selected by the low bits of each
+ * value’s hash. Each shard has an open-addressing hash table of pointers to
+ * immutable entries, and an array of the same entries indexed by identifier.
+ *
+ * Lookups take no locks: entries are fully initialised before a pointer to
+ * them is published with an atomic store, and neither the hash tables nor the
+ * identifier arrays are ever modified in a way which invalidates a pointer a
+ * reader might hold. Growing a hash table publishes a new copy and retires the
+ * old one until the table is freed; the identifier arrays are split into
+ * chunks of doubling size which never move.
+ *
+ * Inserts take the shard’s lock, so inserts into different shards proceed in
+ * parallel.
+ *
+ * An identifier is the shard index in the low %SHARD_BITS bits and the
+ * position of the entry in the shard, plus one, above them. The plus one means
+ * no identifier is zero, so zero can mean failure. This limits each shard to
+ * %MAX_SHARD_ENTRIES entries.
+ */
+
+#define SHARD_BITS 4
+#define N_SHARDS (1 << SHARD_BITS)
+#define MAX_SHARD_ENTRIES (((guint32) 1 << (32 - SHARD_BITS)) - 1)
+
+/* Identifier arrays: chunk k holds CHUNK_BASE << k entries. */
+#define CHUNK_BASE_BITS 10
+#define CHUNK_BASE (1 << CHUNK_BASE_BITS)
+#define N_CHUNKS (32 - SHARD_BITS - CHUNK_BASE_BITS + 1)
+
+#define INITIAL_N_SLOTS 64
+
+typedef struct {
+	guint64 hash;
+	guint32 id;
+	guint32 length;
+	gchar value[];  /* nul-terminated */
+} Entry;
+
+typedef struct {
+	gsize mask;  /* number of slots - 1 */
+	Entry *slots[];
+} Slots;
+
+typedef struct {
+	Slots *slots;  /* atomic */
+	Entry **chunks[N_CHUNKS];  /* atomic */
+	guint32 n_entries;  /* atomic; entries are published before this is
+	                     * incremented */
+
+	GMutex lock;
+	GPtrArray/*<owned Slots>*/ *retired_slots;  /* lock */
+} Shard;
+
+struct _OsVersionInternTable {
+	Shard shards[N_SHARDS];
+};
+
+static Slots *
+slots_new (gsize n_slots)
+{
+	Slots *slots;
+
+	slots = g_malloc0 (sizeof (Slots) + sizeof (Entry *) * n_slots);
+	slots->mask = n_slots - 1;
+
+	return slots;
+}
+
+/* Map a position within a shard to its chunk and the index within it. */
+static void
+position_to_chunk (guint32 position, guint *chunk, guint32 *index)
+{
+	guint32 n = (position >> CHUNK_BASE_BITS) + 1;
+	guint k = 0;
+
+	while (n >> (k + 1) != 0) {
+		k++;
+	}
+
+	*chunk = k;
+	*index = position - (((guint32) 1 << k) - 1) * CHUNK_BASE;
+}
+
+static Entry *
+shard_find (Shard *shard, const gchar *value, gsize length, guint64 hash)
+{
+	Slots *slots = g_atomic_pointer_get (&shard->slots);
+	gsize i;
+
+	for (i = (hash >> SHARD_BITS) & slots->mask;;
+	     i = (i + 1) & slots->mask) {
+		Entry *entry = g_atomic_pointer_get (&slots->slots[i]);
+
+		if (entry == NULL) {
+			return NULL;
+		} else if (entry->hash == hash && entry->length == length &&
+		           memcmp (entry->value, value, length) == 0) {
+			return entry;
+		}
+	}
+}
+
+/* Must be called with the shard lock held. */
+static void
+shard_insert_slot (Slots *slots, Entry *entry)
+{
+	gsize i;
+
+	for (i = (entry->hash >> SHARD_BITS) & slots->mask;
+	     slots->slots[i] != NULL;
+	     i = (i + 1) & slots->mask);
+
+	g_atomic_pointer_set (&slots->slots[i], entry);
+}
+
+/* Must be called with the shard lock held. Returns %NULL if the shard is
+ * full. */
+static Entry *
+shard_insert (Shard *shard, guint shard_index, const gchar *value,
+              gsize length, guint64 hash)
+{
+	Slots *slots = shard->slots;
+	guint32 position = shard->n_entries;
+	Entry *entry;
+	guint chunk;
+	guint32 index;
+
+	if (position >= MAX_SHARD_ENTRIES) {
+		return NULL;
+	}
+
+	/* Keep the load factor below a half, so probe sequences are short. */
+	if ((position + 1) * 2 > slots->mask + 1) {
+		Slots *new_slots = slots_new ((slots->mask + 1) * 2);
+		gsize i;
+
+		for (i = 0; i <= slots->mask; i++) {
+			if (slots->slots[i] != NULL) {
+				shard_insert_slot (new_slots, slots->slots[i]);
+			}
+		}
+
+		g_atomic_pointer_set (&shard->slots, new_slots);
+		g_ptr_array_add (shard->retired_slots, slots);
+		slots = new_slots;
+	}
+
+	entry = g_malloc (sizeof (Entry) + length + 1);
+	entry->hash = hash;
+	entry->id = ((position + 1) << SHARD_BITS) | shard_index;
+	entry->length = length;
+	memcpy (entry->value, value, length);
+	entry->value[length] = '\0';
+
+	position_to_chunk (position, &chunk, &index);
+
+	if (shard->chunks[chunk] == NULL) {
+		g_atomic_pointer_set (&shard->chunks[chunk],
+		                      g_new0 (Entry *, CHUNK_BASE << chunk));
+	}
+
+	shard->chunks[chunk][index] = entry;
+	g_atomic_int_set (&shard->n_entries, position + 1);
+
+	shard_insert_slot (slots, entry);
+
+	return entry;
+}
+
+/**
+ * os_version_intern_table_new:
+ *
+ * Create a new, empty interning table. Interning maps each distinct field
+ * value to a small, stable integer identifier, so aggregators which store
+ * many parsed reports can store identifiers rather than copies of the
+ * strings; see os_version_parse_interned().
+ *
+ * The table is safe to use from multiple threads. Lookups never block;
+ * insertions of new values lock one of several shards.
+ *
+ * Returns: (transfer full): a new #OsVersionInternTable
+ *
+ * Since: UNRELEASED
+ */
+OsVersionInternTable *
+os_version_intern_table_new (void)
+{
+	OsVersionInternTable *self;
+	guint i;
+
+	self = g_slice_new0 (OsVersionInternTable);
+
+	for (i = 0; i < N_SHARDS; i++) {
+		Shard *shard = &self->shards[i];
+
+		shard->slots = slots_new (INITIAL_N_SLOTS);
+		shard->retired_slots = g_ptr_array_new_with_free_func (g_free);
+		g_mutex_init (&shard->lock);
+	}
+
+	return self;
+}
+
+/**
+ * os_version_intern_table_free:
+ * @self: (transfer full): an #OsVersionInternTable
+ *
+ * Free an interning table. No other threads may be using it.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_intern_table_free (OsVersionInternTable *self)
+{
+	guint i, k;
+
+	g_return_if_fail (self != NULL);
+
+	for (i = 0; i < N_SHARDS; i++) {
+		Shard *shard = &self->shards[i];
+		guint32 position;
+
+		for (position = 0; position < shard->n_entries; position++) {
+			guint chunk;
+			guint32 index;
+
+			position_to_chunk (position, &chunk, &index);
+			g_free (shard->chunks[chunk][index]);
+		}
+
+		for (k = 0; k < N_CHUNKS; k++) {
+			g_free (shard->chunks[k]);
+		}
+
+		g_free (shard->slots);
+		g_ptr_array_unref (shard->retired_slots);
+		g_mutex_clear (&shard->lock);
+	}
+
+	g_slice_free (OsVersionInternTable, self);
+}
+
+/**
+ * os_version_intern_table_intern:
+ * @self: an #OsVersionInternTable
+ * @value: (array length=length): value to intern
+ * @length: length of @value in bytes, or -1 if it is nul-terminated
+ *
+ * Get the identifier for @value, adding it to the table if it is not already
+ * present. The identifier is stable for the lifetime of the table, and is never
+ * zero.
+ *
+ * Each table can hold at least 2^28 values. If it has no room for @value, zero
+ * is returned.
+ *
+ * Returns: identifier for @value, or zero if the table is full
+ *
+ * Since: UNRELEASED
+ */
+guint32
+os_version_intern_table_intern (OsVersionInternTable *self,
+                                const gchar *value,
+                                gssize length)
+{
+	Shard *shard;
+	Entry *entry;
+	guint64 hash;
+	guint shard_index;
+
+	g_return_val_if_fail (self != NULL, 0);
+	g_return_val_if_fail (value != NULL || length == 0, 0);
+
+	if (length < 0) {
+		length = strlen (value);
+	}
+
+	g_return_val_if_fail (length <= G_MAXUINT32, 0);
+
+	hash = os_version_fingerprint (value, length);
+	shard_index = hash & (N_SHARDS - 1);
+	shard = &self->shards[shard_index];
+
+	entry = shard_find (shard, value, length, hash);
+
+	if (entry != NULL) {
+		return entry->id;
+	}
+
+	g_mutex_lock (&shard->lock);
+
+	/* Another thread may have inserted it meanwhile. */
+	entry = shard_find (shard, value, length, hash);
+
+	if (entry == NULL) {
+		entry = shard_insert (shard, shard_index, value, length, hash);
+	}
+
+	g_mutex_unlock (&shard->lock);
+
+	return (entry != NULL) ? entry->id : 0;
+}
+
+/**
+ * os_version_intern_table_lookup:
+ * @self: an #OsVersionInternTable
+ * @value: (array length=length): value to look up
+ * @length: length of @value in bytes, or -1 if it is nul-terminated
+ * @id: (out) (optional): return location for the identifier of @value
+ *
+ * Look up the identifier for @value without adding it to the table.
+ *
+ * Returns: %TRUE if @value is in the table, %FALSE otherwise
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_intern_table_lookup (OsVersionInternTable *self,
+                                const gchar *value,
+                                gssize length,
+                                guint32 *id)
+{
+	Entry *entry;
+	guint64 hash;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (value != NULL || length == 0, FALSE);
+
+	if (length < 0) {
+		length = strlen (value);
+	}
+
+	hash = os_version_fingerprint (value, length);
+	entry = shard_find (&self->shards[hash & (N_SHARDS - 1)], value, length,
+	                    hash);
+
+	if (entry != NULL && id != NULL) {
+		*id = entry->id;
+	}
+
+	return (entry != NULL);
+}
+
+/**
+ * os_version_intern_table_get_value:
+ * @self: an #OsVersionInternTable
+ * @id: an identifier returned by os_version_intern_table_intern()
+ * @length: (out) (optional): return location for the length of the value
+ *
+ * Get the value with identifier @id. The returned string is owned by the
+ * table and is valid for its lifetime.
+ *
+ * Returns: (nullable): the nul-terminated value, or %NULL if @id is not in the
+ *    table
+ *
+ * Since: UNRELEASED
+ */
+const gchar *
+os_version_intern_table_get_value (OsVersionInternTable *self,
+                                   guint32 id,
+                                   gsize *length)
+{
+	Shard *shard;
+	Entry **chunk_entries;
+	Entry *entry;
+	guint32 position, index;
+	guint chunk;
+
+	g_return_val_if_fail (self != NULL, NULL);
+
+	shard = &self->shards[id & (N_SHARDS - 1)];
+	position = id >> SHARD_BITS;
+
+	if (position == 0 ||
+	    position - 1 >= (guint32) g_atomic_int_get (&shard->n_entries)) {
+		return NULL;
+	}
+
+	position--;
+
+	position_to_chunk (position, &chunk, &index);
+	chunk_entries = g_atomic_pointer_get (&shard->chunks[chunk]);
+	entry = chunk_entries[index];
+
+	if (length != NULL) {
+		*length = entry->length;
+	}
+
+	return entry->value;
+}
+
+/**
+ * os_version_intern_table_get_size:
+ * @self: an #OsVersionInternTable
+ *
+ * Get the number of distinct values in the table.
+ *
+ * Returns: number of values
+ *
+ * Since: UNRELEASED
+ */
+guint
+os_version_intern_table_get_size (OsVersionInternTable *self)
+{
+	guint i, size = 0;
+
+	g_return_val_if_fail (self != NULL, 0);
+
+	for (i = 0; i < N_SHARDS; i++) {
+		size += g_atomic_int_get (&self->shards[i].n_entries);
+	}
+
+	return size;
+}
+
+/**
+ * os_version_parse_interned:
+ * @table: an #OsVersionInternTable
+ * @report: a report string, as returned by get_os_version()
+ * @length: length of @report in bytes, or -1 if it is nul-terminated
+ * @n_fields: (out): return location for the number of fields
+ * @error: return location for a #GError, or %NULL
+ *
+ * Parse @report as with os_version_parse(), and intern each field in @table,
+ * returning the tuple of field identifiers. Use
+ * os_version_intern_table_get_value() to get the field values back.
+ *
+ * Fields are interned as they are found, without copying them, unless they
+ * contain escapes; those are unescaped into a scratch buffer first. If @table
+ * is full, %OS_VERSION_ERROR_TABLE_FULL is returned.
+ *
+ * Returns: (transfer full) (array length=n_fields): field identifiers, or
+ *    %NULL on error; free with g_free()
+ *
+ * Since: UNRELEASED
+ */
+guint32 *
+os_version_parse_interned (OsVersionInternTable *table,
+                           const gchar *report,
+                           gssize length,
+                           gsize *n_fields,
+                           GError **error)
+{
+	GArray/*<guint32>*/ *ids;
+	const gchar *p, *end;
+	gchar *scratch = NULL;
+	gsize scratch_size = 0;
+
+	g_return_val_if_fail (table != NULL, NULL);
+	g_return_val_if_fail (report != NULL, NULL);
+	g_return_val_if_fail (n_fields != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	if (length < 0) {
+		length = strlen (report);
+	}
+
+	p = report;
+	end = report + length;
+	ids = g_array_sized_new (FALSE, FALSE, sizeof (guint32), 32);
+
+	while (p < end) {
+		const gchar *field, *nul;
+		gsize field_length;
+		gboolean escaped;
+		guint32 id;
+
+		if (!os_version_scan_field (report, &p, end, ids->len == 0,
+		                            &field, &field_length, &escaped,
+		                            error)) {
+			goto error;
+		}
+
+		if (escaped) {
+			if (field_length > scratch_size) {
+				scratch_size = MAX (field_length, 256);
+				g_free (scratch);
+				scratch = g_malloc (scratch_size);
+			}
+
+			field_length = os_version_unescape (field, field_length,
+			                                    scratch);
+			field = scratch;
+		}
+
+		/* os_version_parse() returns nul-terminated strings, so
+		 * match it by stopping at any embedded nul. */
+		nul = memchr (field, '\0', field_length);
+
+		if (nul != NULL) {
+			field_length = nul - field;
+		}
+
+		id = os_version_intern_table_intern (table, field,
+		                                     field_length);
+
+		if (id == 0) {
+			g_set_error_literal (error, OS_VERSION_ERROR,
+			                     OS_VERSION_ERROR_TABLE_FULL,
+			                     "Interning table is full.");
+			goto error;
+		}
+
+		g_array_append_val (ids, id);
+	}
+
+	g_free (scratch);
+	*n_fields = ids->len;
+
+	return (guint32 *) g_array_free (ids, FALSE);
+
+error:
+	g_free (scratch);
+	g_array_free (ids, TRUE);
+
+	return NULL;
+}
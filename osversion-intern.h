@@ -0,0 +1,74 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_INTERN_H_
+#define _OS_VERSION_INTERN_H_
+
+
+/**
+ * OsVersionInternTable:
+ *
+ * A thread-safe table mapping field values to stable 32-bit identifiers. All
+ * the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionInternTable OsVersionInternTable;
+
+OsVersionInternTable *
+os_version_intern_table_new (void);
+
+void
+os_version_intern_table_free (OsVersionInternTable *self);
+
+guint32
+os_version_intern_table_intern (OsVersionInternTable *self,
+                                const gchar *value,
+                                gssize length);
+
+gboolean
+os_version_intern_table_lookup (OsVersionInternTable *self,
+                                const gchar *value,
+                                gssize length,
+                                guint32 *id);
+
+const gchar *
+os_version_intern_table_get_value (OsVersionInternTable *self,
+                                   guint32 id,
+                                   gsize *length);
+
+guint
+os_version_intern_table_get_size (OsVersionInternTable *self);
+
+guint32 *
+os_version_parse_interned (OsVersionInternTable *table,
+                           const gchar *report,
+                           gssize length,
+                           gsize *n_fields,
+                           GError **error);
+
+
+#endif /* _OS_VERSION_INTERN_H_ */
@@ -0,0 +1,465 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion-kernel.h"
+
+
+/* Spans are 16-bit, and uname() fields are at most 65 bytes anyway. */
+#define MAX_TOKENIZED_LENGTH G_MAXUINT16
+
+static void
+set_span (OsVersionSpan *span, const gchar *start, const gchar *p,
+          const gchar *end)
+{
+	span->offset = p - start;
+	span->length = end - p;
+}
+
+static gboolean
+is_version_char (gchar c)
+{
+	return g_ascii_isdigit (c) || c == '.';
+}
+
+/**
+ * os_version_kernel_release_tokenize:
+ * @release: (array length=length): a kernel release string
+ * @length: length of @release in bytes, or -1 if it is nul-terminated
+ * @out: (out caller-allocates): return location for the tokens
+ *
+ * Split a Linux kernel release string into the upstream version, the
+ * distribution ABI, and the flavour. The version is the leading run of digits
+ * and dots. The ABI is the run of digits and dots after the following ‘-’, and
+ * the flavour is everything after the ABI and its separator. For example:
+ *
+ * |[
+ * 5.15.0-91-generic           → 5.15.0, 91, generic
+ * 6.1.0-18-rt-amd64           → 6.1.0, 18, rt-amd64
+ * 5.14.0-362.8.1.el9_3.x86_64 → 5.14.0, 362.8.1, el9_3.x86_64
+ * 6.6.1-arch1-1               → 6.6.1, (absent), arch1-1
+ * ]|
+ *
+ * This never allocates, and tokenizes any input; tokens which are not found
+ * have zero length. Only the first 65535 bytes of @release are considered.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_kernel_release_tokenize (const gchar *release,
+                                    gssize length,
+                                    OsVersionKernelRelease *out)
+{
+	const gchar *p, *token, *end;
+
+	g_return_if_fail (release != NULL || length == 0);
+	g_return_if_fail (out != NULL);
+
+	if (length < 0) {
+		length = strlen (release);
+	}
+
+	memset (out, 0, sizeof (*out));
+	p = release;
+	end = release + MIN (length, MAX_TOKENIZED_LENGTH);
+
+	for (token = p; p < end && is_version_char (*p); p++);
+
+	/* Drop a trailing dot, as in ‘4.4.’. */
+	set_span (&out->version, release, token,
+	          (p > token && *(p - 1) == '.') ? p - 1 : p);
+
+	if (p == end || *p != '-') {
+		/* Local version suffixes such as ‘+’ or ‘-perf+’. */
+		set_span (&out->flavour, release, p, end);
+		return;
+	}
+
+	p++;
+
+	for (token = p; p < end && is_version_char (*p); p++);
+
+	/* Only a run followed by a separator is an ABI; ‘arch1’ is not. */
+	if (p == end || *p == '-' || *p == '_' || *(p - 1) == '.') {
+		if (p > token && *(p - 1) == '.') {
+			p--;
+		}
+
+		set_span (&out->abi, release, token, p);
+
+		if (p < end) {
+			p++;
+		}
+	} else {
+		p = token;
+	}
+
+	set_span (&out->flavour, release, p, end);
+}
+
+static const gchar * const weekdays[] = {
+	"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun",
+};
+
+static const gchar * const months[] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+	"Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+static gboolean
+token_equal (const gchar *token, gsize length, const gchar *str)
+{
+	return (strlen (str) == length && memcmp (token, str, length) == 0);
+}
+
+static gint
+token_index (const gchar *token, gsize length,
+             const gchar * const *strs, gsize n_strs)
+{
+	gsize i;
+
+	for (i = 0; i < n_strs; i++) {
+		if (token_equal (token, length, strs[i])) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* Parse a decimal integer of at most @max_digits digits. */
+static gboolean
+parse_uint (const gchar **p, const gchar *end, guint max_digits, guint *value)
+{
+	const gchar *start = *p;
+
+	*value = 0;
+
+	while (*p < end && g_ascii_isdigit (**p) &&
+	       (guint) (*p - start) < max_digits) {
+		*value = *value * 10 + (**p - '0');
+		(*p)++;
+	}
+
+	return (*p > start);
+}
+
+static gboolean
+expect_char (const gchar **p, const gchar *end, gchar c)
+{
+	if (*p < end && **p == c) {
+		(*p)++;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static gint64
+make_time (guint year, guint month, guint day, guint hour, guint minute,
+           guint second)
+{
+	GDateTime *date_time;
+	gint64 time;
+
+	date_time = g_date_time_new_utc (year, month, day, hour, minute,
+	                                 second);
+
+	if (date_time == NULL) {
+		return -1;
+	}
+
+	time = g_date_time_to_unix (date_time);
+	g_date_time_unref (date_time);
+
+	return time;
+}
+
+/* Parse a `date`-style build date, such as ‘Fri Aug 30 12:02:04 UTC 2024’.
+ * The time zone is ignored, since kernels are almost always built in UTC and
+ * the abbreviation is ambiguous anyway. */
+static gint64
+parse_build_date (const gchar *p, const gchar *end)
+{
+	const gchar *token;
+	gint month;
+	guint day, hour, minute, second, year;
+
+	/* Skip the weekday. */
+	p += 3;
+
+	while (p < end && *p == ' ') {
+		p++;
+	}
+
+	for (token = p; p < end && *p != ' '; p++);
+	month = token_index (token, p - token, months, G_N_ELEMENTS (months));
+
+	while (p < end && *p == ' ') {
+		p++;
+	}
+
+	if (month < 0 ||
+	    !parse_uint (&p, end, 2, &day) || !expect_char (&p, end, ' ') ||
+	    !parse_uint (&p, end, 2, &hour) || !expect_char (&p, end, ':') ||
+	    !parse_uint (&p, end, 2, &minute) || !expect_char (&p, end, ':') ||
+	    !parse_uint (&p, end, 2, &second) || !expect_char (&p, end, ' ')) {
+		return -1;
+	}
+
+	/* Skip the time zone, if present. */
+	if (p < end && !g_ascii_isdigit (*p)) {
+		while (p < end && *p != ' ') {
+			p++;
+		}
+
+		if (!expect_char (&p, end, ' ')) {
+			return -1;
+		}
+	}
+
+	if (!parse_uint (&p, end, 4, &year)) {
+		return -1;
+	}
+
+	return make_time (year, month + 1, day, hour, minute, second);
+}
+
+/* Parse an ISO 8601 date, such as ‘2024-02-01’, as used by Debian. */
+static gint64
+parse_iso_date (const gchar *p, const gchar *end)
+{
+	guint year, month, day;
+
+	if (end - p != 10 ||
+	    !parse_uint (&p, end, 4, &year) || !expect_char (&p, end, '-') ||
+	    !parse_uint (&p, end, 2, &month) || !expect_char (&p, end, '-') ||
+	    !parse_uint (&p, end, 2, &day)) {
+		return -1;
+	}
+
+	return make_time (year, month, day, 0, 0, 0);
+}
+
+/**
+ * os_version_kernel_version_tokenize:
+ * @version: (array length=length): a kernel version string
+ * @length: length of @version in bytes, or -1 if it is nul-terminated
+ * @out: (out caller-allocates): return location for the tokens
+ *
+ * Split a Linux kernel version string into its build number and tag, build
+ * flags, and build date. For example:
+ *
+ * |[
+ * #45-Ubuntu SMP PREEMPT_DYNAMIC Fri Aug 30 12:02:04 UTC 2024
+ * #1 SMP PREEMPT_DYNAMIC Debian 6.1.76-1 (2024-02-01)
+ * ]|
+ *
+ * The build date is either the text from the first weekday name to the end of
+ * the string, or the contents of a trailing parenthesised ISO 8601 date. Other
+ * words, such as ‘Debian 6.1.76-1’ above, are ignored.
+ *
+ * This tokenizes any input; tokens which are not found have zero length. Only
+ * the first 65535 bytes of @version are considered.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_kernel_version_tokenize (const gchar *version,
+                                    gssize length,
+                                    OsVersionKernelVersion *out)
+{
+	const gchar *p, *end;
+
+	g_return_if_fail (version != NULL || length == 0);
+	g_return_if_fail (out != NULL);
+
+	if (length < 0) {
+		length = strlen (version);
+	}
+
+	memset (out, 0, sizeof (*out));
+	out->build_time = -1;
+	p = version;
+	end = version + MIN (length, MAX_TOKENIZED_LENGTH);
+
+	if (p < end && *p == '#') {
+		const gchar *token;
+
+		for (token = ++p; p < end && g_ascii_isdigit (*p); p++);
+		set_span (&out->build_number, version, token, p);
+
+		if (p < end && *p == '-') {
+			for (token = ++p; p < end && *p != ' '; p++);
+			set_span (&out->build_tag, version, token, p);
+		}
+	}
+
+	while (p < end) {
+		const gchar *token;
+		gsize token_length;
+
+		while (p < end && *p == ' ') {
+			p++;
+		}
+
+		for (token = p; p < end && *p != ' '; p++);
+		token_length = p - token;
+
+		if (token_length == 0) {
+			break;
+		} else if (token_equal (token, token_length, "SMP")) {
+			out->flags |= OS_VERSION_KERNEL_FLAGS_SMP;
+		} else if (token_equal (token, token_length, "PREEMPT")) {
+			out->flags |= OS_VERSION_KERNEL_FLAGS_PREEMPT;
+		} else if (token_equal (token, token_length,
+		                        "PREEMPT_DYNAMIC")) {
+			out->flags |= OS_VERSION_KERNEL_FLAGS_PREEMPT_DYNAMIC;
+		} else if (token_equal (token, token_length, "PREEMPT_RT") ||
+		           token_equal (token, token_length, "RT")) {
+			out->flags |= OS_VERSION_KERNEL_FLAGS_PREEMPT_RT;
+		} else if (token_index (token, token_length, weekdays,
+		                        G_N_ELEMENTS (weekdays)) >= 0) {
+			set_span (&out->build_date, version, token, end);
+			out->build_time = parse_build_date (token, end);
+			break;
+		} else if (token_length > 2 && token[0] == '(' &&
+		           token[token_length - 1] == ')') {
+			set_span (&out->build_date, version, token + 1, p - 1);
+			out->build_time = parse_iso_date (token + 1, p - 1);
+		}
+	}
+}
+
+/* Each version string has one slot, chosen by its hash. A string whose slot is
+ * taken replaces the string there, so misses evict a single entry rather than
+ * the whole cache. */
+typedef struct {
+	gchar *version;  /* owned; %NULL if the slot is empty */
+	OsVersionKernelVersion tokens;
+} VersionSlot;
+
+struct _OsVersionKernelCache {
+	VersionSlot *slots;
+	gsize mask;  /* number of slots - 1 */
+};
+
+/**
+ * os_version_kernel_cache_new:
+ * @max_entries: number of version strings to cache; rounded up to a power of
+ *    two
+ *
+ * Create a cache for tokenizing kernel version strings. Servers see the same
+ * few strings in most reports, so caching avoids tokenizing each of them
+ * repeatedly. Each string is cached in a slot chosen by its hash, replacing any
+ * other string there, so a working set well below @max_entries is rarely
+ * evicted.
+ *
+ * Release strings are cheaper to tokenize than to look up, so tokenize them
+ * with os_version_kernel_release_tokenize() directly.
+ *
+ * The cache is not thread-safe.
+ *
+ * Returns: (transfer full): a new #OsVersionKernelCache
+ *
+ * Since: UNRELEASED
+ */
+OsVersionKernelCache *
+os_version_kernel_cache_new (guint max_entries)
+{
+	OsVersionKernelCache *self;
+	gsize n_slots = 1;
+
+	g_return_val_if_fail (max_entries > 0, NULL);
+
+	while (n_slots < max_entries) {
+		n_slots *= 2;
+	}
+
+	self = g_slice_new0 (OsVersionKernelCache);
+	self->slots = g_new0 (VersionSlot, n_slots);
+	self->mask = n_slots - 1;
+
+	return self;
+}
+
+/**
+ * os_version_kernel_cache_free:
+ * @self: (transfer full): an #OsVersionKernelCache
+ *
+ * Free a cache.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_kernel_cache_free (OsVersionKernelCache *self)
+{
+	gsize i;
+
+	g_return_if_fail (self != NULL);
+
+	for (i = 0; i <= self->mask; i++) {
+		g_free (self->slots[i].version);
+	}
+
+	g_free (self->slots);
+	g_slice_free (OsVersionKernelCache, self);
+}
+
+/**
+ * os_version_kernel_cache_tokenize_version:
+ * @self: an #OsVersionKernelCache
+ * @version: a nul-terminated kernel version string
+ * @out: (out caller-allocates): return location for the tokens
+ *
+ * Tokenize @version as with os_version_kernel_version_tokenize(), using a
+ * cached result if @version is still in the cache.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_kernel_cache_tokenize_version (OsVersionKernelCache *self,
+                                          const gchar *version,
+                                          OsVersionKernelVersion *out)
+{
+	VersionSlot *slot;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (version != NULL);
+	g_return_if_fail (out != NULL);
+
+	slot = &self->slots[g_str_hash (version) & self->mask];
+
+	if (slot->version == NULL || strcmp (slot->version, version) != 0) {
+		g_free (slot->version);
+		slot->version = g_strdup (version);
+		os_version_kernel_version_tokenize (version, -1, &slot->tokens);
+	}
+
+	*out = slot->tokens;
+}
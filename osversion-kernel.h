@@ -0,0 +1,138 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_KERNEL_H_
+#define _OS_VERSION_KERNEL_H_
+
+
+/**
+ * OsVersionSpan:
+ * @offset: offset of the token in the tokenized string, in bytes
+ * @length: length of the token in bytes, or 0 if it is absent
+ *
+ * Location of a token within a tokenized string. Tokens refer to the input
+ * string rather than copying from it.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+	guint16 offset;
+	guint16 length;
+} OsVersionSpan;
+
+/**
+ * OsVersionKernelRelease:
+ * @version: upstream kernel version, such as ‘5.15.0’
+ * @abi: distribution ABI or package revision, such as ‘91’ or ‘362.8.1’
+ * @flavour: remainder of the release after the ABI, such as ‘generic’,
+ *    ‘rt-amd64’ or ‘el9_3.x86_64’
+ *
+ * Sub-fields of a Linux kernel release string, as returned in the
+ * `release` field of `uname()`. Absent tokens have zero length.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+	OsVersionSpan version;
+	OsVersionSpan abi;
+	OsVersionSpan flavour;
+} OsVersionKernelRelease;
+
+/**
+ * OsVersionKernelFlags:
+ * @OS_VERSION_KERNEL_FLAGS_NONE: No flags set.
+ * @OS_VERSION_KERNEL_FLAGS_SMP: The kernel was built with SMP support.
+ * @OS_VERSION_KERNEL_FLAGS_PREEMPT: The kernel is fully preemptible.
+ * @OS_VERSION_KERNEL_FLAGS_PREEMPT_DYNAMIC: The preemption model can be chosen
+ *    at boot.
+ * @OS_VERSION_KERNEL_FLAGS_PREEMPT_RT: The kernel has real-time preemption.
+ *
+ * Build flags listed in a Linux kernel version string.
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_KERNEL_FLAGS_NONE = 0,
+	OS_VERSION_KERNEL_FLAGS_SMP = (1 << 0),
+	OS_VERSION_KERNEL_FLAGS_PREEMPT = (1 << 1),
+	OS_VERSION_KERNEL_FLAGS_PREEMPT_DYNAMIC = (1 << 2),
+	OS_VERSION_KERNEL_FLAGS_PREEMPT_RT = (1 << 3),
+} OsVersionKernelFlags;
+
+/**
+ * OsVersionKernelVersion:
+ * @build_number: build counter, such as ‘45’ in ‘#45-Ubuntu’
+ * @build_tag: text following the build counter, such as ‘Ubuntu’
+ * @flags: build flags
+ * @build_date: the build date as written in the version string
+ * @build_time: the build date as a UNIX timestamp, or -1 if it could not be
+ *    parsed
+ *
+ * Sub-fields of a Linux kernel version string, as returned in the `version`
+ * field of `uname()`. Absent tokens have zero length.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+	OsVersionSpan build_number;
+	OsVersionSpan build_tag;
+	OsVersionKernelFlags flags;
+	OsVersionSpan build_date;
+	gint64 build_time;
+} OsVersionKernelVersion;
+
+/**
+ * OsVersionKernelCache:
+ *
+ * A cache of tokenized kernel version strings. All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionKernelCache OsVersionKernelCache;
+
+void
+os_version_kernel_release_tokenize (const gchar *release,
+                                    gssize length,
+                                    OsVersionKernelRelease *out);
+
+void
+os_version_kernel_version_tokenize (const gchar *version,
+                                    gssize length,
+                                    OsVersionKernelVersion *out);
+
+OsVersionKernelCache *
+os_version_kernel_cache_new (guint max_entries);
+
+void
+os_version_kernel_cache_free (OsVersionKernelCache *self);
+
+void
+os_version_kernel_cache_tokenize_version (OsVersionKernelCache *self,
+                                          const gchar *version,
+                                          OsVersionKernelVersion *out);
+
+
+#endif /* _OS_VERSION_KERNEL_H_ */
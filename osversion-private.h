@@ -0,0 +1,61 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-probe.h"
+
+
+#ifndef _OS_VERSION_PRIVATE_H_
+#define _OS_VERSION_PRIVATE_H_
+
+
+G_GNUC_INTERNAL void
+os_version_append_formatted (GString *out,
+                             const gchar * const *fields,
+                             gssize n_fields,
+                             OsVersionFormatFlags flags);
+
+G_GNUC_INTERNAL gboolean
+os_version_scan_field (const gchar *report,
+                       const gchar **p,
+                       const gchar *end,
+                       gboolean first,
+                       const gchar **field,
+                       gsize *field_length,
+                       gboolean *escaped,
+                       GError **error);
+
+G_GNUC_INTERNAL OsVersionCpuVulnerabilityStatus
+os_version_parse_cpu_vulnerability_status (const gchar *contents);
+
+G_GNUC_INTERNAL gchar *
+os_version_parse_selected_option (const gchar *contents);
+
+G_GNUC_INTERNAL guint64
+os_version_get_meminfo_value (const gchar *meminfo,
+                              const gchar *key);
+
+
+#endif /* _OS_VERSION_PRIVATE_H_ */
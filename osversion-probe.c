@@ -0,0 +1,460 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "osversion-probe.h"
+#include "osversion-private.h"
+
+
+#ifdef __linux__
+/* Defined here, as the libc headers may be older than the kernel. */
+#define PROBE_MFD_CLOEXEC 0x0001U
+#define PROBE_MFD_NOEXEC_SEAL 0x0008U
+#define PROBE_LANDLOCK_CREATE_RULESET_VERSION (1U << 0)
+
+/* Each probe makes a harmless call which fails with %ENOSYS (or %EPERM, under
+ * a seccomp filter or sysctl) if the facility is unusable, and with some other
+ * error, or not at all, if it is. */
+static OsVersionKernelCaps
+probe_kernel_caps (void)
+{
+	OsVersionKernelCaps caps = OS_VERSION_KERNEL_CAPS_NONE;
+	long ret;
+	int saved_errno = errno;
+
+#ifdef SYS_io_uring_setup
+	/* The parameters are read before anything else is done. */
+	ret = syscall (SYS_io_uring_setup, 0, NULL);
+
+	if (ret >= 0) {
+		close (ret);
+		caps |= OS_VERSION_KERNEL_CAPS_IO_URING;
+	} else if (errno == EFAULT || errno == EINVAL) {
+		caps |= OS_VERSION_KERNEL_CAPS_IO_URING;
+	}
+#endif
+
+#ifdef SYS_pidfd_open
+	ret = syscall (SYS_pidfd_open, getpid (), 0);
+
+	if (ret >= 0) {
+		close (ret);
+		caps |= OS_VERSION_KERNEL_CAPS_PIDFD;
+	}
+#endif
+
+#ifdef SYS_memfd_create
+	/* Probe each form independently: with the vm.memfd_noexec sysctl set
+	 * to 2, memfd_create() fails with %EACCES unless `MFD_NOEXEC_SEAL` is
+	 * passed. Older kernels reject the unknown flag with %EINVAL. */
+	ret = syscall (SYS_memfd_create, "os-version-probe", PROBE_MFD_CLOEXEC);
+
+	if (ret >= 0) {
+		close (ret);
+		caps |= OS_VERSION_KERNEL_CAPS_MEMFD;
+	}
+
+	ret = syscall (SYS_memfd_create, "os-version-probe",
+	               PROBE_MFD_CLOEXEC | PROBE_MFD_NOEXEC_SEAL);
+
+	if (ret >= 0) {
+		close (ret);
+		caps |= OS_VERSION_KERNEL_CAPS_MEMFD |
+		        OS_VERSION_KERNEL_CAPS_MEMFD_NOEXEC_SEAL;
+	}
+#endif
+
+#ifdef SYS_landlock_create_ruleset
+	/* Returns the ABI version, or fails with %EOPNOTSUPP if Landlock is
+	 * disabled at boot. */
+	ret = syscall (SYS_landlock_create_ruleset, NULL, 0,
+	               PROBE_LANDLOCK_CREATE_RULESET_VERSION);
+
+	if (ret >= 1) {
+		caps |= OS_VERSION_KERNEL_CAPS_LANDLOCK;
+	}
+#endif
+
+#ifdef SYS_copy_file_range
+	/* The file descriptors are checked first. */
+	ret = syscall (SYS_copy_file_range, -1, NULL, -1, NULL, 0, 0);
+
+	if (ret >= 0 || errno == EBADF) {
+		caps |= OS_VERSION_KERNEL_CAPS_COPY_FILE_RANGE;
+	}
+#endif
+
+	errno = saved_errno;
+
+	return caps;
+}
+#endif /* __linux__ */
+
+/**
+ * os_version_get_kernel_caps:
+ *
+ * Get the set of kernel facilities which are usable by the current process,
+ * so that code can choose between implementations with a bit test rather than
+ * by comparing kernel version numbers, which distributions’ backports make
+ * unreliable.
+ *
+ * The kernel is probed on the first call, using a few cheap system calls, and
+ * the result is cached for the lifetime of the process. It is safe to call
+ * from multiple threads. On platforms other than Linux, no capabilities are
+ * returned.
+ *
+ * Returns: the usable kernel facilities
+ *
+ * Since: UNRELEASED
+ */
+OsVersionKernelCaps
+os_version_get_kernel_caps (void)
+{
+	static gsize caps_once = 0;
+
+	if (g_once_init_enter (&caps_once)) {
+		OsVersionKernelCaps caps = OS_VERSION_KERNEL_CAPS_NONE;
+
+#ifdef __linux__
+		caps = probe_kernel_caps ();
+#endif
+
+		/* Offset by one, as zero means ‘not yet probed’. */
+		g_once_init_leave (&caps_once, (gsize) caps + 1);
+	}
+
+	return (OsVersionKernelCaps) (caps_once - 1);
+}
+
+/* Indexed by #OsVersionCpuVulnerability. */
+static const gchar * const cpu_vulnerability_names[] = {
+	"meltdown",
+	"spectre_v1",
+	"spectre_v2",
+	"spec_store_bypass",
+	"l1tf",
+	"mds",
+	"tsx_async_abort",
+	"itlb_multihit",
+	"srbds",
+	"mmio_stale_data",
+	"retbleed",
+	"gather_data_sampling",
+	"spec_rstack_overflow",
+	"reg_file_data_sampling",
+	"indirect_target_selection",
+	"tsa",
+	"old_microcode",
+	"ghostwrite",
+	"vmscape",
+};
+
+G_STATIC_ASSERT (G_N_ELEMENTS (cpu_vulnerability_names) ==
+                 OS_VERSION_N_CPU_VULNERABILITIES);
+
+/* Indexed by #OsVersionCpuVulnerabilityStatus. */
+static const gchar cpu_vulnerability_status_chars[] = "-NMV";
+
+/* Classify the contents of a vulnerabilities file by its prefix, such as
+ * ‘Mitigation: PTI’ or ‘KVM: Vulnerable’. Anything after the prefix, such as
+ * ‘; SMT vulnerable’, qualifies the status rather than changing it. */
+OsVersionCpuVulnerabilityStatus
+os_version_parse_cpu_vulnerability_status (const gchar *contents)
+{
+	if (g_str_has_prefix (contents, "KVM: ")) {
+		contents += strlen ("KVM: ");
+	}
+
+	if (g_str_has_prefix (contents, "Not affected")) {
+		return OS_VERSION_CPU_VULNERABILITY_STATUS_NOT_AFFECTED;
+	} else if (g_str_has_prefix (contents, "Mitigation")) {
+		return OS_VERSION_CPU_VULNERABILITY_STATUS_MITIGATED;
+	} else if (g_str_has_prefix (contents, "Vulnerable") ||
+	           g_str_has_prefix (contents, "Processor vulnerable")) {
+		return OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE;
+	} else {
+		return OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN;
+	}
+}
+
+/* The status of each vulnerability, and the same encoded as a string with one
+ * status character per vulnerability. */
+typedef struct {
+	guint8 statuses[OS_VERSION_N_CPU_VULNERABILITIES];
+	gchar chars[OS_VERSION_N_CPU_VULNERABILITIES + 1];
+} CpuVulnerabilities;
+
+/* Read and classify the vulnerabilities file for @vulnerability. */
+static OsVersionCpuVulnerabilityStatus
+probe_cpu_vulnerability (OsVersionCpuVulnerability vulnerability)
+{
+	OsVersionCpuVulnerabilityStatus status;
+	gchar *path, *contents;
+
+	status = OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN;
+	path = g_build_filename ("/sys/devices/system/cpu/vulnerabilities",
+	                         cpu_vulnerability_names[vulnerability], NULL);
+
+	if (g_file_get_contents (path, &contents, NULL, NULL)) {
+		status = os_version_parse_cpu_vulnerability_status (contents);
+		g_free (contents);
+	}
+
+	g_free (path);
+
+	return status;
+}
+
+/* Probe all the vulnerabilities once. */
+static const CpuVulnerabilities *
+get_cpu_vulnerabilities_cache (void)
+{
+	static gsize cache_once = 0;
+	static CpuVulnerabilities cache;
+
+	if (g_once_init_enter (&cache_once)) {
+		guint i;
+
+		for (i = 0; i < OS_VERSION_N_CPU_VULNERABILITIES; i++) {
+			OsVersionCpuVulnerabilityStatus status;
+
+			status = probe_cpu_vulnerability (i);
+			cache.statuses[i] = status;
+			cache.chars[i] = cpu_vulnerability_status_chars[status];
+		}
+
+		cache.chars[OS_VERSION_N_CPU_VULNERABILITIES] = '\0';
+		g_once_init_leave (&cache_once, 1);
+	}
+
+	return &cache;
+}
+
+/**
+ * os_version_get_cpu_vulnerability_status:
+ * @vulnerability: a CPU vulnerability
+ *
+ * Get the mitigation status of @vulnerability on the running system, as
+ * reported by Linux. All vulnerabilities are probed on the first call, and
+ * the results are cached for the lifetime of the process.
+ *
+ * Returns: the status of @vulnerability
+ *
+ * Since: UNRELEASED
+ */
+OsVersionCpuVulnerabilityStatus
+os_version_get_cpu_vulnerability_status (OsVersionCpuVulnerability vulnerability)
+{
+	g_return_val_if_fail (vulnerability < OS_VERSION_N_CPU_VULNERABILITIES,
+	                      OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN);
+
+	return get_cpu_vulnerabilities_cache ()->statuses[vulnerability];
+}
+
+/**
+ * os_version_get_cpu_vulnerabilities:
+ *
+ * Get the mitigation status of all known CPU vulnerabilities on the running
+ * system, encoded as a string with one character per
+ * #OsVersionCpuVulnerability, in order: ‘N’ if not affected, ‘M’ if
+ * mitigated, ‘V’ if vulnerable, or ‘-’ if unknown. For example, a string
+ * starting ‘NMMM’ means the CPU is not affected by Meltdown, and Spectre
+ * variants 1 and 2 and Speculative Store Bypass are mitigated.
+ *
+ * This is the value of the `OS_CPU_VULNERABILITIES` field of the report on
+ * Linux. Older kernels report fewer vulnerabilities, so trailing characters
+ * are typically ‘-’; servers should treat a shorter string as if padded with
+ * ‘-’, so that new vulnerabilities can be appended.
+ *
+ * Returns: (transfer none): the cached status string
+ *
+ * Since: UNRELEASED
+ */
+const gchar *
+os_version_get_cpu_vulnerabilities (void)
+{
+	return get_cpu_vulnerabilities_cache ()->chars;
+}
+
+/* Read a single-line sysfs file, without its trailing newline. */
+static gchar *
+read_sysfs_line (const gchar *path)
+{
+	gchar *contents;
+
+	if (!g_file_get_contents (path, &contents, NULL, NULL)) {
+		return NULL;
+	}
+
+	return g_strchomp (contents);
+}
+
+/* Get the selected option from the contents of a sysfs file listing the
+ * options, such as ‘always [madvise] never’. */
+gchar *
+os_version_parse_selected_option (const gchar *contents)
+{
+	const gchar *start, *end;
+
+	start = strchr (contents, '[');
+	end = (start != NULL) ? strchr (start, ']') : NULL;
+
+	if (end == NULL) {
+		return NULL;
+	}
+
+	return g_strndup (start + 1, end - start - 1);
+}
+
+/* Get the selected option from a sysfs file listing the options. */
+static gchar *
+read_sysfs_selected_option (const gchar *path)
+{
+	gchar *contents, *option;
+
+	contents = read_sysfs_line (path);
+
+	if (contents == NULL) {
+		return NULL;
+	}
+
+	option = os_version_parse_selected_option (contents);
+	g_free (contents);
+
+	return option;
+}
+
+/* Get a value from /proc/meminfo, such as ‘HugePages_Total’, multiplied by
+ * 1024 if it is given in kB. */
+guint64
+os_version_get_meminfo_value (const gchar *meminfo, const gchar *key)
+{
+	const gchar *line;
+	gchar *end;
+	guint64 value;
+	gsize key_length = strlen (key);
+
+	for (line = meminfo; line != NULL; line = strchr (line, '\n')) {
+		if (*line == '\n') {
+			line++;
+		}
+
+		if (strncmp (line, key, key_length) == 0 &&
+		    line[key_length] == ':') {
+			value = g_ascii_strtoull (line + key_length + 1, &end,
+			                          10);
+
+			while (*end == ' ') {
+				end++;
+			}
+
+			if (g_str_has_prefix (end, "kB")) {
+				value *= 1024;
+			}
+
+			return value;
+		}
+	}
+
+	return 0;
+}
+
+/* Get the persistent hugepage pool from /proc/meminfo, leaving @info
+ * unchanged if it cannot be read. */
+static void
+probe_hugepages (OsVersionTimingInfo *info)
+{
+	gchar *meminfo;
+
+	if (!g_file_get_contents ("/proc/meminfo", &meminfo, NULL, NULL)) {
+		return;
+	}
+
+	info->n_hugepages = os_version_get_meminfo_value (meminfo,
+	                                                  "HugePages_Total");
+	info->hugepage_size = os_version_get_meminfo_value (meminfo,
+	                                                    "Hugepagesize");
+	g_free (meminfo);
+}
+
+/**
+ * os_version_get_timing_info:
+ *
+ * Get configuration of the running system which affects timing and latency:
+ * the kernel clocksource, the transparent hugepage mode, and the persistent
+ * hugepage pool. These are reported by Linux in
+ * `/sys/devices/system/clocksource/clocksource0/current_clocksource`,
+ * `/sys/kernel/mm/transparent_hugepage/enabled` and `/proc/meminfo`.
+ *
+ * The system is probed on the first call, and the result is cached for the
+ * lifetime of the process, so later changes to the configuration are not seen.
+ * The number of free hugepages varies too quickly to be cached, so is not
+ * included.
+ *
+ * Returns: (transfer none): the cached timing information
+ *
+ * Since: UNRELEASED
+ */
+const OsVersionTimingInfo *
+os_version_get_timing_info (void)
+{
+	static gsize info_once = 0;
+	static OsVersionTimingInfo info = { NULL, };
+
+	if (g_once_init_enter (&info_once)) {
+		gchar *clocksource, *thp_mode;
+
+		/* The kernel registers a single clocksource device, numbered
+		 * 0, as the current clocksource is system-wide. The other
+		 * registered clocksources are only listed in its
+		 * available_clocksource file, so there is nothing to find by
+		 * iterating over clocksource*. */
+		clocksource = read_sysfs_line ("/sys/devices/system/"
+		                               "clocksource/clocksource0/"
+		                               "current_clocksource");
+		thp_mode = read_sysfs_selected_option ("/sys/kernel/mm/"
+		                                       "transparent_hugepage/"
+		                                       "enabled");
+
+		info.clocksource = (clocksource != NULL) ?
+		                   clocksource : "Unknown";
+		info.thp_mode = (thp_mode != NULL) ? thp_mode : "Unknown";
+
+		probe_hugepages (&info);
+
+		g_once_init_leave (&info_once, 1);
+	}
+
+	return &info;
+}
@@ -0,0 +1,167 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_PROBE_H_
+#define _OS_VERSION_PROBE_H_
+
+
+/**
+ * OsVersionKernelCaps:
+ * @OS_VERSION_KERNEL_CAPS_NONE: No capabilities are usable.
+ * @OS_VERSION_KERNEL_CAPS_IO_URING: io_uring_setup() is usable.
+ * @OS_VERSION_KERNEL_CAPS_PIDFD: pidfd_open() is usable.
+ * @OS_VERSION_KERNEL_CAPS_MEMFD: memfd_create() is usable, though possibly
+ *    only with `MFD_NOEXEC_SEAL`, if the vm.memfd_noexec sysctl requires it.
+ * @OS_VERSION_KERNEL_CAPS_MEMFD_NOEXEC_SEAL: memfd_create() supports
+ *    `MFD_NOEXEC_SEAL`.
+ * @OS_VERSION_KERNEL_CAPS_LANDLOCK: Landlock is enabled.
+ * @OS_VERSION_KERNEL_CAPS_COPY_FILE_RANGE: copy_file_range() is usable.
+ *
+ * Kernel facilities which are usable by the current process. A facility is
+ * only usable if the kernel supports it and it is not disabled by
+ * configuration, a sysctl or a seccomp filter.
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_KERNEL_CAPS_NONE = 0,
+	OS_VERSION_KERNEL_CAPS_IO_URING = (1 << 0),
+	OS_VERSION_KERNEL_CAPS_PIDFD = (1 << 1),
+	OS_VERSION_KERNEL_CAPS_MEMFD = (1 << 2),
+	OS_VERSION_KERNEL_CAPS_MEMFD_NOEXEC_SEAL = (1 << 3),
+	OS_VERSION_KERNEL_CAPS_LANDLOCK = (1 << 4),
+	OS_VERSION_KERNEL_CAPS_COPY_FILE_RANGE = (1 << 5),
+} OsVersionKernelCaps;
+
+/**
+ * OsVersionCpuVulnerability:
+ * @OS_VERSION_CPU_VULNERABILITY_MELTDOWN: Meltdown
+ * @OS_VERSION_CPU_VULNERABILITY_SPECTRE_V1: Spectre variant 1
+ * @OS_VERSION_CPU_VULNERABILITY_SPECTRE_V2: Spectre variant 2
+ * @OS_VERSION_CPU_VULNERABILITY_SPEC_STORE_BYPASS: Speculative Store Bypass
+ * @OS_VERSION_CPU_VULNERABILITY_L1TF: L1 Terminal Fault
+ * @OS_VERSION_CPU_VULNERABILITY_MDS: Microarchitectural Data Sampling
+ * @OS_VERSION_CPU_VULNERABILITY_TSX_ASYNC_ABORT: TSX Asynchronous Abort
+ * @OS_VERSION_CPU_VULNERABILITY_ITLB_MULTIHIT: iTLB multihit
+ * @OS_VERSION_CPU_VULNERABILITY_SRBDS: Special Register Buffer Data Sampling
+ * @OS_VERSION_CPU_VULNERABILITY_MMIO_STALE_DATA: MMIO Stale Data
+ * @OS_VERSION_CPU_VULNERABILITY_RETBLEED: Retbleed
+ * @OS_VERSION_CPU_VULNERABILITY_GATHER_DATA_SAMPLING: Gather Data Sampling
+ * @OS_VERSION_CPU_VULNERABILITY_SPEC_RSTACK_OVERFLOW: Speculative Return Stack
+ *    Overflow
+ * @OS_VERSION_CPU_VULNERABILITY_REG_FILE_DATA_SAMPLING: Register File Data
+ *    Sampling
+ * @OS_VERSION_CPU_VULNERABILITY_INDIRECT_TARGET_SELECTION: Indirect Target
+ *    Selection
+ * @OS_VERSION_CPU_VULNERABILITY_TSA: Transient Scheduler Attacks
+ * @OS_VERSION_CPU_VULNERABILITY_OLD_MICROCODE: Outdated microcode
+ * @OS_VERSION_CPU_VULNERABILITY_GHOSTWRITE: GhostWrite
+ * @OS_VERSION_CPU_VULNERABILITY_VMSCAPE: VMScape
+ * @OS_VERSION_N_CPU_VULNERABILITIES: Number of known vulnerabilities.
+ *
+ * CPU vulnerabilities reported by Linux in
+ * `/sys/devices/system/cpu/vulnerabilities`, in the order they were added.
+ * New vulnerabilities are only ever appended.
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_CPU_VULNERABILITY_MELTDOWN,
+	OS_VERSION_CPU_VULNERABILITY_SPECTRE_V1,
+	OS_VERSION_CPU_VULNERABILITY_SPECTRE_V2,
+	OS_VERSION_CPU_VULNERABILITY_SPEC_STORE_BYPASS,
+	OS_VERSION_CPU_VULNERABILITY_L1TF,
+	OS_VERSION_CPU_VULNERABILITY_MDS,
+	OS_VERSION_CPU_VULNERABILITY_TSX_ASYNC_ABORT,
+	OS_VERSION_CPU_VULNERABILITY_ITLB_MULTIHIT,
+	OS_VERSION_CPU_VULNERABILITY_SRBDS,
+	OS_VERSION_CPU_VULNERABILITY_MMIO_STALE_DATA,
+	OS_VERSION_CPU_VULNERABILITY_RETBLEED,
+	OS_VERSION_CPU_VULNERABILITY_GATHER_DATA_SAMPLING,
+	OS_VERSION_CPU_VULNERABILITY_SPEC_RSTACK_OVERFLOW,
+	OS_VERSION_CPU_VULNERABILITY_REG_FILE_DATA_SAMPLING,
+	OS_VERSION_CPU_VULNERABILITY_INDIRECT_TARGET_SELECTION,
+	OS_VERSION_CPU_VULNERABILITY_TSA,
+	OS_VERSION_CPU_VULNERABILITY_OLD_MICROCODE,
+	OS_VERSION_CPU_VULNERABILITY_GHOSTWRITE,
+	OS_VERSION_CPU_VULNERABILITY_VMSCAPE,
+	OS_VERSION_N_CPU_VULNERABILITIES,
+} OsVersionCpuVulnerability;
+
+/**
+ * OsVersionCpuVulnerabilityStatus:
+ * @OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN: The status is not reported by
+ *    the kernel, or was not understood.
+ * @OS_VERSION_CPU_VULNERABILITY_STATUS_NOT_AFFECTED: The CPU is not affected.
+ * @OS_VERSION_CPU_VULNERABILITY_STATUS_MITIGATED: The CPU is affected, and a
+ *    mitigation is in use.
+ * @OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE: The CPU is affected, and is
+ *    not mitigated.
+ *
+ * Mitigation status of a CPU vulnerability.
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN,
+	OS_VERSION_CPU_VULNERABILITY_STATUS_NOT_AFFECTED,
+	OS_VERSION_CPU_VULNERABILITY_STATUS_MITIGATED,
+	OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE,
+} OsVersionCpuVulnerabilityStatus;
+
+/**
+ * OsVersionTimingInfo:
+ * @clocksource: the current kernel clocksource, such as ‘tsc’ or ‘hpet’
+ * @thp_mode: the transparent hugepage mode: ‘always’, ‘madvise’ or ‘never’
+ * @n_hugepages: number of persistent hugepages configured
+ * @hugepage_size: size of the default hugepages, in bytes
+ *
+ * System configuration which affects timing and latency. String fields are
+ * ‘Unknown’, and numeric fields 0, if they could not be probed.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+	const gchar *clocksource;
+	const gchar *thp_mode;
+	guint64 n_hugepages;
+	guint64 hugepage_size;
+} OsVersionTimingInfo;
+
+OsVersionKernelCaps
+os_version_get_kernel_caps (void);
+
+const OsVersionTimingInfo *
+os_version_get_timing_info (void);
+
+OsVersionCpuVulnerabilityStatus
+os_version_get_cpu_vulnerability_status (OsVersionCpuVulnerability vulnerability);
+
+const gchar *
+os_version_get_cpu_vulnerabilities (void);
+
+
+#endif /* _OS_VERSION_PROBE_H_ */
@@ -0,0 +1,723 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "osversion.h"
+#include "osversion-queue.h"
+
+/* The queue writes to its sink with writev() and sendmsg(). */
+#ifdef G_OS_UNIX
+
+/*
+ * Records are queued in memory until os_version_report_queue_flush() is
+ * called, then written to the sink as newline-terminated lines using as few
+ * writev() calls (or sendmsg() calls, for sockets) as possible. If there is no
+ * sink, the records are appended to the spool file instead. On the next flush
+ * to a sink, the spool file is mapped and sent in the same batch as the queued
+ * records, ahead of them.
+ *
+ * If sending fails part way through, the spool file is replaced with
+ * everything which was not sent, starting at the beginning of the record
+ * which was cut off. That record may be received twice, once truncated, but
+ * the next connection always starts with a whole record. Records are only
+ * removed from the queue once they have been sent or written to the spool
+ * file, so nothing is lost if the spool file cannot be written; at worst,
+ * some records are sent twice.
+ *
+ * When the queue is full, duplicate records (those with the same fingerprint
+ * as another queued record) are dropped before unique ones, since the server
+ * gains little from receiving the same report twice in one batch.
+ */
+
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+/* Without MSG_NOSIGNAL, writing to a socket whose peer has gone raises
+ * SIGPIPE, which callers must ignore; see os_version_report_queue_set_sink(). */
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+typedef struct {
+	guint64 fingerprint;
+	gsize length;
+	gchar data[];  /* length @length + 1, newline-terminated */
+} Record;
+
+typedef struct {
+	guint64 fingerprint;
+	guint count;
+} FingerprintCount;
+
+struct _OsVersionReportQueue {
+	gchar *spool_path;  /* owned */
+	gint sink_fd;  /* unowned; -1 if offline */
+	gboolean sink_is_socket;
+	guint max_records;
+
+	GPtrArray/*<owned Record>*/ *records;  /* oldest first */
+	GHashTable/*<unowned guint64, owned FingerprintCount>*/ *fingerprints;
+	guint64 n_dropped;
+};
+
+static void
+fingerprint_ref (OsVersionReportQueue *self, guint64 fingerprint)
+{
+	FingerprintCount *count;
+
+	count = g_hash_table_lookup (self->fingerprints, &fingerprint);
+
+	if (count == NULL) {
+		count = g_new (FingerprintCount, 1);
+		count->fingerprint = fingerprint;
+		count->count = 0;
+		g_hash_table_insert (self->fingerprints, &count->fingerprint,
+		                     count);
+	}
+
+	count->count++;
+}
+
+static void
+fingerprint_unref (OsVersionReportQueue *self, guint64 fingerprint)
+{
+	FingerprintCount *count;
+
+	count = g_hash_table_lookup (self->fingerprints, &fingerprint);
+	g_assert (count != NULL);
+
+	if (--count->count == 0) {
+		g_hash_table_remove (self->fingerprints, &fingerprint);
+	}
+}
+
+static guint
+fingerprint_get_count (OsVersionReportQueue *self, guint64 fingerprint)
+{
+	FingerprintCount *count;
+
+	count = g_hash_table_lookup (self->fingerprints, &fingerprint);
+
+	return (count != NULL) ? count->count : 0;
+}
+
+static void
+queue_remove_index (OsVersionReportQueue *self, guint index)
+{
+	Record *record = g_ptr_array_index (self->records, index);
+
+	fingerprint_unref (self, record->fingerprint);
+	g_ptr_array_remove_index (self->records, index);
+}
+
+static void
+queue_clear (OsVersionReportQueue *self)
+{
+	g_ptr_array_set_size (self->records, 0);
+	g_hash_table_remove_all (self->fingerprints);
+}
+
+/* Write all of @iov to @fd, coping with short writes. Sockets are written
+ * with sendmsg() so a closed connection fails with EPIPE rather than raising
+ * SIGPIPE. On failure, *@written is set to the number of bytes which were
+ * written. */
+static gboolean
+writev_all (gint fd, gboolean is_socket, struct iovec *iov, gint n_iov,
+            gsize *written, GError **error)
+{
+	*written = 0;
+
+	while (n_iov > 0) {
+		gssize n;
+
+		if (is_socket) {
+			struct msghdr message;
+
+			memset (&message, 0, sizeof (message));
+			message.msg_iov = iov;
+			message.msg_iovlen = MIN (n_iov, IOV_MAX);
+
+			n = sendmsg (fd, &message, SEND_FLAGS);
+		} else {
+			n = writev (fd, iov, MIN (n_iov, IOV_MAX));
+		}
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0) {
+			gint errsv = errno;
+
+			g_set_error (error, G_FILE_ERROR,
+			             g_file_error_from_errno (errsv),
+			             "Error writing reports: %s",
+			             g_strerror (errsv));
+			return FALSE;
+		}
+
+		*written += n;
+
+		/* Skip the vectors which were completely written. */
+		while (n_iov > 0 && (gsize) n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			n_iov--;
+		}
+
+		if (n_iov > 0) {
+			iov->iov_base = (guint8 *) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Build an iovec pointing at @prefix, if it is non-empty, and then at each
+ * queued record. */
+static struct iovec *
+queue_build_iov (OsVersionReportQueue *self,
+                 const gchar *prefix,
+                 gsize prefix_length,
+                 gint *n_iov)
+{
+	struct iovec *iov;
+	guint i;
+
+	iov = g_new (struct iovec, self->records->len + 1);
+	*n_iov = 0;
+
+	if (prefix_length > 0) {
+		iov[*n_iov].iov_base = (gchar *) prefix;
+		iov[*n_iov].iov_len = prefix_length;
+		(*n_iov)++;
+	}
+
+	for (i = 0; i < self->records->len; i++) {
+		Record *record = g_ptr_array_index (self->records, i);
+
+		iov[*n_iov].iov_base = record->data;
+		iov[*n_iov].iov_len = record->length + 1;
+		(*n_iov)++;
+	}
+
+	return iov;
+}
+
+static void
+set_spool_error (OsVersionReportQueue *self, gint errsv, GError **error)
+{
+	g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+	             "Error writing spool file ‘%s’: %s", self->spool_path,
+	             g_strerror (errsv));
+}
+
+/* Append the queued records to the spool file, and clear the queue once they
+ * are on disk. On failure, the spool file is truncated back to its original
+ * length, so it never ends with a partial record, and the queue is left
+ * untouched. */
+static gboolean
+queue_spool (OsVersionReportQueue *self, GError **error)
+{
+	struct iovec *iov;
+	gint fd, n_iov;
+	off_t original_length;
+	gsize written;
+	gboolean success;
+
+	fd = g_open (self->spool_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+
+	if (fd < 0) {
+		set_spool_error (self, errno, error);
+		return FALSE;
+	}
+
+	original_length = lseek (fd, 0, SEEK_END);
+
+	if (original_length < 0) {
+		set_spool_error (self, errno, error);
+		g_close (fd, NULL);
+		return FALSE;
+	}
+
+	iov = queue_build_iov (self, NULL, 0, &n_iov);
+	success = writev_all (fd, FALSE, iov, n_iov, &written, error);
+	g_free (iov);
+
+	if (success && fsync (fd) != 0) {
+		set_spool_error (self, errno, error);
+		success = FALSE;
+	}
+
+	if (!success && written > 0) {
+		/* Best effort: if this fails, the spool file ends with a
+		 * partial record, and the records are spooled again after
+		 * it. */
+		if (ftruncate (fd, original_length) != 0) {
+			g_warning ("Error truncating spool file ‘%s’: %s",
+			           self->spool_path, g_strerror (errno));
+		}
+	}
+
+	if (!g_close (fd, success ? error : NULL)) {
+		success = FALSE;
+	}
+
+	if (success) {
+		queue_clear (self);
+	}
+
+	return success;
+}
+
+/* After a send of the spool file and queue failed with only @written bytes
+ * sent, replace the spool file with everything which was not sent, and clear
+ * the queue. The record which was cut off is kept whole, so the new spool
+ * file starts at a record boundary. The spool file is replaced atomically, so
+ * on failure it and the queue are left as they were. */
+static gboolean
+queue_respool (OsVersionReportQueue *self,
+               const gchar *spool_contents,
+               gsize spool_length,
+               gsize written,
+               GError **error)
+{
+	GString *unsent;
+	gsize start = spool_length;
+	guint i = 0;
+	gboolean success;
+
+	if (written < spool_length) {
+		/* Back up to the start of the line which was cut off. */
+		for (start = written;
+		     start > 0 && spool_contents[start - 1] != '\n';
+		     start--);
+	} else {
+		gsize sent = written - spool_length;
+
+		for (i = 0; i < self->records->len; i++) {
+			Record *record = g_ptr_array_index (self->records, i);
+
+			if (sent <= record->length) {
+				break;
+			}
+
+			sent -= record->length + 1;
+		}
+	}
+
+	unsent = g_string_sized_new (spool_length - start);
+	g_string_append_len (unsent, spool_contents + start,
+	                     spool_length - start);
+
+	for (; i < self->records->len; i++) {
+		Record *record = g_ptr_array_index (self->records, i);
+
+		g_string_append_len (unsent, record->data, record->length + 1);
+	}
+
+	success = g_file_set_contents (self->spool_path, unsent->str,
+	                               unsent->len, error);
+	g_string_free (unsent, TRUE);
+
+	if (success) {
+		queue_clear (self);
+	}
+
+	return success;
+}
+
+/* Map the spool file, so it can be sent without reading it all into memory.
+ * *@spool is set to %NULL if there is no spool file. */
+static gboolean
+queue_map_spool (OsVersionReportQueue *self,
+                 GMappedFile **spool,
+                 GError **error)
+{
+	GError *local_error = NULL;
+
+	*spool = g_mapped_file_new (self->spool_path, FALSE, &local_error);
+
+	if (*spool == NULL &&
+	    g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+		g_error_free (local_error);
+		return TRUE;
+	} else if (*spool == NULL) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * os_version_report_queue_new:
+ * @spool_path: path of a file to append records to while offline
+ * @max_records: maximum number of records to hold in memory; must be positive
+ *
+ * Create a new report queue. Records added with os_version_report_queue_push()
+ * or os_version_report_queue_push_report() are held in memory until
+ * os_version_report_queue_flush() is called, so that many small records can be
+ * sent together.
+ *
+ * The queue starts offline; set a sink with os_version_report_queue_set_sink().
+ * Any file descriptor can be used as the sink, so a pipe or a local file is a
+ * suitable stand-in for a connection to the server in tests.
+ *
+ * Queues are not thread safe.
+ *
+ * Returns: (transfer full): a new #OsVersionReportQueue
+ *
+ * Since: UNRELEASED
+ */
+OsVersionReportQueue *
+os_version_report_queue_new (const gchar *spool_path, guint max_records)
+{
+	OsVersionReportQueue *self;
+
+	g_return_val_if_fail (spool_path != NULL, NULL);
+	g_return_val_if_fail (max_records > 0, NULL);
+
+	self = g_slice_new0 (OsVersionReportQueue);
+	self->spool_path = g_strdup (spool_path);
+	self->sink_fd = -1;
+	self->max_records = max_records;
+	self->records = g_ptr_array_new_with_free_func (g_free);
+	self->fingerprints = g_hash_table_new_full (g_int64_hash,
+	                                            g_int64_equal, NULL,
+	                                            g_free);
+
+	return self;
+}
+
+/**
+ * os_version_report_queue_free:
+ * @self: (transfer full): an #OsVersionReportQueue
+ *
+ * Free a report queue. Any records which have not been flushed are lost; call
+ * os_version_report_queue_flush() first to keep them.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_report_queue_free (OsVersionReportQueue *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_free (self->spool_path);
+	g_ptr_array_unref (self->records);
+	g_hash_table_unref (self->fingerprints);
+	g_slice_free (OsVersionReportQueue, self);
+}
+
+/**
+ * os_version_report_queue_set_sink:
+ * @self: an #OsVersionReportQueue
+ * @fd: file descriptor to send records to, such as a connected socket, or -1
+ *    if offline
+ *
+ * Set the sink which records are flushed to. The file descriptor is not
+ * owned by the queue, and must remain open until it is replaced.
+ *
+ * Records are written as a stream of newline-terminated lines, with many
+ * records per write, so socket sinks must be stream sockets; datagram sockets
+ * are rejected.
+ *
+ * If @fd is a socket, it is written with `MSG_NOSIGNAL` where supported, so a
+ * closed connection causes os_version_report_queue_flush() to fail rather
+ * than raising `SIGPIPE`. For any other file descriptor, such as a pipe, and
+ * on platforms without `MSG_NOSIGNAL`, the caller must ignore `SIGPIPE` if the
+ * reader might exit before the writer.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_report_queue_set_sink (OsVersionReportQueue *self, gint fd)
+{
+	gboolean sink_is_socket = FALSE;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (fd >= -1);
+
+	if (fd >= 0) {
+		struct stat buf;
+
+		sink_is_socket = (fstat (fd, &buf) == 0 &&
+		                  S_ISSOCK (buf.st_mode));
+	}
+
+	if (sink_is_socket) {
+		gint type = 0;
+		socklen_t type_length = sizeof (type);
+
+		if (getsockopt (fd, SOL_SOCKET, SO_TYPE, &type,
+		                &type_length) == 0 &&
+		    type != SOCK_STREAM) {
+			g_critical ("%s: Sink must be a stream socket.",
+			            G_STRFUNC);
+			return;
+		}
+	}
+
+	self->sink_fd = fd;
+	self->sink_is_socket = sink_is_socket;
+}
+
+/**
+ * os_version_report_queue_push:
+ * @self: an #OsVersionReportQueue
+ * @record: (array length=length): telemetry record to queue; this must not
+ *    contain newlines
+ * @length: length of @record in bytes, or -1 if it is nul-terminated
+ *
+ * Add a record to the queue. If the queue is full, a duplicate record is
+ * dropped to make space: @record itself if an identical record is already
+ * queued, otherwise the oldest record which has a duplicate. If there are no
+ * duplicates, the oldest record is dropped.
+ *
+ * Returns: %TRUE if @record was queued, %FALSE if it was dropped
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_report_queue_push (OsVersionReportQueue *self,
+                              const gchar *record,
+                              gssize length)
+{
+	Record *item;
+	guint64 fingerprint;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (record != NULL, FALSE);
+
+	if (length < 0) {
+		length = strlen (record);
+	}
+
+	g_return_val_if_fail (memchr (record, '\n', length) == NULL, FALSE);
+
+	fingerprint = os_version_fingerprint (record, length);
+
+	if (self->records->len >= self->max_records) {
+		guint i;
+
+		if (fingerprint_get_count (self, fingerprint) > 0) {
+			self->n_dropped++;
+			return FALSE;
+		}
+
+		for (i = 0; i < self->records->len; i++) {
+			Record *queued = g_ptr_array_index (self->records, i);
+
+			if (fingerprint_get_count (self, queued->fingerprint) > 1) {
+				break;
+			}
+		}
+
+		queue_remove_index (self, (i < self->records->len) ? i : 0);
+		self->n_dropped++;
+	}
+
+	item = g_malloc (sizeof (Record) + length + 1);
+	item->fingerprint = fingerprint;
+	item->length = length;
+	memcpy (item->data, record, length);
+	item->data[length] = '\n';
+
+	g_ptr_array_add (self->records, item);
+	fingerprint_ref (self, fingerprint);
+
+	return TRUE;
+}
+
+/**
+ * os_version_report_queue_push_report:
+ * @self: an #OsVersionReportQueue
+ *
+ * Add the current OS report, as returned by get_os_version(), to the queue.
+ * See os_version_report_queue_push().
+ *
+ * Returns: %TRUE if the report was queued, %FALSE if it was dropped
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_report_queue_push_report (OsVersionReportQueue *self)
+{
+	gchar *report;
+	gboolean queued;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+
+	report = get_os_version ();
+	queued = os_version_report_queue_push (self, report, -1);
+	g_free (report);
+
+	return queued;
+}
+
+/**
+ * os_version_report_queue_flush:
+ * @self: an #OsVersionReportQueue
+ * @error: return location for a #GError, or %NULL
+ *
+ * Send all queued records to the sink, preceded by any records spooled while
+ * offline. If there is no sink, the records are appended to the spool file
+ * instead. If sending fails, the spool file is replaced with everything which
+ * was not sent, and the send error is returned.
+ *
+ * The queue is empty afterwards unless the spool file could not be written,
+ * in which case the records are kept queued and the spool file is left as it
+ * was. Some records may then be sent again by the next flush.
+ *
+ * Returns: %TRUE if all records were sent to the sink, or spooled while
+ *    offline; %FALSE on error
+ *
+ * Since: UNRELEASED
+ */
+gboolean
+os_version_report_queue_flush (OsVersionReportQueue *self, GError **error)
+{
+	GMappedFile *spool;
+	const gchar *spool_contents = NULL;
+	gsize spool_length = 0;
+	struct iovec *iov;
+	gint n_iov;
+	gsize written = 0;
+	gboolean success;
+	GError *send_error = NULL, *local_error = NULL;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (self->sink_fd < 0) {
+		return (self->records->len == 0 || queue_spool (self, error));
+	}
+
+	if (!queue_map_spool (self, &spool, error)) {
+		/* Spool the records after the unreadable ones, so they are
+		 * still sent in order later. */
+		if (self->records->len > 0 &&
+		    !queue_spool (self, &local_error)) {
+			g_warning ("%s", local_error->message);
+			g_error_free (local_error);
+		}
+
+		return FALSE;
+	}
+
+	if (spool != NULL) {
+		spool_contents = g_mapped_file_get_contents (spool);
+		spool_length = g_mapped_file_get_length (spool);
+	}
+
+	/* Send the spool and the queued records in one batch. */
+	iov = queue_build_iov (self, spool_contents, spool_length, &n_iov);
+	success = writev_all (self->sink_fd, self->sink_is_socket, iov, n_iov,
+	                      &written, &send_error);
+	g_free (iov);
+
+	if (success) {
+		queue_clear (self);
+
+		if (spool != NULL && g_unlink (self->spool_path) != 0 &&
+		    errno != ENOENT) {
+			gint errsv = errno;
+
+			g_set_error (error, G_FILE_ERROR,
+			             g_file_error_from_errno (errsv),
+			             "Error removing sent spool file ‘%s’: %s",
+			             self->spool_path, g_strerror (errsv));
+			success = FALSE;
+		}
+	} else if (!queue_respool (self, spool_contents, spool_length,
+	                           written, &local_error)) {
+		g_propagate_prefixed_error (error, local_error, "%s; ",
+		                            send_error->message);
+		g_error_free (send_error);
+	} else {
+		g_propagate_error (error, send_error);
+	}
+
+	/* Replacing the spool file leaves this mapping of the old one
+	 * intact, so it must only be released now. */
+	g_clear_pointer (&spool, g_mapped_file_unref);
+
+	return success;
+}
+
+/**
+ * os_version_report_queue_get_n_queued:
+ * @self: an #OsVersionReportQueue
+ *
+ * Get the number of records queued in memory.
+ *
+ * Returns: number of queued records
+ *
+ * Since: UNRELEASED
+ */
+guint
+os_version_report_queue_get_n_queued (OsVersionReportQueue *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->records->len;
+}
+
+/**
+ * os_version_report_queue_get_n_dropped:
+ * @self: an #OsVersionReportQueue
+ *
+ * Get the number of records dropped because the queue was full.
+ *
+ * Returns: number of dropped records
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_report_queue_get_n_dropped (OsVersionReportQueue *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->n_dropped;
+}
+
+#endif /* G_OS_UNIX */
@@ -0,0 +1,70 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_QUEUE_H_
+#define _OS_VERSION_QUEUE_H_
+
+
+/**
+ * OsVersionReportQueue:
+ *
+ * Batches reports and other telemetry records for sending, spooling them to
+ * disk while offline. All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionReportQueue OsVersionReportQueue;
+
+#ifdef G_OS_UNIX
+OsVersionReportQueue *
+os_version_report_queue_new (const gchar *spool_path, guint max_records);
+
+void
+os_version_report_queue_free (OsVersionReportQueue *self);
+
+void
+os_version_report_queue_set_sink (OsVersionReportQueue *self, gint fd);
+
+gboolean
+os_version_report_queue_push (OsVersionReportQueue *self,
+                              const gchar *record,
+                              gssize length);
+
+gboolean
+os_version_report_queue_push_report (OsVersionReportQueue *self);
+
+gboolean
+os_version_report_queue_flush (OsVersionReportQueue *self, GError **error);
+
+guint
+os_version_report_queue_get_n_queued (OsVersionReportQueue *self);
+
+guint64
+os_version_report_queue_get_n_dropped (OsVersionReportQueue *self);
+#endif /* G_OS_UNIX */
+
+
+#endif /* _OS_VERSION_QUEUE_H_ */
@@ -0,0 +1,511 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion-rollup.h"
+
+
+/*
+ * Each bucket holds its counts in an array sorted by key, which is compact
+ * and cheap to search. New counts are appended to an unsorted pending array
+ * and merged into the sorted one in a single pass once enough have
+ * accumulated, or when the bucket is read.
+ */
+
+/* Maximum number of pending entries per bucket before they are merged. */
+#define PENDING_MAX 4096
+
+typedef struct {
+	gint64 start;
+	gint64 width;
+	GArray/*<OsVersionRollupEntry>*/ *entries;  /* sorted by key, unique */
+	GArray/*<OsVersionRollupEntry>*/ *pending;  /* unsorted */
+} Bucket;
+
+struct _OsVersionRollup {
+	gint64 bucket_width;
+	GArray/*<Bucket>*/ *buckets;  /* sorted by start, non-overlapping */
+};
+
+static void
+bucket_clear (Bucket *bucket)
+{
+	g_array_unref (bucket->entries);
+	g_array_unref (bucket->pending);
+}
+
+static gint
+compare_entries (gconstpointer a, gconstpointer b)
+{
+	const OsVersionRollupEntry *entry_a = a;
+	const OsVersionRollupEntry *entry_b = b;
+
+	return (entry_a->key < entry_b->key) ? -1 : (entry_a->key > entry_b->key);
+}
+
+/* Sort @entries by key and sum the counts of duplicate keys, in place. */
+static void
+entries_sort_unique (GArray/*<OsVersionRollupEntry>*/ *entries)
+{
+	OsVersionRollupEntry *data;
+	guint i, n;
+
+	if (entries->len == 0) {
+		return;
+	}
+
+	g_array_sort (entries, compare_entries);
+	data = (OsVersionRollupEntry *) entries->data;
+
+	for (i = 1, n = 0; i < entries->len; i++) {
+		if (data[i].key == data[n].key) {
+			data[n].count += data[i].count;
+		} else {
+			data[++n] = data[i];
+		}
+	}
+
+	g_array_set_size (entries, n + 1);
+}
+
+/* Merge two arrays which are sorted by key with unique keys. */
+static GArray/*<OsVersionRollupEntry>*/ *
+entries_merge (GArray/*<OsVersionRollupEntry>*/ *a,
+               GArray/*<OsVersionRollupEntry>*/ *b)
+{
+	GArray/*<OsVersionRollupEntry>*/ *merged;
+	const OsVersionRollupEntry *data_a, *data_b;
+	guint i = 0, j = 0;
+
+	merged = g_array_sized_new (FALSE, FALSE, sizeof (OsVersionRollupEntry),
+	                            a->len + b->len);
+	data_a = (const OsVersionRollupEntry *) a->data;
+	data_b = (const OsVersionRollupEntry *) b->data;
+
+	while (i < a->len || j < b->len) {
+		OsVersionRollupEntry entry;
+
+		if (j == b->len || (i < a->len && data_a[i].key < data_b[j].key)) {
+			entry = data_a[i++];
+		} else if (i == a->len || data_b[j].key < data_a[i].key) {
+			entry = data_b[j++];
+		} else {
+			entry.key = data_a[i].key;
+			entry.count = data_a[i++].count + data_b[j++].count;
+		}
+
+		g_array_append_val (merged, entry);
+	}
+
+	return merged;
+}
+
+static void
+bucket_flush (Bucket *bucket)
+{
+	GArray/*<OsVersionRollupEntry>*/ *merged;
+
+	if (bucket->pending->len == 0) {
+		return;
+	}
+
+	entries_sort_unique (bucket->pending);
+	merged = entries_merge (bucket->entries, bucket->pending);
+
+	g_array_unref (bucket->entries);
+	bucket->entries = merged;
+	g_array_set_size (bucket->pending, 0);
+}
+
+/* Round @timestamp down to a multiple of @width, including for negative
+ * timestamps. */
+static gint64
+floor_to_width (gint64 timestamp, gint64 width)
+{
+	gint64 remainder = timestamp % width;
+
+	return timestamp - remainder - ((remainder < 0) ? width : 0);
+}
+
+/* Find the index of the first bucket which ends after @timestamp. */
+static guint
+find_bucket (OsVersionRollup *self, gint64 timestamp)
+{
+	guint low = 0, high = self->buckets->len;
+
+	while (low < high) {
+		guint mid = low + (high - low) / 2;
+		const Bucket *bucket = &g_array_index (self->buckets, Bucket, mid);
+
+		if (bucket->start + bucket->width <= timestamp) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+/**
+ * os_version_rollup_new:
+ * @bucket_width: width of each bucket, in seconds; for example, 3600 for hourly
+ *    buckets
+ *
+ * Create a new, empty rollup. Reports are counted in buckets of @bucket_width
+ * seconds, aligned to the Unix epoch, and keyed by a 64-bit value identifying
+ * the set of fields being counted, such as os_version_fields_fingerprint() of
+ * a field tuple.
+ *
+ * Rollups are not thread safe.
+ *
+ * Returns: (transfer full): a new #OsVersionRollup
+ *
+ * Since: UNRELEASED
+ */
+OsVersionRollup *
+os_version_rollup_new (gint64 bucket_width)
+{
+	OsVersionRollup *self;
+
+	g_return_val_if_fail (bucket_width > 0, NULL);
+
+	self = g_slice_new0 (OsVersionRollup);
+	self->bucket_width = bucket_width;
+	self->buckets = g_array_new (FALSE, FALSE, sizeof (Bucket));
+	g_array_set_clear_func (self->buckets, (GDestroyNotify) bucket_clear);
+
+	return self;
+}
+
+/**
+ * os_version_rollup_free:
+ * @self: (transfer full): an #OsVersionRollup
+ *
+ * Free a rollup.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_rollup_free (OsVersionRollup *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_array_unref (self->buckets);
+	g_slice_free (OsVersionRollup, self);
+}
+
+/**
+ * os_version_rollup_add:
+ * @self: an #OsVersionRollup
+ * @timestamp: time of the reports, in seconds since the Unix epoch
+ * @key: key identifying the reports
+ * @count: number of reports to add
+ *
+ * Add @count reports with @key at @timestamp. Timestamps do not need to be in
+ * order, but adding to the most recent bucket is fastest.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_rollup_add (OsVersionRollup *self,
+                       gint64 timestamp,
+                       guint64 key,
+                       guint64 count)
+{
+	OsVersionRollupEntry entry;
+	Bucket *bucket = NULL;
+	guint index;
+
+	g_return_if_fail (self != NULL);
+
+	/* Fast path for in-order streams. */
+	if (self->buckets->len > 0) {
+		bucket = &g_array_index (self->buckets, Bucket,
+		                         self->buckets->len - 1);
+
+		if (timestamp < bucket->start ||
+		    timestamp >= bucket->start + bucket->width) {
+			bucket = NULL;
+		}
+	}
+
+	if (bucket == NULL) {
+		index = find_bucket (self, timestamp);
+
+		if (index < self->buckets->len &&
+		    g_array_index (self->buckets, Bucket, index).start <= timestamp) {
+			bucket = &g_array_index (self->buckets, Bucket, index);
+		} else {
+			Bucket new_bucket;
+
+			new_bucket.start = floor_to_width (timestamp,
+			                                   self->bucket_width);
+			new_bucket.width = self->bucket_width;
+			new_bucket.entries = g_array_new (FALSE, FALSE,
+			                                  sizeof (OsVersionRollupEntry));
+			new_bucket.pending = g_array_new (FALSE, FALSE,
+			                                  sizeof (OsVersionRollupEntry));
+
+			g_array_insert_vals (self->buckets, index, &new_bucket, 1);
+			bucket = &g_array_index (self->buckets, Bucket, index);
+		}
+	}
+
+	entry.key = key;
+	entry.count = count;
+	g_array_append_val (bucket->pending, entry);
+
+	if (bucket->pending->len >= MAX (PENDING_MAX, bucket->entries->len)) {
+		bucket_flush (bucket);
+	}
+}
+
+/**
+ * os_version_rollup_flush:
+ * @self: an #OsVersionRollup
+ *
+ * Merge all newly added counts into the buckets’ sorted arrays. This is done
+ * automatically as needed, but can be called after a batch of additions to
+ * release the memory used to buffer them.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_rollup_flush (OsVersionRollup *self)
+{
+	guint i;
+
+	g_return_if_fail (self != NULL);
+
+	for (i = 0; i < self->buckets->len; i++) {
+		bucket_flush (&g_array_index (self->buckets, Bucket, i));
+	}
+}
+
+/**
+ * os_version_rollup_compact:
+ * @self: an #OsVersionRollup
+ * @before: timestamp, in seconds since the Unix epoch
+ * @bucket_width: new bucket width, in seconds; a multiple of the rollup’s
+ *    bucket width
+ *
+ * Merge buckets which end at or before @before into coarser buckets of
+ * @bucket_width seconds, to reduce the space used by old data. For example,
+ * hourly buckets older than a week could be compacted into daily buckets.
+ *
+ * @bucket_width must be a multiple of the widths of all the buckets being
+ * compacted.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_rollup_compact (OsVersionRollup *self,
+                           gint64 before,
+                           gint64 bucket_width)
+{
+	GArray/*<Bucket>*/ *compacted;
+	guint i;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (bucket_width > 0 &&
+	                  bucket_width % self->bucket_width == 0);
+
+	for (i = 0; i < self->buckets->len; i++) {
+		const Bucket *bucket = &g_array_index (self->buckets, Bucket, i);
+		gint64 new_start = floor_to_width (bucket->start, bucket_width);
+
+		if (new_start + bucket_width <= before &&
+		    bucket_width % bucket->width != 0) {
+			g_critical ("%s: Bucket width %" G_GINT64_FORMAT " is "
+			            "not a multiple of existing bucket width "
+			            "%" G_GINT64_FORMAT ".", G_STRFUNC,
+			            bucket_width, bucket->width);
+			return;
+		}
+	}
+
+	compacted = g_array_sized_new (FALSE, FALSE, sizeof (Bucket),
+	                               self->buckets->len);
+	g_array_set_clear_func (compacted, (GDestroyNotify) bucket_clear);
+
+	for (i = 0; i < self->buckets->len; i++) {
+		Bucket *bucket = &g_array_index (self->buckets, Bucket, i);
+		Bucket *last = NULL;
+		gint64 new_start = floor_to_width (bucket->start, bucket_width);
+
+		bucket_flush (bucket);
+
+		if (compacted->len > 0) {
+			last = &g_array_index (compacted, Bucket, compacted->len - 1);
+		}
+
+		if (new_start + bucket_width > before) {
+			/* Too recent to compact. */
+			g_array_append_val (compacted, *bucket);
+		} else if (last != NULL && last->start == new_start) {
+			/* Merge into the previous compacted bucket. */
+			GArray *merged = entries_merge (last->entries,
+			                                bucket->entries);
+
+			g_array_unref (last->entries);
+			last->entries = merged;
+			bucket_clear (bucket);
+		} else {
+			bucket->start = new_start;
+			bucket->width = bucket_width;
+			g_array_append_val (compacted, *bucket);
+		}
+	}
+
+	/* The buckets have been moved to @compacted, so must not be cleared
+	 * again. */
+	g_array_set_clear_func (self->buckets, NULL);
+	g_array_unref (self->buckets);
+	self->buckets = compacted;
+}
+
+/**
+ * os_version_rollup_get_n_buckets:
+ * @self: an #OsVersionRollup
+ *
+ * Get the number of non-empty buckets in the rollup.
+ *
+ * Returns: number of buckets
+ *
+ * Since: UNRELEASED
+ */
+guint
+os_version_rollup_get_n_buckets (OsVersionRollup *self)
+{
+	g_return_val_if_fail (self != NULL, 0);
+
+	return self->buckets->len;
+}
+
+/**
+ * os_version_rollup_get_bucket:
+ * @self: an #OsVersionRollup
+ * @index: index of the bucket, in order of time
+ * @start: (out) (optional): return location for the start of the bucket, in
+ *    seconds since the Unix epoch
+ * @width: (out) (optional): return location for the width of the bucket, in
+ *    seconds
+ * @n_entries: (out): return location for the number of entries
+ *
+ * Get the counts in a bucket, sorted by key. The returned array is owned by
+ * the rollup and is valid until it is next modified.
+ *
+ * Returns: (array length=n_entries) (transfer none): counts in the bucket
+ *
+ * Since: UNRELEASED
+ */
+const OsVersionRollupEntry *
+os_version_rollup_get_bucket (OsVersionRollup *self,
+                              guint index,
+                              gint64 *start,
+                              gint64 *width,
+                              gsize *n_entries)
+{
+	Bucket *bucket;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (index < self->buckets->len, NULL);
+	g_return_val_if_fail (n_entries != NULL, NULL);
+
+	bucket = &g_array_index (self->buckets, Bucket, index);
+	bucket_flush (bucket);
+
+	if (start != NULL) {
+		*start = bucket->start;
+	}
+	if (width != NULL) {
+		*width = bucket->width;
+	}
+
+	*n_entries = bucket->entries->len;
+
+	return (const OsVersionRollupEntry *) bucket->entries->data;
+}
+
+/**
+ * os_version_rollup_count:
+ * @self: an #OsVersionRollup
+ * @start: start of the time range, inclusive, in seconds since the Unix epoch
+ * @end: end of the time range, exclusive, in seconds since the Unix epoch
+ * @key: key to count
+ *
+ * Count the reports with @key in the buckets which start within
+ * [@start, @end).
+ *
+ * Returns: number of reports
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_rollup_count (OsVersionRollup *self,
+                         gint64 start,
+                         gint64 end,
+                         guint64 key)
+{
+	guint64 count = 0;
+	guint i;
+
+	g_return_val_if_fail (self != NULL, 0);
+
+	for (i = find_bucket (self, start); i < self->buckets->len; i++) {
+		Bucket *bucket = &g_array_index (self->buckets, Bucket, i);
+		const OsVersionRollupEntry *entries;
+		guint low, high;
+
+		if (bucket->start >= end) {
+			break;
+		} else if (bucket->start < start) {
+			continue;
+		}
+
+		bucket_flush (bucket);
+		entries = (const OsVersionRollupEntry *) bucket->entries->data;
+
+		for (low = 0, high = bucket->entries->len; low < high;) {
+			guint mid = low + (high - low) / 2;
+
+			if (entries[mid].key < key) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+
+		if (low < bucket->entries->len && entries[low].key == key) {
+			count += entries[low].count;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,91 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_ROLLUP_H_
+#define _OS_VERSION_ROLLUP_H_
+
+
+/**
+ * OsVersionRollup:
+ *
+ * Counts of reports per key, bucketed by time. All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionRollup OsVersionRollup;
+
+/**
+ * OsVersionRollupEntry:
+ * @key: key identifying a set of reports, such as a field tuple fingerprint
+ * @count: number of reports with @key in the bucket
+ *
+ * A single count from an #OsVersionRollup bucket.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+	guint64 key;
+	guint64 count;
+} OsVersionRollupEntry;
+
+OsVersionRollup *
+os_version_rollup_new (gint64 bucket_width);
+
+void
+os_version_rollup_free (OsVersionRollup *self);
+
+void
+os_version_rollup_add (OsVersionRollup *self,
+                       gint64 timestamp,
+                       guint64 key,
+                       guint64 count);
+
+void
+os_version_rollup_flush (OsVersionRollup *self);
+
+void
+os_version_rollup_compact (OsVersionRollup *self,
+                           gint64 before,
+                           gint64 bucket_width);
+
+guint
+os_version_rollup_get_n_buckets (OsVersionRollup *self);
+
+const OsVersionRollupEntry *
+os_version_rollup_get_bucket (OsVersionRollup *self,
+                              guint index,
+                              gint64 *start,
+                              gint64 *width,
+                              gsize *n_entries);
+
+guint64
+os_version_rollup_count (OsVersionRollup *self,
+                         gint64 start,
+                         gint64 end,
+                         guint64 key);
+
+
+#endif /* _OS_VERSION_ROLLUP_H_ */
@@ -0,0 +1,919 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-sketch.h"
+
+
+/* Serialisation helpers. All integers are stored little-endian. */
+static void
+append_uint32 (GByteArray *buf, guint32 value)
+{
+	value = GUINT32_TO_LE (value);
+	g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_uint64 (GByteArray *buf, guint64 value)
+{
+	value = GUINT64_TO_LE (value);
+	g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+}
+
+typedef struct {
+	const guint8 *data;
+	gsize length;
+	gsize offset;
+} Reader;
+
+static gboolean
+read_bytes (Reader *reader, gsize length, const guint8 **out)
+{
+	if (reader->length - reader->offset < length) {
+		return FALSE;
+	}
+
+	*out = reader->data + reader->offset;
+	reader->offset += length;
+
+	return TRUE;
+}
+
+static gboolean
+read_uint32 (Reader *reader, guint32 *out)
+{
+	const guint8 *data;
+
+	if (!read_bytes (reader, sizeof (*out), &data)) {
+		return FALSE;
+	}
+
+	memcpy (out, data, sizeof (*out));
+	*out = GUINT32_FROM_LE (*out);
+
+	return TRUE;
+}
+
+static gboolean
+read_uint64 (Reader *reader, guint64 *out)
+{
+	const guint8 *data;
+
+	if (!read_bytes (reader, sizeof (*out), &data)) {
+		return FALSE;
+	}
+
+	memcpy (out, data, sizeof (*out));
+	*out = GUINT64_FROM_LE (*out);
+
+	return TRUE;
+}
+
+static guint
+report_hash (gconstpointer key)
+{
+	return (guint) os_version_fingerprint (key, -1);
+}
+
+
+/*
+ * Top-K
+ *
+ * This is the Space-Saving algorithm (Metwally, Agrawal and El Abbadi, 2005):
+ * at most @capacity counters are kept, and when an unseen report arrives and
+ * all counters are in use, the smallest counter is reassigned to it. The
+ * counters are kept in a binary min-heap so finding the smallest is O(1) and
+ * updating a counter is O(log capacity).
+ */
+
+#define TOP_K_MAGIC 0x4b54534fu  /* ‘OSTK’ */
+#define TOP_K_FORMAT_VERSION 1
+/* Serialised size of an entry with an empty report: count, error, length. */
+#define TOP_K_ENTRY_MIN_SIZE (8 + 8 + 4)
+
+typedef struct {
+	gchar *report;  /* owned */
+	guint64 count;
+	guint64 error;
+	guint position;  /* index in the heap */
+} Counter;
+
+struct _OsVersionTopK {
+	guint capacity;
+	GHashTable/*<unowned string, owned Counter>*/ *index;
+	Counter **heap;  /* array of length @capacity; the first @n_counters
+	                  * are a min-heap on count */
+	guint n_counters;
+};
+
+static void
+counter_free (Counter *counter)
+{
+	g_free (counter->report);
+	g_slice_free (Counter, counter);
+}
+
+static void
+heap_swap (OsVersionTopK *self, guint i, guint j)
+{
+	Counter *tmp = self->heap[i];
+
+	self->heap[i] = self->heap[j];
+	self->heap[j] = tmp;
+	self->heap[i]->position = i;
+	self->heap[j]->position = j;
+}
+
+static void
+heap_sift_up (OsVersionTopK *self, guint i)
+{
+	while (i > 0) {
+		guint parent = (i - 1) / 2;
+
+		if (self->heap[parent]->count <= self->heap[i]->count) {
+			break;
+		}
+
+		heap_swap (self, i, parent);
+		i = parent;
+	}
+}
+
+static void
+heap_sift_down (OsVersionTopK *self, guint i)
+{
+	while (TRUE) {
+		guint smallest = i;
+		guint left = 2 * i + 1;
+		guint right = 2 * i + 2;
+
+		if (left < self->n_counters &&
+		    self->heap[left]->count < self->heap[smallest]->count) {
+			smallest = left;
+		}
+		if (right < self->n_counters &&
+		    self->heap[right]->count < self->heap[smallest]->count) {
+			smallest = right;
+		}
+
+		if (smallest == i) {
+			break;
+		}
+
+		heap_swap (self, i, smallest);
+		i = smallest;
+	}
+}
+
+/* Add a counter with the given values, assuming there is space for it and
+ * @report is not already present. Takes ownership of @report. */
+static void
+top_k_insert (OsVersionTopK *self, gchar *report, guint64 count,
+              guint64 error)
+{
+	Counter *counter;
+
+	counter = g_slice_new (Counter);
+	counter->report = report;
+	counter->count = count;
+	counter->error = error;
+	counter->position = self->n_counters;
+
+	self->heap[self->n_counters++] = counter;
+	g_hash_table_insert (self->index, counter->report, counter);
+	heap_sift_up (self, counter->position);
+}
+
+/* Count of the smallest counter if the summary is full, otherwise 0. This is
+ * the most that any report not in the summary can have occurred. */
+static guint64
+top_k_get_threshold (const OsVersionTopK *self)
+{
+	if (self->n_counters < self->capacity) {
+		return 0;
+	}
+
+	return self->heap[0]->count;
+}
+
+/**
+ * os_version_top_k_new:
+ * @capacity: maximum number of distinct reports to track; must be positive and
+ *    at most %OS_VERSION_TOP_K_MAX_CAPACITY
+ *
+ * Create a new, empty top-K summary. The summary uses memory proportional to
+ * @capacity, regardless of how many reports are added to it. Any report which
+ * makes up more than 1/@capacity of the stream is guaranteed to be present in
+ * the summary.
+ *
+ * Summaries are not thread safe. To aggregate from several threads or
+ * processes, keep one summary per thread and combine them using
+ * os_version_top_k_merge(). Similarly, to aggregate over a sliding window, keep
+ * one summary per sub-window and merge the ones covering the window.
+ *
+ * Returns: (transfer full): a new #OsVersionTopK
+ *
+ * Since: UNRELEASED
+ */
+OsVersionTopK *
+os_version_top_k_new (guint capacity)
+{
+	OsVersionTopK *self;
+
+	g_return_val_if_fail (capacity > 0 &&
+	                      capacity <= OS_VERSION_TOP_K_MAX_CAPACITY, NULL);
+
+	self = g_slice_new0 (OsVersionTopK);
+	self->capacity = capacity;
+	self->index = g_hash_table_new_full (report_hash, g_str_equal, NULL,
+	                                     (GDestroyNotify) counter_free);
+	self->heap = g_new0 (Counter *, capacity);
+	self->n_counters = 0;
+
+	return self;
+}
+
+/**
+ * os_version_top_k_free:
+ * @self: (transfer full): an #OsVersionTopK
+ *
+ * Free a top-K summary.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_top_k_free (OsVersionTopK *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_hash_table_unref (self->index);
+	g_free (self->heap);
+	g_slice_free (OsVersionTopK, self);
+}
+
+/**
+ * os_version_top_k_clear:
+ * @self: an #OsVersionTopK
+ *
+ * Remove all reports from the summary, so it can be reused for the next
+ * window of a stream.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_top_k_clear (OsVersionTopK *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_hash_table_remove_all (self->index);
+	memset (self->heap, 0, sizeof (*self->heap) * self->capacity);
+	self->n_counters = 0;
+}
+
+/**
+ * os_version_top_k_add:
+ * @self: an #OsVersionTopK
+ * @report: a report string, as returned by get_os_version()
+ * @count: number of occurrences of @report to add
+ *
+ * Add @count occurrences of @report to the summary.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_top_k_add (OsVersionTopK *self, const gchar *report,
+                      guint64 count)
+{
+	Counter *counter;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (report != NULL);
+
+	if (count == 0) {
+		return;
+	}
+
+	counter = g_hash_table_lookup (self->index, report);
+
+	if (counter != NULL) {
+		counter->count += count;
+		heap_sift_down (self, counter->position);
+	} else if (self->n_counters < self->capacity) {
+		top_k_insert (self, g_strdup (report), count, 0);
+	} else {
+		/* Evict the smallest counter and reassign it to @report. Its
+		 * old count becomes the error bound of the new report. */
+		counter = self->heap[0];
+		g_hash_table_steal (self->index, counter->report);
+
+		g_free (counter->report);
+		counter->report = g_strdup (report);
+		counter->error = counter->count;
+		counter->count += count;
+
+		g_hash_table_insert (self->index, counter->report, counter);
+		heap_sift_down (self, 0);
+	}
+}
+
+static gint
+counter_compare_descending (gconstpointer a, gconstpointer b)
+{
+	const Counter *counter_a = *((const Counter **) a);
+	const Counter *counter_b = *((const Counter **) b);
+
+	if (counter_a->count != counter_b->count) {
+		return (counter_a->count > counter_b->count) ? -1 : 1;
+	}
+
+	return strcmp (counter_a->report, counter_b->report);
+}
+
+/**
+ * os_version_top_k_merge:
+ * @self: an #OsVersionTopK
+ * @other: another #OsVersionTopK
+ *
+ * Merge the counts from @other into @self, so that @self summarises the
+ * concatenation of both streams. @other is not modified. The two summaries do
+ * not need to have the same capacity; the result has the capacity of @self.
+ *
+ * This uses the merge procedure from Agarwal et al., ‘Mergeable Summaries’,
+ * 2012, so the error guarantees of the summary are preserved.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_top_k_merge (OsVersionTopK *self, const OsVersionTopK *other)
+{
+	GPtrArray/*<owned Counter>*/ *merged;
+	guint64 self_threshold, other_threshold;
+	guint i;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (other != NULL);
+	g_return_if_fail (self != other);
+
+	/* A report missing from one summary may have occurred up to that
+	 * summary’s threshold number of times, so add that to its count and
+	 * error bound. */
+	self_threshold = top_k_get_threshold (self);
+	other_threshold = top_k_get_threshold (other);
+
+	merged = g_ptr_array_new_full (self->n_counters + other->n_counters,
+	                               (GDestroyNotify) counter_free);
+
+	for (i = 0; i < self->n_counters; i++) {
+		Counter *counter = self->heap[i];
+		const Counter *other_counter;
+
+		other_counter = g_hash_table_lookup (other->index,
+		                                     counter->report);
+
+		if (other_counter != NULL) {
+			counter->count += other_counter->count;
+			counter->error += other_counter->error;
+		} else {
+			counter->count += other_threshold;
+			counter->error += other_threshold;
+		}
+
+		g_ptr_array_add (merged, counter);
+	}
+
+	for (i = 0; i < other->n_counters; i++) {
+		const Counter *other_counter = other->heap[i];
+		Counter *counter;
+
+		if (g_hash_table_contains (self->index, other_counter->report)) {
+			continue;
+		}
+
+		counter = g_slice_new (Counter);
+		counter->report = g_strdup (other_counter->report);
+		counter->count = other_counter->count + self_threshold;
+		counter->error = other_counter->error + self_threshold;
+
+		g_ptr_array_add (merged, counter);
+	}
+
+	/* The counters from @self are now owned by @merged. */
+	g_hash_table_steal_all (self->index);
+	self->n_counters = 0;
+
+	/* Keep the largest @capacity counters. */
+	g_ptr_array_sort (merged, counter_compare_descending);
+
+	for (i = 0; i < merged->len && i < self->capacity; i++) {
+		Counter *counter = g_ptr_array_index (merged, i);
+
+		top_k_insert (self, counter->report, counter->count,
+		              counter->error);
+		counter->report = NULL;
+	}
+
+	g_ptr_array_unref (merged);
+}
+
+/**
+ * os_version_top_k_get_entries:
+ * @self: an #OsVersionTopK
+ *
+ * Get the reports currently in the summary, in descending order of count.
+ *
+ * The report strings in the returned entries are owned by @self, and are only
+ * valid until @self is next modified.
+ *
+ * Returns: (transfer container) (element-type OsVersionTopKEntry): entries in
+ *    the summary; free with g_array_unref()
+ *
+ * Since: UNRELEASED
+ */
+GArray *
+os_version_top_k_get_entries (const OsVersionTopK *self)
+{
+	GArray/*<OsVersionTopKEntry>*/ *entries;
+	Counter **sorted;
+	guint i;
+
+	g_return_val_if_fail (self != NULL, NULL);
+
+	sorted = g_new (Counter *, self->n_counters);
+	memcpy (sorted, self->heap, sizeof (*sorted) * self->n_counters);
+	qsort (sorted, self->n_counters, sizeof (*sorted),
+	       counter_compare_descending);
+
+	entries = g_array_sized_new (FALSE, FALSE, sizeof (OsVersionTopKEntry),
+	                             self->n_counters);
+
+	for (i = 0; i < self->n_counters; i++) {
+		OsVersionTopKEntry entry;
+
+		entry.report = sorted[i]->report;
+		entry.count = sorted[i]->count;
+		entry.error = sorted[i]->error;
+
+		g_array_append_val (entries, entry);
+	}
+
+	g_free (sorted);
+
+	return entries;
+}
+
+/**
+ * os_version_top_k_serialize:
+ * @self: an #OsVersionTopK
+ *
+ * Serialise the summary to a portable byte string, which can be passed to
+ * another process and loaded with os_version_top_k_deserialize().
+ *
+ * Returns: (transfer full): serialised summary
+ *
+ * Since: UNRELEASED
+ */
+GBytes *
+os_version_top_k_serialize (const OsVersionTopK *self)
+{
+	GByteArray *buf;
+	guint i;
+
+	g_return_val_if_fail (self != NULL, NULL);
+
+	buf = g_byte_array_new ();
+
+	append_uint32 (buf, TOP_K_MAGIC);
+	append_uint32 (buf, TOP_K_FORMAT_VERSION);
+	append_uint32 (buf, self->capacity);
+	append_uint32 (buf, self->n_counters);
+
+	for (i = 0; i < self->n_counters; i++) {
+		const Counter *counter = self->heap[i];
+		gsize length = strlen (counter->report);
+
+		append_uint64 (buf, counter->count);
+		append_uint64 (buf, counter->error);
+		append_uint32 (buf, length);
+		g_byte_array_append (buf, (const guint8 *) counter->report,
+		                     length);
+	}
+
+	return g_byte_array_free_to_bytes (buf);
+}
+
+/**
+ * os_version_top_k_deserialize:
+ * @bytes: serialised summary, from os_version_top_k_serialize()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Load a summary previously serialised with os_version_top_k_serialize(). If
+ * the data is invalid, or its capacity exceeds
+ * %OS_VERSION_TOP_K_MAX_CAPACITY, %OS_VERSION_ERROR_INVALID_DATA is returned.
+ *
+ * Returns: (transfer full): the loaded #OsVersionTopK
+ *
+ * Since: UNRELEASED
+ */
+OsVersionTopK *
+os_version_top_k_deserialize (GBytes *bytes, GError **error)
+{
+	OsVersionTopK *self;
+	Reader reader;
+	guint32 magic, version, capacity, n_counters, i;
+
+	g_return_val_if_fail (bytes != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	reader.data = g_bytes_get_data (bytes, &reader.length);
+	reader.offset = 0;
+
+	if (!read_uint32 (&reader, &magic) ||
+	    !read_uint32 (&reader, &version) ||
+	    !read_uint32 (&reader, &capacity) ||
+	    !read_uint32 (&reader, &n_counters) ||
+	    magic != TOP_K_MAGIC || version != TOP_K_FORMAT_VERSION ||
+	    capacity == 0 || capacity > OS_VERSION_TOP_K_MAX_CAPACITY ||
+	    n_counters > capacity ||
+	    n_counters > (reader.length - reader.offset) / TOP_K_ENTRY_MIN_SIZE) {
+		g_set_error_literal (error, OS_VERSION_ERROR,
+		                     OS_VERSION_ERROR_INVALID_DATA,
+		                     "Invalid top-K summary header.");
+		return NULL;
+	}
+
+	self = os_version_top_k_new (capacity);
+
+	for (i = 0; i < n_counters; i++) {
+		guint64 count, counter_error;
+		guint32 length;
+		const guint8 *data;
+		gchar *report;
+
+		if (!read_uint64 (&reader, &count) ||
+		    !read_uint64 (&reader, &counter_error) ||
+		    !read_uint32 (&reader, &length) ||
+		    !read_bytes (&reader, length, &data) ||
+		    memchr (data, '\0', length) != NULL) {
+			goto invalid_entry;
+		}
+
+		report = g_strndup ((const gchar *) data, length);
+
+		if (g_hash_table_contains (self->index, report)) {
+			g_free (report);
+			goto invalid_entry;
+		}
+
+		top_k_insert (self, report, count, counter_error);
+	}
+
+	return self;
+
+invalid_entry:
+	g_set_error_literal (error, OS_VERSION_ERROR,
+	                     OS_VERSION_ERROR_INVALID_DATA,
+	                     "Invalid top-K summary entry.");
+	os_version_top_k_free (self);
+
+	return NULL;
+}
+
+
+/*
+ * HyperLogLog
+ *
+ * See Flajolet et al., ‘HyperLogLog: the analysis of a near-optimal
+ * cardinality estimation algorithm’, 2007, with the small-range correction
+ * from the same paper. With 64-bit hashes no large-range correction is
+ * needed.
+ */
+
+#define HLL_MAGIC 0x4c48534fu  /* ‘OSHL’ */
+#define HLL_FORMAT_VERSION 1
+
+struct _OsVersionHll {
+	guint precision;
+	gsize n_registers;  /* 1 << precision */
+	guint8 *registers;  /* array of length @n_registers */
+};
+
+static guint
+count_leading_zeros (guint64 value)
+{
+#if defined(__GNUC__)
+	return (value == 0) ? 64 : __builtin_clzll (value);
+#else
+	guint n = 0;
+
+	if (value == 0) {
+		return 64;
+	}
+
+	while ((value & (G_GUINT64_CONSTANT (1) << 63)) == 0) {
+		value <<= 1;
+		n++;
+	}
+
+	return n;
+#endif
+}
+
+/**
+ * os_version_hll_new:
+ * @precision: number of bits of the hash used to select a register, between
+ *    %OS_VERSION_HLL_MIN_PRECISION and %OS_VERSION_HLL_MAX_PRECISION
+ *
+ * Create a new, empty HyperLogLog sketch. The sketch uses 2^@precision bytes,
+ * and has a standard error of about 1.04 / sqrt (2^@precision); a precision of
+ * 14 gives 16KiB sketches with 0.8% error.
+ *
+ * To count distinct configurations, keep one sketch per report field and one
+ * for the whole tuple of fields, and feed each report parsed with
+ * os_version_parse() to them using os_version_hll_add() and
+ * os_version_hll_add_hash() with os_version_fields_fingerprint().
+ *
+ * Sketches are not thread safe, but can be combined cheaply using
+ * os_version_hll_merge().
+ *
+ * Returns: (transfer full): a new #OsVersionHll
+ *
+ * Since: UNRELEASED
+ */
+OsVersionHll *
+os_version_hll_new (guint precision)
+{
+	OsVersionHll *self;
+
+	g_return_val_if_fail (precision >= OS_VERSION_HLL_MIN_PRECISION &&
+	                      precision <= OS_VERSION_HLL_MAX_PRECISION, NULL);
+
+	self = g_slice_new0 (OsVersionHll);
+	self->precision = precision;
+	self->n_registers = (gsize) 1 << precision;
+	self->registers = g_malloc0 (self->n_registers);
+
+	return self;
+}
+
+/**
+ * os_version_hll_free:
+ * @self: (transfer full): an #OsVersionHll
+ *
+ * Free a HyperLogLog sketch.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_hll_free (OsVersionHll *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_free (self->registers);
+	g_slice_free (OsVersionHll, self);
+}
+
+/**
+ * os_version_hll_add_hash:
+ * @self: an #OsVersionHll
+ * @hash: well-mixed 64-bit hash of the value to add
+ *
+ * Add a value to the sketch by its hash, such as one computed by
+ * os_version_fingerprint() or os_version_fields_fingerprint().
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_hll_add_hash (OsVersionHll *self, guint64 hash)
+{
+	gsize index;
+	guint8 rank;
+
+	g_return_if_fail (self != NULL);
+
+	/* The top bits select the register; the rank is the position of the
+	 * first set bit in the remainder. */
+	index = hash >> (64 - self->precision);
+	rank = MIN (count_leading_zeros (hash << self->precision),
+	            64 - self->precision) + 1;
+
+	if (rank > self->registers[index]) {
+		self->registers[index] = rank;
+	}
+}
+
+/**
+ * os_version_hll_add:
+ * @self: an #OsVersionHll
+ * @value: value to add, such as a single report field
+ * @length: length of @value in bytes, or -1 if it is nul-terminated
+ *
+ * Add a value to the sketch.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_hll_add (OsVersionHll *self, const gchar *value, gssize length)
+{
+	g_return_if_fail (self != NULL);
+
+	os_version_hll_add_hash (self, os_version_fingerprint (value, length));
+}
+
+/**
+ * os_version_hll_merge:
+ * @self: an #OsVersionHll
+ * @other: another #OsVersionHll with the same precision
+ *
+ * Merge @other into @self, so that @self estimates the number of distinct
+ * values in the union of both streams. @other is not modified.
+ *
+ * Since: UNRELEASED
+ */
+void
+os_version_hll_merge (OsVersionHll *self, const OsVersionHll *other)
+{
+	guint8 *registers;
+	const guint8 *other_registers;
+	gsize i;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (other != NULL);
+	g_return_if_fail (self->precision == other->precision);
+
+	/* Kept branch-free on byte arrays so the compiler vectorises it to
+	 * packed unsigned maximum instructions. */
+	registers = self->registers;
+	other_registers = other->registers;
+
+	for (i = 0; i < self->n_registers; i++) {
+		registers[i] = MAX (registers[i], other_registers[i]);
+	}
+}
+
+/**
+ * os_version_hll_estimate:
+ * @self: an #OsVersionHll
+ *
+ * Estimate the number of distinct values added to the sketch.
+ *
+ * Returns: estimated number of distinct values
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_hll_estimate (const OsVersionHll *self)
+{
+	gdouble m, alpha, sum, estimate;
+	gsize i, n_zero_registers;
+
+	g_return_val_if_fail (self != NULL, 0);
+
+	m = self->n_registers;
+
+	switch (self->n_registers) {
+	case 16:
+		alpha = 0.673;
+		break;
+	case 32:
+		alpha = 0.697;
+		break;
+	case 64:
+		alpha = 0.709;
+		break;
+	default:
+		alpha = 0.7213 / (1.0 + 1.079 / m);
+		break;
+	}
+
+	sum = 0.0;
+	n_zero_registers = 0;
+
+	for (i = 0; i < self->n_registers; i++) {
+		sum += ldexp (1.0, -self->registers[i]);
+		n_zero_registers += (self->registers[i] == 0);
+	}
+
+	estimate = alpha * m * m / sum;
+
+	/* Small-range correction: use linear counting. */
+	if (estimate <= 2.5 * m && n_zero_registers > 0) {
+		estimate = m * log (m / n_zero_registers);
+	}
+
+	return (guint64) (estimate + 0.5);
+}
+
+/**
+ * os_version_hll_serialize:
+ * @self: an #OsVersionHll
+ *
+ * Serialise the sketch to a portable byte string, which can be passed to
+ * another process and loaded with os_version_hll_deserialize().
+ *
+ * Returns: (transfer full): serialised sketch
+ *
+ * Since: UNRELEASED
+ */
+GBytes *
+os_version_hll_serialize (const OsVersionHll *self)
+{
+	GByteArray *buf;
+
+	g_return_val_if_fail (self != NULL, NULL);
+
+	buf = g_byte_array_sized_new (12 + self->n_registers);
+
+	append_uint32 (buf, HLL_MAGIC);
+	append_uint32 (buf, HLL_FORMAT_VERSION);
+	append_uint32 (buf, self->precision);
+	g_byte_array_append (buf, self->registers, self->n_registers);
+
+	return g_byte_array_free_to_bytes (buf);
+}
+
+/**
+ * os_version_hll_deserialize:
+ * @bytes: serialised sketch, from os_version_hll_serialize()
+ * @error: return location for a #GError, or %NULL
+ *
+ * Load a sketch previously serialised with os_version_hll_serialize(). If the
+ * data is invalid, %OS_VERSION_ERROR_INVALID_DATA is returned.
+ *
+ * Returns: (transfer full): the loaded #OsVersionHll
+ *
+ * Since: UNRELEASED
+ */
+OsVersionHll *
+os_version_hll_deserialize (GBytes *bytes, GError **error)
+{
+	OsVersionHll *self;
+	Reader reader;
+	guint32 magic, version, precision;
+	const guint8 *registers;
+	gsize i;
+
+	g_return_val_if_fail (bytes != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	reader.data = g_bytes_get_data (bytes, &reader.length);
+	reader.offset = 0;
+
+	if (!read_uint32 (&reader, &magic) ||
+	    !read_uint32 (&reader, &version) ||
+	    !read_uint32 (&reader, &precision) ||
+	    magic != HLL_MAGIC || version != HLL_FORMAT_VERSION ||
+	    precision < OS_VERSION_HLL_MIN_PRECISION ||
+	    precision > OS_VERSION_HLL_MAX_PRECISION ||
+	    !read_bytes (&reader, (gsize) 1 << precision, &registers) ||
+	    reader.offset != reader.length) {
+		g_set_error_literal (error, OS_VERSION_ERROR,
+		                     OS_VERSION_ERROR_INVALID_DATA,
+		                     "Invalid HyperLogLog sketch.");
+		return NULL;
+	}
+
+	self = os_version_hll_new (precision);
+
+	for (i = 0; i < self->n_registers; i++) {
+		if (registers[i] > 64 - precision + 1) {
+			g_set_error_literal (error, OS_VERSION_ERROR,
+			                     OS_VERSION_ERROR_INVALID_DATA,
+			                     "Invalid HyperLogLog sketch.");
+			os_version_hll_free (self);
+
+			return NULL;
+		}
+	}
+
+	memcpy (self->registers, registers, self->n_registers);
+
+	return self;
+}
@@ -0,0 +1,124 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_SKETCH_H_
+#define _OS_VERSION_SKETCH_H_
+
+
+/**
+ * OsVersionTopK:
+ *
+ * A bounded-memory summary of the most frequent reports in a stream. All the
+ * fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionTopK OsVersionTopK;
+
+#define OS_VERSION_TOP_K_MAX_CAPACITY (1 << 20)
+
+/**
+ * OsVersionTopKEntry:
+ * @report: the report string
+ * @count: estimated number of occurrences of @report; this never
+ *    underestimates the true count
+ * @error: maximum overestimation in @count
+ *
+ * A single entry from an #OsVersionTopK.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+	const gchar *report;
+	guint64 count;
+	guint64 error;
+} OsVersionTopKEntry;
+
+OsVersionTopK *
+os_version_top_k_new (guint capacity);
+
+void
+os_version_top_k_free (OsVersionTopK *self);
+
+void
+os_version_top_k_add (OsVersionTopK *self, const gchar *report,
+                      guint64 count);
+
+void
+os_version_top_k_merge (OsVersionTopK *self, const OsVersionTopK *other);
+
+void
+os_version_top_k_clear (OsVersionTopK *self);
+
+GArray *
+os_version_top_k_get_entries (const OsVersionTopK *self);
+
+GBytes *
+os_version_top_k_serialize (const OsVersionTopK *self);
+
+OsVersionTopK *
+os_version_top_k_deserialize (GBytes *bytes, GError **error);
+
+
+/**
+ * OsVersionHll:
+ *
+ * A HyperLogLog sketch estimating the number of distinct values in a stream.
+ * All the fields are private.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct _OsVersionHll OsVersionHll;
+
+#define OS_VERSION_HLL_MIN_PRECISION 4
+#define OS_VERSION_HLL_MAX_PRECISION 18
+
+OsVersionHll *
+os_version_hll_new (guint precision);
+
+void
+os_version_hll_free (OsVersionHll *self);
+
+void
+os_version_hll_add_hash (OsVersionHll *self, guint64 hash);
+
+void
+os_version_hll_add (OsVersionHll *self, const gchar *value, gssize length);
+
+void
+os_version_hll_merge (OsVersionHll *self, const OsVersionHll *other);
+
+guint64
+os_version_hll_estimate (const OsVersionHll *self);
+
+GBytes *
+os_version_hll_serialize (const OsVersionHll *self);
+
+OsVersionHll *
+os_version_hll_deserialize (GBytes *bytes, GError **error);
+
+
+#endif /* _OS_VERSION_SKETCH_H_ */
@@ -27,6 +27,10 @@
 
 #include <glib.h>
 
+#ifdef G_OS_UNIX
+#include <sys/uio.h>
+#endif
+
 #ifdef HAVE_SYS_UTSNAME_H
 /* Standard on Unices. */
 #include <sys/utsname.h>
@@ -48,6 +52,11 @@
 #endif
 
 #include "osversion.h"
+#include "osversion-private.h"
+#include "osversion-probe.h"
+
+
+G_DEFINE_QUARK (os-version-error-quark, os_version_error)
 
 
 #if defined(__APPLE__) && defined(__MACH__)
@@ -72,54 +81,76 @@ get_apple_hw_property (const gchar *property_name)
 }
 #endif  /* Apple */
 
+/* Add a field to a report being probed. @name is a key for the field in
+ * structured formats, such as a journal field name; it must be unique within
+ * the report. */
+static void
+add_field (GPtrArray/*<owned string>*/ *fields,
+           GPtrArray/*<owned string>*/ *names,
+           const gchar *name,
+           gchar *value)
+{
+	g_ptr_array_add (fields, value);
+	g_ptr_array_add (names, g_strdup (name));
+}
+
 #ifdef HAVE_SYS_UTSNAME_H
 static void
-get_uname_fields (GPtrArray/*<owned string>*/ *fields)
+get_uname_fields (GPtrArray/*<owned string>*/ *fields,
+                  GPtrArray/*<owned string>*/ *names)
 {
 	struct utsname name;
 
 	memset (&name, 0, sizeof (name));
 
 	if (uname (&name) != -1) {
-		g_ptr_array_add (fields, g_strdup (name.sysname));
-		g_ptr_array_add (fields, g_strdup (name.release));
-		g_ptr_array_add (fields, g_strdup (name.version));
-		g_ptr_array_add (fields, g_strdup (name.machine));
+		add_field (fields, names, "OS_SYSNAME",
+		           g_strdup (name.sysname));
+		add_field (fields, names, "OS_RELEASE",
+		           g_strdup (name.release));
+		add_field (fields, names, "OS_VERSION",
+		           g_strdup (name.version));
+		add_field (fields, names, "OS_MACHINE",
+		           g_strdup (name.machine));
 	}
 }
 #endif /* HAVE_SYS_UTSNAME_H */
 
-/**
- * get_os_version:
- *
- * Gets detailed information about the OS the client is currently running on.
- * This is returned in the following format:
- * |[
- * OS name[, other version data[, …]], OS_VERSION
- * ]|
- *
- * ``OS_VERSION`` is as specified at configure time. The OS name is a string
- * like ‘iOS’ or ‘Linux’, and may contain any character except a comma. The
- * other version data will be zero or more fields, separated by commas, quoted
- * with double quotation marks and escaped using g_strescape(). Each field may
- * contain any character, but will typically be an ASCII string, integer, or
- * version number (integers separated by dots).
- *
- * This should not return any machine-specific identifiable information, such
- * as the hostname.
- *
- * Returns: (transfer full): the UTF-8 OS version string
- *
- * Since: 0.1.0
- */
-gchar *
-get_os_version (void)
+#ifdef __linux__
+/* Fields about the Linux system beyond uname(). These are appended after all
+ * the other fields for the platform, so existing field positions don’t
+ * change. Add new entries at the end. */
+static void
+get_linux_fields (GPtrArray/*<owned string>*/ *fields,
+                  GPtrArray/*<owned string>*/ *names)
 {
-	GPtrArray/*<owned string>*/ *fields;
-	GString *out;
-	guint j;
+	const OsVersionTimingInfo *timing_info;
+
+	add_field (fields, names, "OS_CPU_VULNERABILITIES",
+	           g_strdup (os_version_get_cpu_vulnerabilities ()));
+
+	timing_info = os_version_get_timing_info ();
+	add_field (fields, names, "OS_CLOCKSOURCE",
+	           g_strdup (timing_info->clocksource));
+	add_field (fields, names, "OS_THP_MODE",
+	           g_strdup (timing_info->thp_mode));
+	add_field (fields, names, "OS_HUGEPAGES",
+	           g_strdup_printf ("%" G_GUINT64_FORMAT,
+	                            timing_info->n_hugepages));
+	add_field (fields, names, "OS_HUGEPAGE_SIZE",
+	           g_strdup_printf ("%" G_GUINT64_FORMAT,
+	                            timing_info->hugepage_size));
+}
+#endif /* __linux__ */
+
+/* Probe the fields of the report for the running system, and their names. */
+static GPtrArray/*<owned string>*/ *
+probe_fields (GPtrArray/*<owned string>*/ **names_out)
+{
+	GPtrArray/*<owned string>*/ *fields, *names;
 
 	fields = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+	names = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
 
 #if defined(__APPLE__) && defined(__MACH__)
 {
@@ -144,18 +175,20 @@ get_os_version (void)
 	os_name = "Apple";
 #endif
 
-	g_ptr_array_add (fields, g_strdup (os_name));
+	add_field (fields, names, "OS_NAME", g_strdup (os_name));
 
 	/* Grab some general purpose kernel information. */
-	get_uname_fields (fields);
+	get_uname_fields (fields, names);
 
 	/* Get the runtime device.
 	 *
 	 * Reference: https://gist.github.com/Jaybles/1323251
 	 * Reference: https://developer.apple.com/library/mac/documentation/
 	 *            Darwin/Reference/ManPages/man3/sysctlbyname.3.html*/
-	g_ptr_array_add (fields, get_apple_hw_property ("hw.machine"));
-	g_ptr_array_add (fields, get_apple_hw_property ("hw.model"));
+	add_field (fields, names, "OS_HW_MACHINE",
+	           get_apple_hw_property ("hw.machine"));
+	add_field (fields, names, "OS_HW_MODEL",
+	           get_apple_hw_property ("hw.model"));
 }
 #elif defined(_WIN64) || defined(_WIN32)
 {
@@ -165,7 +198,7 @@ get_os_version (void)
 	gboolean success = FALSE;
 	gboolean have_extended_fields = FALSE;
 
-	g_ptr_array_add (fields, g_strdup ("Windows"));
+	add_field (fields, names, "OS_NAME", g_strdup ("Windows"));
 
 	/* Get the version information. */
 	memset (&info, 0, sizeof (info));
@@ -185,30 +218,27 @@ get_os_version (void)
 
 	/* Success? */
 	if (success) {
-		g_ptr_array_add (fields,
-		                 g_strdup_printf ("%u",
-		                                  info.dwOSVersionInfoSize));
-		g_ptr_array_add (fields,
-		                 g_strdup_printf ("%u.%u.%u",
-		                                  info.dwMajorVersion,
-		                                  info.dwMinorVersion,
-		                                  info.dwBuildNumber));
-		g_ptr_array_add (fields,
-		                 g_strdup_printf ("%u",
-		                                  info.dwPlatformId));
-		g_ptr_array_add (fields, g_strdup (info.szCSDVersion));
+		add_field (fields, names, "OS_VERSION_INFO_SIZE",
+		           g_strdup_printf ("%u", info.dwOSVersionInfoSize));
+		add_field (fields, names, "OS_VERSION",
+		           g_strdup_printf ("%u.%u.%u",
+		                            info.dwMajorVersion,
+		                            info.dwMinorVersion,
+		                            info.dwBuildNumber));
+		add_field (fields, names, "OS_PLATFORM_ID",
+		           g_strdup_printf ("%u", info.dwPlatformId));
+		add_field (fields, names, "OS_CSD_VERSION",
+		           g_strdup (info.szCSDVersion));
 
 		if (have_extended_fields) {
-			g_ptr_array_add (fields,
-			                 g_strdup_printf ("%u.%u",
-			                                  info.wServicePackMajor,
-			                                  info.wServicePackMinor));
-			g_ptr_array_add (fields,
-			                 g_strdup_printf ("%u",
-			                                  info.wSuiteMask));
-			g_ptr_array_add (fields,
-			                 g_strdup_printf ("%u",
-			                                  info.wProductType));
+			add_field (fields, names, "OS_SERVICE_PACK",
+			           g_strdup_printf ("%u.%u",
+			                            info.wServicePackMajor,
+			                            info.wServicePackMinor));
+			add_field (fields, names, "OS_SUITE_MASK",
+			           g_strdup_printf ("%u", info.wSuiteMask));
+			add_field (fields, names, "OS_PRODUCT_TYPE",
+			           g_strdup_printf ("%u", info.wProductType));
 		}
 	}
 
@@ -216,13 +246,12 @@ get_os_version (void)
 	memset (&sys_info, 0, sizeof (sys_info));
 	GetSystemInfo (&sys_info);
 
-	g_ptr_array_add (fields,
-	                 g_strdup_printf ("%u",
-	                                  sys_info.wProcessorArchitecture));
-	g_ptr_array_add (fields,
-	                 g_strdup_printf ("%u", sys_info.wProcessorLevel));
-	g_ptr_array_add (fields,
-	                 g_strdup_printf ("%u", sys_info.wProcessorRevision));
+	add_field (fields, names, "OS_PROCESSOR_ARCHITECTURE",
+	           g_strdup_printf ("%u", sys_info.wProcessorArchitecture));
+	add_field (fields, names, "OS_PROCESSOR_LEVEL",
+	           g_strdup_printf ("%u", sys_info.wProcessorLevel));
+	add_field (fields, names, "OS_PROCESSOR_REVISION",
+	           g_strdup_printf ("%u", sys_info.wProcessorRevision));
 }
 #elif defined(__ANDROID__)
 {
@@ -245,57 +274,1216 @@ get_os_version (void)
 		 * the OS details, so can’t be changed. */
 	};
 
-	g_ptr_array_add (fields, g_strdup ("Android"));
-	g_ptr_array_add (fields, g_strdup_printf ("%u", __ANDROID_API__));
+	add_field (fields, names, "OS_NAME", g_strdup ("Android"));
+	add_field (fields, names, "OS_API_LEVEL",
+	           g_strdup_printf ("%u", __ANDROID_API__));
 
 	/* Grab stuff from the kernel. Probably not very useful. */
-	get_uname_fields (fields);
+	get_uname_fields (fields, names);
 
 	/* Grab stuff via JNI.
 	 *
 	 * Reference: https://gist.github.com/deltheil/2291028 */
 	for (i = 0; i < G_N_ELEMENTS (property_names); i++) {
 		gchar prop[PROP_VALUE_MAX + 1];
+		gchar *upper, *name;
 		gint length;
 
+		/* Name the field after the property: ‘ro.build.id’ becomes
+		 * ‘OS_BUILD_ID’. */
+		upper = g_ascii_strup (property_names[i] + strlen ("ro"), -1);
+		name = g_strconcat ("OS", g_strdelimit (upper, ".", '_'),
+		                    NULL);
+		g_free (upper);
+
 		/* length will be zero if the property doesn’t exist. */
 		length = __system_property_get (property_names[i], prop);
 
 		if (length > 0) {
-			g_ptr_array_add (fields, g_strndup (prop, length));
+			add_field (fields, names, name,
+			           g_strndup (prop, length));
 		} else {
-			g_ptr_array_add (fields, g_strdup ("Unknown"));
+			add_field (fields, names, name, g_strdup ("Unknown"));
 		}
+
+		g_free (name);
 	}
+
+	get_linux_fields (fields, names);
 }
 #else
 {
 	/* Linux. */
-	g_ptr_array_add (fields, g_strdup ("Linux"));
-	get_uname_fields (fields);
+	add_field (fields, names, "OS_NAME", g_strdup ("Linux"));
+	get_uname_fields (fields, names);
+#ifdef __linux__
+	get_linux_fields (fields, names);
+#endif
 }
 #endif
 
+	*names_out = names;
+
+	return fields;
+}
+
+/**
+ * get_os_version:
+ *
+ * Gets detailed information about the OS the client is currently running on.
+ * This is returned in the following format:
+ * |[
+ * OS name[, other version data[, …]], OS_VERSION
+ * ]|
+ *
+ * ``OS_VERSION`` is as specified at configure time. The OS name is a string
+ * like ‘iOS’ or ‘Linux’, and may contain any character except a comma. The
+ * other version data will be zero or more fields, separated by commas, quoted
+ * with double quotation marks and escaped using g_strescape(). Each field may
+ * contain any character, but will typically be an ASCII string, integer, or
+ * version number (integers separated by dots).
+ *
+ * This should not return any machine-specific identifiable information, such
+ * as the hostname.
+ *
+ * Returns: (transfer full): the UTF-8 OS version string
+ *
+ * Since: 0.1.0
+ */
+gchar *
+get_os_version (void)
+{
+	GPtrArray/*<owned string>*/ *fields, *names;
+	gchar *out;
+
+	fields = probe_fields (&names);
+	g_ptr_array_unref (names);
+
 	/* Escape and implode the fields. */
-	out = g_string_new ("");
+	out = os_version_format ((const gchar * const *) fields->pdata,
+	                         fields->len);
+
+	g_ptr_array_unref (fields);
 
-	for (j = 0; j < fields->len; j++) {
-		gchar *value, *escaped;
+	return out;
+}
 
-		value = g_ptr_array_index (fields, j);
-		escaped = g_strescape (value, "");
+typedef struct {
+	GPtrArray/*<owned string>*/ *fields;  /* NULL-terminated */
+	GPtrArray/*<owned string>*/ *names;  /* NULL-terminated */
+} ProbedFields;
 
-		g_string_append_printf (out, "%s\"%s\"",
-		                        (j > 0) ? ", " : "", escaped);
+/* Probe the running system once, and cache the result. */
+static const ProbedFields *
+get_probed_fields (void)
+{
+	static gsize probed_once = 0;
+	static ProbedFields probed = { NULL, NULL };
 
-		g_free (escaped);
+	if (g_once_init_enter (&probed_once)) {
+		probed.fields = probe_fields (&probed.names);
+		g_ptr_array_add (probed.fields, NULL);
+		g_ptr_array_add (probed.names, NULL);
+		g_once_init_leave (&probed_once, 1);
 	}
 
-	g_ptr_array_unref (fields);
+	return &probed;
+}
+
+/**
+ * os_version_get_fields:
+ * @n_fields: (out) (optional): return location for the number of fields
+ *
+ * Get the fields of the report for the running system, unescaped, as
+ * os_version_parse() would return them from the output of get_os_version().
+ *
+ * The system is probed on the first call, and the result is cached for the
+ * lifetime of the process, so this is cheap enough to call for every log
+ * message. It is safe to call from multiple threads.
+ *
+ * Returns: (transfer none) (array length=n_fields zero-terminated=1): the
+ *    cached fields
+ *
+ * Since: UNRELEASED
+ */
+const gchar * const *
+os_version_get_fields (gsize *n_fields)
+{
+	const ProbedFields *probed = get_probed_fields ();
+
+	if (n_fields != NULL) {
+		*n_fields = probed->fields->len - 1;
+	}
+
+	return (const gchar * const *) probed->fields->pdata;
+}
+
+/**
+ * os_version_get_report:
+ * @flags: optional fields to include
+ *
+ * Get the report for the running system, as get_os_version() does, with
+ * optional extra fields appended in the order of the flags in @flags. Servers
+ * which count fields from the start of the report are unaffected by them.
+ *
+ * Unlike get_os_version(), this uses the fields cached by
+ * os_version_get_fields().
+ *
+ * Returns: (transfer full): the report string
+ *
+ * Since: UNRELEASED
+ */
+gchar *
+os_version_get_report (OsVersionReportFlags flags)
+{
+	GPtrArray/*<owned string>*/ *extra_fields;
+	const gchar * const *fields;
+	const gchar **all_fields;
+	gchar *out;
+	gsize i, n_fields;
+
+	fields = os_version_get_fields (&n_fields);
+	extra_fields = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+
+	if (flags & OS_VERSION_REPORT_FLAGS_KERNEL_CAPS) {
+		g_ptr_array_add (extra_fields,
+		                 g_strdup_printf ("%x",
+		                                  os_version_get_kernel_caps ()));
+	}
+
+	all_fields = g_new (const gchar *, n_fields + extra_fields->len);
+	memcpy (all_fields, fields, n_fields * sizeof (*fields));
+
+	for (i = 0; i < extra_fields->len; i++) {
+		all_fields[n_fields + i] = extra_fields->pdata[i];
+	}
+
+	out = os_version_format (all_fields, n_fields + extra_fields->len);
+
+	g_free (all_fields);
+	g_ptr_array_unref (extra_fields);
+
+	return out;
+}
+
+/**
+ * os_version_get_field_names:
+ * @n_fields: (out) (optional): return location for the number of fields
+ *
+ * Get names for the fields returned by os_version_get_fields(), in the same
+ * order. Names are unique, and are valid journal field names, such as
+ * ‘OS_NAME’ or ‘OS_RELEASE’. Which names are present depends on the platform.
+ *
+ * Returns: (transfer none) (array length=n_fields zero-terminated=1): the
+ *    cached field names
+ *
+ * Since: UNRELEASED
+ */
+const gchar * const *
+os_version_get_field_names (gsize *n_fields)
+{
+	const ProbedFields *probed = get_probed_fields ();
+
+	if (n_fields != NULL) {
+		*n_fields = probed->names->len - 1;
+	}
+
+	return (const gchar * const *) probed->names->pdata;
+}
+
+/**
+ * os_version_get_variant:
+ *
+ * Get the fields of the report for the running system as a #GVariant of type
+ * `a{say}`, mapping the names from os_version_get_field_names() to the field
+ * values, in the same order. The values are bytestrings, since fields such as
+ * device names are not guaranteed to be valid UTF-8, which GVariant strings
+ * must be. Each is exactly the field from os_version_get_fields(), with a nul
+ * terminator, so g_variant_get_bytestring() returns it unchanged.
+ *
+ * The variant is built and serialised on the first call, and cached. Its
+ * serialised data can therefore be shared by reference using
+ * g_variant_get_data_as_bytes(), for example to send it over D-Bus or write it
+ * to disk, and later loaded again with g_variant_new_from_bytes() without
+ * reparsing.
+ *
+ * Returns: (transfer full): the report fields, as a non-floating reference
+ *
+ * Since: UNRELEASED
+ */
+GVariant *
+os_version_get_variant (void)
+{
+	static gsize variant_once = 0;
+	static GVariant *variant = NULL;
+
+	if (g_once_init_enter (&variant_once)) {
+		const gchar * const *fields, * const *names;
+		GVariantBuilder builder;
+		gsize i, n;
+
+		fields = os_version_get_fields (&n);
+		names = os_version_get_field_names (NULL);
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{say}"));
+
+		for (i = 0; i < n; i++) {
+			g_variant_builder_add (&builder, "{s^ay}", names[i],
+			                       fields[i]);
+		}
+
+		variant = g_variant_ref_sink (g_variant_builder_end (&builder));
+
+		/* Serialise it now, rather than on first use. */
+		g_variant_get_data (variant);
+
+		g_once_init_leave (&variant_once, 1);
+	}
+
+	return g_variant_ref (variant);
+}
+
+#if GLIB_CHECK_VERSION (2, 50, 0)
+/**
+ * os_version_get_log_fields:
+ * @n_fields: (out): return location for the number of fields
+ *
+ * Get the fields of the report for the running system as an array of
+ * #GLogFields, keyed by the names from os_version_get_field_names(). The
+ * array can be passed to g_log_structured_array(), or copied into a larger
+ * array of fields, without any formatting or allocation per message.
+ *
+ * The array is built on the first call and is immutable and valid for the
+ * lifetime of the process. It must not be modified or freed.
+ *
+ * Returns: (transfer none) (array length=n_fields): the log fields
+ *
+ * Since: UNRELEASED
+ */
+const GLogField *
+os_version_get_log_fields (gsize *n_fields)
+{
+	static gsize log_fields_once = 0;
+	static GLogField *log_fields = NULL;
+	static gsize n_log_fields = 0;
+
+	g_return_val_if_fail (n_fields != NULL, NULL);
+
+	if (g_once_init_enter (&log_fields_once)) {
+		const gchar * const *fields, * const *names;
+		gsize i, n;
+
+		fields = os_version_get_fields (&n);
+		names = os_version_get_field_names (NULL);
+		log_fields = g_new (GLogField, MAX (n, 1));
+
+		for (i = 0; i < n; i++) {
+			log_fields[i].key = names[i];
+			log_fields[i].value = fields[i];
+			log_fields[i].length = -1;
+		}
+
+		n_log_fields = n;
+		g_once_init_leave (&log_fields_once, 1);
+	}
+
+	*n_fields = n_log_fields;
+
+	return log_fields;
+}
+#endif /* GLib ≥ 2.50 */
+
+#ifdef G_OS_UNIX
+/**
+ * os_version_get_report_iov:
+ * @n_iov: (out): return location for the number of elements in the array
+ *
+ * Get the report for the running system, as returned by get_os_version(), as
+ * an array of `struct iovec` which can be passed to writev() or sendmsg()
+ * without copying it into a new buffer. The array alternates between the
+ * escaped fields and static separators.
+ *
+ * The array and the data it points to are built from the cached fields on the
+ * first call (see os_version_get_fields()), and are immutable and valid for
+ * the lifetime of the process. They must not be modified or freed.
+ *
+ * Returns: (transfer none) (array length=n_iov): the report segments
+ *
+ * Since: UNRELEASED
+ */
+const struct iovec *
+os_version_get_report_iov (gsize *n_iov)
+{
+	static gsize iov_once = 0;
+	static struct iovec *iov = NULL;
+	static gsize iov_length = 0;
+
+	g_return_val_if_fail (n_iov != NULL, NULL);
+
+	if (g_once_init_enter (&iov_once)) {
+		static gchar opening_quote[] = "\"";
+		static gchar separator[] = "\", \"";
+		static gchar closing_quote[] = "\"";
+		const gchar * const *fields;
+		gsize i, n_fields;
+
+		fields = os_version_get_fields (&n_fields);
+
+		/* Quote, field, then a separator or closing quote after each
+		 * field. */
+		iov_length = (n_fields > 0) ? 2 * n_fields + 1 : 0;
+		iov = g_new (struct iovec, MAX (iov_length, 1));
+
+		for (i = 0; i < n_fields; i++) {
+			gchar *escaped = g_strescape (fields[i], "");
+
+			iov[2 * i].iov_base = (i == 0) ? opening_quote :
+			                                 separator;
+			iov[2 * i].iov_len = strlen (iov[2 * i].iov_base);
+			iov[2 * i + 1].iov_base = escaped;
+			iov[2 * i + 1].iov_len = strlen (escaped);
+		}
+
+		if (n_fields > 0) {
+			iov[2 * n_fields].iov_base = closing_quote;
+			iov[2 * n_fields].iov_len = 1;
+		}
+
+		g_once_init_leave (&iov_once, 1);
+	}
+
+	*n_iov = iov_length;
+
+	return iov;
+}
+#endif /* G_OS_UNIX */
+
+/**
+ * os_version_format:
+ * @fields: (array length=n_fields): report fields
+ * @n_fields: number of elements in @fields, or -1 if it is %NULL-terminated
+ *
+ * Format a set of fields as a report string, in the format documented for
+ * get_os_version(). This is the inverse of os_version_parse(), and can be used
+ * to rebuild a report from fields which have been stored or transmitted
+ * separately.
+ *
+ * This is equivalent to calling os_version_format_full() with
+ * %OS_VERSION_FORMAT_FLAGS_NONE.
+ *
+ * Returns: (transfer full): the report string
+ *
+ * Since: UNRELEASED
+ */
+gchar *
+os_version_format (const gchar * const *fields, gssize n_fields)
+{
+	return os_version_format_full (fields, n_fields,
+	                               OS_VERSION_FORMAT_FLAGS_NONE);
+}
+
+#define SWAR_ONES G_GUINT64_CONSTANT (0x0101010101010101)
+#define SWAR_HIGHS G_GUINT64_CONSTANT (0x8080808080808080)
+
+/* Non-zero if any byte of @word is zero. */
+#define SWAR_HAS_ZERO(word) (((word) - SWAR_ONES) & ~(word) & SWAR_HIGHS)
+
+/* Check whether all 8 bytes at @p can be copied unescaped: that is, none is
+ * non-ASCII, a control character, a quotation mark or a backslash. */
+static inline gboolean
+word_is_plain (const gchar *p)
+{
+	guint64 word;
+
+	memcpy (&word, p, sizeof (word));
+
+	return !((word & SWAR_HIGHS) ||
+	         /* Any byte < 0x20 or == 0x7f. */
+	         (((word - SWAR_ONES * 0x20) | (word + SWAR_ONES * 0x01)) &
+	          SWAR_HIGHS) ||
+	         SWAR_HAS_ZERO (word ^ (SWAR_ONES * '"')) ||
+	         SWAR_HAS_ZERO (word ^ (SWAR_ONES * '\\')));
+}
+
+/* Escape @field like g_strescape() does, except that valid UTF-8 sequences
+ * for non-control characters are copied through. Runs of plain ASCII are
+ * checked a word at a time. */
+static void
+append_escaped_utf8 (GString *out, const gchar *field)
+{
+	const gchar *p, *run, *end;
+
+	end = field + strlen (field);
+
+	for (p = run = field; p < end;) {
+		guchar c = *p;
+		gunichar ch;
+
+		if (end - p >= 8 && word_is_plain (p)) {
+			p += 8;
+			continue;
+		}
+
+		if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+			p++;
+			continue;
+		}
+
+		if (c >= 0x80) {
+			ch = g_utf8_get_char_validated (p, end - p);
+
+			/* Pass through everything except invalid sequences
+			 * and C1 control characters. */
+			if (ch != (gunichar) -1 && ch != (gunichar) -2 &&
+			    ch >= 0xa0) {
+				p += g_utf8_skip[c];
+				continue;
+			}
+		}
+
+		g_string_append_len (out, run, p - run);
+
+		switch (c) {
+		case '\b':
+			g_string_append (out, "\\b");
+			break;
+		case '\f':
+			g_string_append (out, "\\f");
+			break;
+		case '\n':
+			g_string_append (out, "\\n");
+			break;
+		case '\r':
+			g_string_append (out, "\\r");
+			break;
+		case '\t':
+			g_string_append (out, "\\t");
+			break;
+		case '\\':
+		case '"':
+			g_string_append_c (out, '\\');
+			g_string_append_c (out, c);
+			break;
+		default:
+			/* Escape a single byte; any continuation bytes of an
+			 * invalid or control sequence are handled in turn. */
+			g_string_append_c (out, '\\');
+			g_string_append_c (out, '0' + (c >> 6));
+			g_string_append_c (out, '0' + ((c >> 3) & 7));
+			g_string_append_c (out, '0' + (c & 7));
+			break;
+		}
+
+		p++;
+		run = p;
+	}
+
+	g_string_append_len (out, run, p - run);
+}
+
+/*
+ * os_version_append_formatted:
+ * @out: string to append to
+ * @fields: (array length=n_fields): report fields
+ * @n_fields: number of elements in @fields, or -1 if it is %NULL-terminated
+ * @flags: flags affecting the formatting
+ *
+ * Append the report string for @fields to @out, as os_version_format_full()
+ * returns it, so that callers can reuse a buffer.
+ */
+void
+os_version_append_formatted (GString *out,
+                             const gchar * const *fields,
+                             gssize n_fields,
+                             OsVersionFormatFlags flags)
+{
+	gsize j;
+
+	for (j = 0; (n_fields < 0) ? fields[j] != NULL : j < (gsize) n_fields;
+	     j++) {
+		if (j > 0) {
+			g_string_append (out, ", ");
+		}
+
+		g_string_append_c (out, '"');
+
+		if (flags & OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8) {
+			append_escaped_utf8 (out, fields[j]);
+		} else {
+			gchar *escaped = g_strescape (fields[j], "");
+
+			g_string_append (out, escaped);
+			g_free (escaped);
+		}
+
+		g_string_append_c (out, '"');
+	}
+}
+
+/**
+ * os_version_format_full:
+ * @fields: (array length=n_fields): report fields
+ * @n_fields: number of elements in @fields, or -1 if it is %NULL-terminated
+ * @flags: flags affecting the formatting
+ *
+ * Format a set of fields as a report string, as os_version_format() does.
+ *
+ * If %OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8 is set, valid UTF-8 sequences for
+ * non-ASCII characters are not escaped, rather than each of their bytes being
+ * escaped as a four-byte octal sequence. This makes reports from devices with
+ * non-ASCII names much shorter. Invalid bytes and control characters are still
+ * escaped, so the result is always valid UTF-8. os_version_parse() accepts
+ * reports in either form and returns the same fields.
+ *
+ * Returns: (transfer full): the report string
+ *
+ * Since: UNRELEASED
+ */
+gchar *
+os_version_format_full (const gchar * const *fields,
+                        gssize n_fields,
+                        OsVersionFormatFlags flags)
+{
+	GString *out;
+
+	g_return_val_if_fail (fields != NULL || n_fields == 0, NULL);
+
+	out = g_string_new ("");
+	os_version_append_formatted (out, fields, n_fields, flags);
 
 	return g_string_free (out, FALSE);
 }
 
+/**
+ * os_version_unescape:
+ * @source: (array length=length): escaped field data, as produced by
+ *    g_strescape()
+ * @length: length of @source, in bytes
+ * @dest: (out caller-allocates): output buffer, at least @length bytes long;
+ *    this may be the same as @source to unescape in place
+ *
+ * Reverse the escaping applied to each field by get_os_version(). This is
+ * equivalent to g_strcompress(), but works on a length-delimited buffer (which
+ * need not be nul-terminated), can write in place, and copies runs of
+ * unescaped bytes in bulk rather than one byte at a time. Typical report fields
+ * contain few or no escapes, so the bulk copies dominate.
+ *
+ * The output is never longer than the input. No nul terminator is written.
+ *
+ * Returns: number of bytes written to @dest
+ *
+ * Since: UNRELEASED
+ */
+gsize
+os_version_unescape (const gchar *source, gsize length, gchar *dest)
+{
+	const gchar *p, *end;
+	gchar *q;
+
+	g_return_val_if_fail (source != NULL || length == 0, 0);
+	g_return_val_if_fail (dest != NULL || length == 0, 0);
+
+	p = source;
+	end = source + length;
+	q = dest;
+
+	while (p < end) {
+		const gchar *backslash, *octal_end;
+		gsize span;
+
+		/* memchr() is vectorised by every libc we care about, so use it
+		 * to find the next escape and copy everything before it. */
+		backslash = memchr (p, '\\', end - p);
+		span = ((backslash != NULL) ? backslash : end) - p;
+
+		if (q != p) {
+			memmove (q, p, span);
+		}
+
+		q += span;
+		p += span;
+
+		if (backslash == NULL) {
+			break;
+		}
+
+		/* Skip the backslash. A trailing one is dropped, as
+		 * g_strcompress() does. */
+		p++;
+
+		if (p == end) {
+			break;
+		}
+
+		switch (*p) {
+		case '0': case '1': case '2': case '3':
+		case '4': case '5': case '6': case '7':
+			*q = 0;
+			octal_end = MIN (p + 3, end);
+
+			while (p < octal_end && *p >= '0' && *p <= '7') {
+				*q = (*q * 8) + (*p - '0');
+				p++;
+			}
+
+			q++;
+			continue;
+		case 'b':
+			*q++ = '\b';
+			break;
+		case 'f':
+			*q++ = '\f';
+			break;
+		case 'n':
+			*q++ = '\n';
+			break;
+		case 'r':
+			*q++ = '\r';
+			break;
+		case 't':
+			*q++ = '\t';
+			break;
+		case 'v':
+			*q++ = '\v';
+			break;
+		default:
+			/* Includes \\ and \". */
+			*q++ = *p;
+			break;
+		}
+
+		p++;
+	}
+
+	return q - dest;
+}
+
+/* Find the closing quotation mark of a quoted field starting at @p. Quotation
+ * marks and backslashes inside the field are always escaped by g_strescape(),
+ * so the closing one is the first quotation mark preceded by an even number of
+ * backslashes. */
+static const gchar *
+find_closing_quote (const gchar *p, const gchar *end)
+{
+	const gchar *quote;
+
+	while ((quote = memchr (p, '"', end - p)) != NULL) {
+		const gchar *q;
+
+		for (q = quote; q > p && *(q - 1) == '\\'; q--);
+
+		if ((quote - q) % 2 == 0) {
+			return quote;
+		}
+
+		p = quote + 1;
+	}
+
+	return NULL;
+}
+
+/*
+ * os_version_scan_field:
+ * @report: the whole report, for error messages
+ * @p: (inout): position of the next field in @report; updated to just after it
+ * @end: end of @report
+ * @first: %TRUE if this is the first field, which has no separator before it
+ * @field: (out): return location for the start of the field’s bytes
+ * @field_length: (out): return location for the length of the field’s bytes
+ * @escaped: (out): return location for whether the field’s bytes must be
+ *    passed through os_version_unescape() to get its value
+ * @error: return location for a #GError, or %NULL
+ *
+ * Find the next field in a report without copying it. Fields which are
+ * unquoted, or quoted but contain no escapes, are their own value. The caller
+ * must stop when *@p reaches @end.
+ *
+ * Returns: %TRUE on success, %FALSE if the report is invalid
+ */
+gboolean
+os_version_scan_field (const gchar *report,
+                       const gchar **p,
+                       const gchar *end,
+                       gboolean first,
+                       const gchar **field,
+                       gsize *field_length,
+                       gboolean *escaped,
+                       GError **error)
+{
+	const gchar *field_end;
+
+	if (!first) {
+		if (end - *p < 2 || (*p)[0] != ',' || (*p)[1] != ' ') {
+			g_set_error (error, OS_VERSION_ERROR,
+			             OS_VERSION_ERROR_INVALID_REPORT,
+			             "Expected field separator at "
+			             "offset %" G_GSIZE_FORMAT ".",
+			             (gsize) (*p - report));
+			return FALSE;
+		}
+
+		*p += 2;
+	}
+
+	if (*p < end && **p == '"') {
+		field_end = find_closing_quote (*p + 1, end);
+
+		if (field_end == NULL) {
+			g_set_error (error, OS_VERSION_ERROR,
+			             OS_VERSION_ERROR_INVALID_REPORT,
+			             "Unterminated field at "
+			             "offset %" G_GSIZE_FORMAT ".",
+			             (gsize) (*p - report));
+			return FALSE;
+		}
+
+		*field = *p + 1;
+		*field_length = field_end - *field;
+		*escaped = (memchr (*field, '\\', *field_length) != NULL);
+		*p = field_end + 1;
+	} else {
+		field_end = g_strstr_len (*p, end - *p, ", ");
+
+		if (field_end == NULL) {
+			field_end = end;
+		}
+
+		*field = *p;
+		*field_length = field_end - *p;
+		*escaped = FALSE;
+		*p = field_end;
+	}
+
+	return TRUE;
+}
+
+/**
+ * os_version_parse:
+ * @report: a report string, as returned by get_os_version()
+ * @length: length of @report in bytes, or -1 if it is nul-terminated
+ * @error: return location for a #GError, or %NULL
+ *
+ * Split a report string as returned by get_os_version() back into its fields,
+ * unescaping each of them. This is intended for use on the server side, where
+ * reports are received from clients. Unquoted fields (such as the trailing
+ * ``OS_VERSION``) are returned verbatim.
+ *
+ * If @report is not in the expected format, %OS_VERSION_ERROR_INVALID_REPORT
+ * is returned.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): the unescaped fields, in
+ *    order; free with g_strfreev()
+ *
+ * Since: UNRELEASED
+ */
+gchar **
+os_version_parse (const gchar *report, gssize length, GError **error)
+{
+	GPtrArray/*<owned string>*/ *fields;
+	const gchar *p, *end;
+
+	g_return_val_if_fail (report != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	if (length < 0) {
+		length = strlen (report);
+	}
+
+	p = report;
+	end = report + length;
+	fields = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
+
+	while (p < end) {
+		const gchar *field_bytes;
+		gsize field_length;
+		gboolean escaped;
+		gchar *field;
+
+		if (!os_version_scan_field (report, &p, end, fields->len == 0,
+		                            &field_bytes, &field_length,
+		                            &escaped, error)) {
+			g_ptr_array_unref (fields);
+
+			return NULL;
+		}
+
+		if (escaped) {
+			field = g_malloc (field_length + 1);
+			field_length = os_version_unescape (field_bytes,
+			                                    field_length,
+			                                    field);
+			field[field_length] = '\0';
+		} else {
+			field = g_strndup (field_bytes, field_length);
+		}
+
+		g_ptr_array_add (fields, field);
+	}
+
+	g_ptr_array_add (fields, NULL);
+
+	return (gchar **) g_ptr_array_free (fields, FALSE);
+}
+
+#define FNV_OFFSET_BASIS G_GUINT64_CONSTANT (0xcbf29ce484222325)
+
+static guint64
+fnv1a_update (guint64 hash, const guchar *data, gsize length)
+{
+	gsize i;
+
+	for (i = 0; i < length; i++) {
+		hash ^= data[i];
+		hash *= G_GUINT64_CONSTANT (0x100000001b3);
+	}
+
+	return hash;
+}
+
+/* MurmurHash3 fmix64, so that all bits of the result are well mixed. */
+static guint64
+hash_finalise (guint64 hash)
+{
+	hash ^= hash >> 33;
+	hash *= G_GUINT64_CONSTANT (0xff51afd7ed558ccd);
+	hash ^= hash >> 33;
+	hash *= G_GUINT64_CONSTANT (0xc4ceb9fe1a85ec53);
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+/**
+ * os_version_fingerprint:
+ * @report: a report string, as returned by get_os_version()
+ * @length: length of @report in bytes, or -1 if it is nul-terminated
+ *
+ * Compute a 64-bit fingerprint of @report, suitable for keying aggregations
+ * of reports. Unlike g_str_hash(), the fingerprint is stable across processes,
+ * machines and library versions, so it may be stored or sent over the wire.
+ *
+ * Returns: fingerprint of @report
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_fingerprint (const gchar *report, gssize length)
+{
+	g_return_val_if_fail (report != NULL || length == 0, 0);
+
+	if (length < 0) {
+		length = strlen (report);
+	}
+
+	return hash_finalise (fnv1a_update (FNV_OFFSET_BASIS,
+	                                    (const guchar *) report, length));
+}
+
+/**
+ * os_version_fields_fingerprint:
+ * @fields: (array length=n_fields): report fields, as returned by
+ *    os_version_parse()
+ * @n_fields: number of elements in @fields, or -1 if it is %NULL-terminated
+ *
+ * Compute a 64-bit fingerprint of a tuple of report fields. This is stable in
+ * the same way as os_version_fingerprint(), and is sensitive to the boundaries
+ * between fields, so (‘ab’, ‘c’) and (‘a’, ‘bc’) have different fingerprints.
+ *
+ * Returns: fingerprint of @fields
+ *
+ * Since: UNRELEASED
+ */
+guint64
+os_version_fields_fingerprint (const gchar * const *fields, gssize n_fields)
+{
+	guint64 hash = FNV_OFFSET_BASIS;
+	gsize i;
+
+	g_return_val_if_fail (fields != NULL || n_fields == 0, 0);
+
+	for (i = 0; (n_fields < 0) ? fields[i] != NULL : i < (gsize) n_fields;
+	     i++) {
+		guint32 length = GUINT32_TO_LE (strlen (fields[i]));
+
+		hash = fnv1a_update (hash, (const guchar *) fields[i],
+		                     strlen (fields[i]));
+		hash = fnv1a_update (hash, (const guchar *) &length,
+		                     sizeof (length));
+	}
+
+	return hash_finalise (hash);
+}
+
+/* Markers in collation keys. Bytes in the version string which clash with
+ * them are escaped by prefixing them with %COLLATION_ESCAPE. */
+#define COLLATION_NUMBER 0x01
+#define COLLATION_ESCAPE 0x02
+
+/**
+ * os_version_collation_key:
+ * @version: a version string, such as a kernel release or Android
+ *    ro.build.version.release field
+ * @length: length of @version in bytes, or -1 if it is nul-terminated
+ *
+ * Compute a collation key for @version, such that comparing the keys of two
+ * version strings with strcmp() (or memcmp(), including the nul terminator)
+ * orders them by version, rather than lexicographically. For example,
+ * ‘5.4.0-42-generic’ sorts before ‘5.4.0-100-generic’, and ‘5.9’ before
+ * ‘5.10’. Keys can be computed once per distinct value and then stored,
+ * sorted or compared cheaply.
+ *
+ * Each run of digits is encoded as a marker byte, the number of significant
+ * digits and then the digits, so numbers compare by magnitude and leading zeros
+ * are ignored. Other bytes are copied through. A number sorts before any other
+ * character at the same position, and a version sorts before any longer
+ * version it is a prefix of, so ‘5.4’ < ‘5.4-rc1’ < ‘5.4.1’.
+ *
+ * This order is not the same as that of os_version_compare() and
+ * strverscmp(), in two ways. Leading zeros are ignored here, so ‘1.01’ and
+ * ‘1.1’ have equal keys, whereas os_version_compare() treats ‘01’ as a
+ * fractional part and sorts ‘1.01’ first. And a number sorts before any other
+ * character here, whereas os_version_compare() compares its first digit
+ * bytewise, so it sorts ‘a-’ before ‘a1’. Code which must agree with version
+ * indexes on archives should use keys, not os_version_compare().
+ *
+ * Returns: (transfer full): the collation key for @version
+ *
+ * Since: UNRELEASED
+ */
+gchar *
+os_version_collation_key (const gchar *version, gssize length)
+{
+	GString *key;
+	const gchar *p, *end;
+
+	g_return_val_if_fail (version != NULL || length == 0, NULL);
+
+	if (length < 0) {
+		length = strlen (version);
+	}
+
+	p = version;
+	end = version + length;
+	key = g_string_sized_new (length + length / 2 + 1);
+
+	while (p < end) {
+		if (g_ascii_isdigit (*p)) {
+			const gchar *digits;
+			gsize n_digits;
+
+			while (p < end - 1 && *p == '0' &&
+			       g_ascii_isdigit (*(p + 1))) {
+				p++;
+			}
+
+			for (digits = p; p < end && g_ascii_isdigit (*p); p++);
+			n_digits = p - digits;
+
+			/* Encode the digit count so that longer numbers sort
+			 * later: 1–254 as one byte, longer ones with a prefix
+			 * of 0xff bytes. */
+			g_string_append_c (key, COLLATION_NUMBER);
+
+			for (; n_digits >= 0xff - 1; n_digits -= 0xff - 1) {
+				g_string_append_c (key, (gchar) 0xff);
+			}
+
+			g_string_append_c (key, (gchar) (n_digits + 1));
+			g_string_append_len (key, digits, p - digits);
+		} else {
+			if (*p == COLLATION_NUMBER || *p == COLLATION_ESCAPE) {
+				g_string_append_c (key, COLLATION_ESCAPE);
+			}
+
+			g_string_append_c (key, *p);
+			p++;
+		}
+	}
+
+	return g_string_free (key, FALSE);
+}
+
+/* Index of the first non-zero byte of @word, in memory order. */
+static guint
+first_nonzero_byte (guint64 word)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN && defined(__GNUC__)
+	return __builtin_ctzll (word) / 8;
+#elif G_BYTE_ORDER == G_BIG_ENDIAN && defined(__GNUC__)
+	return __builtin_clzll (word) / 8;
+#else
+	guchar bytes[sizeof (word)];
+	guint i;
+
+	memcpy (bytes, &word, sizeof (word));
+
+	for (i = 0; bytes[i] == 0; i++);
+
+	return i;
+#endif
+}
+
+/* Length of the common prefix of @a and @b, comparing a word at a time. */
+static gsize
+common_prefix_length (const guchar *a, const guchar *b, gsize length)
+{
+	gsize i = 0;
+
+	for (; i + sizeof (guint64) <= length; i += sizeof (guint64)) {
+		guint64 word_a, word_b;
+
+		memcpy (&word_a, a + i, sizeof (word_a));
+		memcpy (&word_b, b + i, sizeof (word_b));
+
+		if (word_a != word_b) {
+			return i + first_nonzero_byte (word_a ^ word_b);
+		}
+	}
+
+	for (; i < length && a[i] == b[i]; i++);
+
+	return i;
+}
+
+/* States and results of the strverscmp() state machine, as in glibc. States
+ * are multiplied by 3 so they can be offset by the class of the current
+ * character: 0 for non-digits, 1 for 1–9 and 2 for 0. */
+#define S_N 0x0  /* normal */
+#define S_I 0x3  /* comparing integral part */
+#define S_F 0x6  /* comparing fractional part */
+#define S_Z 0x9  /* idem, but with leading zeroes only */
+
+#define CMP 2
+#define LEN 3
+
+#define SHORT_PREFIX_LENGTH 16
+
+static const guint8 version_next_state[] = {
+	/* state    x    d    0 */
+	/* S_N */  S_N, S_I, S_Z,
+	/* S_I */  S_N, S_I, S_I,
+	/* S_F */  S_N, S_F, S_F,
+	/* S_Z */  S_N, S_F, S_Z,
+};
+
+static const gint8 version_result_type[] = {
+	/* state   x/x  x/d  x/0  d/x  d/d  d/0  0/x  0/d  0/0 */
+	/* S_N */  CMP, CMP, CMP, CMP, LEN, CMP, CMP, CMP, CMP,
+	/* S_I */  CMP, -1,  -1,  +1,  LEN, LEN, +1,  LEN, LEN,
+	/* S_F */  CMP, CMP, CMP, CMP, CMP, CMP, CMP, CMP, CMP,
+	/* S_Z */  CMP, +1,  +1,  -1,  CMP, CMP, -1,  CMP, CMP,
+};
+
+static inline guint
+version_char_class (guchar c)
+{
+	return (c == '0') + (g_ascii_isdigit (c) != 0);
+}
+
+/**
+ * os_version_compare:
+ * @a: a nul-terminated version string
+ * @b: another nul-terminated version string
+ *
+ * Compare two version strings, such as kernel releases or build identifiers,
+ * with the same result as glibc’s strverscmp(). Runs of digits compare
+ * numerically, except that runs with leading zeroes compare as fractional
+ * parts, so ‘1.9’ < ‘1.10’ and ‘1.09’ < ‘1.1’. Unlike strverscmp(), this is
+ * available on all platforms, and is faster on long strings with long common
+ * prefixes, which are typical when sorting releases.
+ *
+ * The order differs from that of os_version_collation_key(), and hence of
+ * version indexes on archives, for runs of digits with leading zeros and for
+ * digits compared against punctuation; see os_version_collation_key().
+ *
+ * Long common prefixes are skipped a word at a time, and the state machine is
+ * then run only from the start of the run of digits in which the strings
+ * differ. This gives the same result as running it from the start of the
+ * strings, since every non-digit resets it.
+ *
+ * Returns: negative, zero or positive if @a sorts before, the same as, or
+ *    after @b
+ *
+ * Since: UNRELEASED
+ */
+gint
+os_version_compare (const gchar *a, const gchar *b)
+{
+	const guchar *p1, *p2;
+	gsize i;
+	guchar c1, c2;
+	gint state, diff;
+
+	g_return_val_if_fail (a != NULL, 0);
+	g_return_val_if_fail (b != NULL, 0);
+
+	/* Most versions differ early, where strlen() would cost more than it
+	 * saves, so compare the start bytewise. */
+	for (i = 0; i < SHORT_PREFIX_LENGTH && a[i] == b[i]; i++) {
+		if (a[i] == '\0') {
+			return 0;
+		}
+	}
+
+	if (i == SHORT_PREFIX_LENGTH) {
+		gsize length;
+
+		length = i + MIN (strlen (a + i), strlen (b + i));
+
+		/* Include the nul terminator of the shorter string, so the
+		 * first difference is always within both strings. */
+		i += common_prefix_length ((const guchar *) a + i,
+		                           (const guchar *) b + i,
+		                           length - i + 1);
+
+		if (i > length) {
+			return 0;
+		}
+	}
+
+	while (i > 0 && g_ascii_isdigit (a[i - 1])) {
+		i--;
+	}
+
+	p1 = (const guchar *) a + i;
+	p2 = (const guchar *) b + i;
+	c1 = *p1++;
+	c2 = *p2++;
+	state = S_N + version_char_class (c1);
+
+	while ((diff = c1 - c2) == 0) {
+		state = version_next_state[state];
+		c1 = *p1++;
+		c2 = *p2++;
+		state += version_char_class (c1);
+	}
+
+	state = version_result_type[state * 3 + version_char_class (c2)];
+
+	switch (state) {
+	case CMP:
+		return diff;
+	case LEN:
+		/* The longer run of digits is the larger number. */
+		for (; g_ascii_isdigit (*p1); p1++, p2++) {
+			if (!g_ascii_isdigit (*p2)) {
+				return 1;
+			}
+		}
+
+		return g_ascii_isdigit (*p2) ? -1 : diff;
+	default:
+		return state;
+	}
+}
+
+#undef S_N
+#undef S_I
+#undef S_F
+#undef S_Z
+#undef CMP
+#undef LEN
+#undef SHORT_PREFIX_LENGTH
+
 int
 main (void)
 {
@@ -23,13 +23,121 @@
 
 #include <glib.h>
 
+#ifdef G_OS_UNIX
+#include <sys/uio.h>
+#endif
+
 
 #ifndef _OS_VERSION_H_
 #define _OS_VERSION_H_
 
 
+/**
+ * OsVersionError:
+ * @OS_VERSION_ERROR_INVALID_REPORT: A report string was not in the format
+ *    produced by get_os_version().
+ * @OS_VERSION_ERROR_INVALID_DATA: Serialised data was corrupt, truncated or of
+ *    an unsupported version.
+ * @OS_VERSION_ERROR_TABLE_FULL: An #OsVersionInternTable had no room for
+ *    another value.
+ *
+ * Error codes for %OS_VERSION_ERROR.
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_ERROR_INVALID_REPORT,
+	OS_VERSION_ERROR_INVALID_DATA,
+	OS_VERSION_ERROR_TABLE_FULL,
+} OsVersionError;
+
+#define OS_VERSION_ERROR os_version_error_quark ()
+
+GQuark
+os_version_error_quark (void) G_GNUC_CONST;
+
+/**
+ * OsVersionFormatFlags:
+ * @OS_VERSION_FORMAT_FLAGS_NONE: No flags set. Fields are escaped with
+ *    g_strescape(), as by get_os_version().
+ * @OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8: Valid non-ASCII UTF-8 sequences are
+ *    copied through unescaped. Control characters and invalid bytes are still
+ *    escaped.
+ *
+ * Flags affecting os_version_format_full().
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_FORMAT_FLAGS_NONE = 0,
+	OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8 = (1 << 0),
+} OsVersionFormatFlags;
+
+/**
+ * OsVersionReportFlags:
+ * @OS_VERSION_REPORT_FLAGS_NONE: No flags set.
+ * @OS_VERSION_REPORT_FLAGS_KERNEL_CAPS: Append the usable kernel facilities,
+ *    as returned by os_version_get_kernel_caps(), as a hexadecimal bitset.
+ *
+ * Optional fields to add to a report from os_version_get_report().
+ *
+ * Since: UNRELEASED
+ */
+typedef enum {
+	OS_VERSION_REPORT_FLAGS_NONE = 0,
+	OS_VERSION_REPORT_FLAGS_KERNEL_CAPS = (1 << 0),
+} OsVersionReportFlags;
+
 gchar *
 get_os_version (void);
 
+gchar *
+os_version_get_report (OsVersionReportFlags flags);
+
+const gchar * const *
+os_version_get_fields (gsize *n_fields);
+
+const gchar * const *
+os_version_get_field_names (gsize *n_fields);
+
+GVariant *
+os_version_get_variant (void);
+
+#if GLIB_CHECK_VERSION (2, 50, 0)
+const GLogField *
+os_version_get_log_fields (gsize *n_fields);
+#endif
+
+#ifdef G_OS_UNIX
+const struct iovec *
+os_version_get_report_iov (gsize *n_iov);
+#endif
+
+gchar *
+os_version_format (const gchar * const *fields, gssize n_fields);
+
+gchar *
+os_version_format_full (const gchar * const *fields,
+                        gssize n_fields,
+                        OsVersionFormatFlags flags);
+
+gsize
+os_version_unescape (const gchar *source, gsize length, gchar *dest);
+
+gchar **
+os_version_parse (const gchar *report, gssize length, GError **error);
+
+guint64
+os_version_fingerprint (const gchar *report, gssize length);
+
+guint64
+os_version_fields_fingerprint (const gchar * const *fields, gssize n_fields);
+
+gchar *
+os_version_collation_key (const gchar *version, gssize length);
+
+gint
+os_version_compare (const gchar *a, const gchar *b);
+
 
 #endif /* _OS_VERSION_H_ */
@@ -0,0 +1,163 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Size of an archive against the newline-delimited log it was converted from,
+ * and the time to answer a query by scanning the archive against reparsing
+ * the log, over a synthetic fleet corpus.
+ *
+ * Usage: benchmark-archive [N_REPORTS] */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "osversion.h"
+#include "osversion-archive.h"
+#include "corpus.h"
+
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned string>*/ *reports;
+	GString *log;
+	gchar *tmp_dir, *log_path, *archive_path;
+	OsVersionArchive *archive;
+	OsVersionArchiveQuery *query;
+	GMappedFile *mapped_file;
+	GStatBuf archive_stat;
+	GError *error = NULL;
+	const gchar *p, *end;
+	guint i, n_reports = 1000000;
+	guint64 count, expected_count;
+	guint64 *counts;
+	guint32 n_groups;
+	gint64 start_time;
+	gdouble seconds;
+
+	if (argc > 1) {
+		n_reports = strtoul (argv[1], NULL, 10);
+	}
+
+	tmp_dir = g_dir_make_tmp ("osversion-benchmark-XXXXXX", &error);
+	g_assert_no_error (error);
+	log_path = g_build_filename (tmp_dir, "log", NULL);
+	archive_path = g_build_filename (tmp_dir, "archive", NULL);
+
+	reports = corpus_new_reports (n_reports, 1);
+	log = g_string_new ("");
+
+	for (i = 0; i < reports->len; i++) {
+		g_string_append (log, reports->pdata[i]);
+		g_string_append_c (log, '\n');
+	}
+
+	g_file_set_contents (log_path, log->str, log->len, &error);
+	g_assert_no_error (error);
+
+	/* Conversion and size. */
+	start_time = g_get_monotonic_time ();
+	os_version_archive_convert (log_path, archive_path, NULL, &error);
+	g_assert_no_error (error);
+	seconds = corpus_get_seconds (start_time);
+
+	g_stat (archive_path, &archive_stat);
+	g_print ("%u reports\n", reports->len);
+	g_print ("log:     %10" G_GSIZE_FORMAT " bytes, %.1f bytes/report\n",
+	         log->len, (gdouble) log->len / reports->len);
+	g_print ("archive: %10" G_GUINT64_FORMAT " bytes, %.1f bytes/report "
+	         "(%.1f times smaller)\n",
+	         (guint64) archive_stat.st_size,
+	         (gdouble) archive_stat.st_size / reports->len,
+	         (gdouble) log->len / archive_stat.st_size);
+	g_print ("convert: %.2f s, %.0f reports/s\n",
+	         seconds, reports->len / seconds);
+
+	/* Count Android 13 devices by reparsing the log. Field 17 is
+	 * ro.build.version.release on Android. */
+	start_time = g_get_monotonic_time ();
+	mapped_file = g_mapped_file_new (log_path, FALSE, &error);
+	g_assert_no_error (error);
+	p = g_mapped_file_get_contents (mapped_file);
+	end = p + g_mapped_file_get_length (mapped_file);
+	expected_count = 0;
+
+	while (p < end) {
+		const gchar *line_end = memchr (p, '\n', end - p);
+		gchar **fields;
+
+		fields = os_version_parse (p, line_end - p, NULL);
+
+		if (fields != NULL && g_strv_length (fields) > 17 &&
+		    g_str_equal (fields[0], "Android") &&
+		    g_str_equal (fields[17], "13")) {
+			expected_count++;
+		}
+
+		g_strfreev (fields);
+		p = line_end + 1;
+	}
+
+	g_mapped_file_unref (mapped_file);
+	seconds = corpus_get_seconds (start_time);
+	g_print ("query by parsing the log:    %8.1f ms\n", seconds * 1e3);
+
+	/* The same count from the archive. */
+	start_time = g_get_monotonic_time ();
+	archive = os_version_archive_new (archive_path, &error);
+	g_assert_no_error (error);
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_equals (query, 0, "Android");
+	os_version_archive_query_add_equals (query, 17, "13");
+	count = os_version_archive_query_count (query);
+	seconds = corpus_get_seconds (start_time);
+
+	g_assert_cmpuint (count, ==, expected_count);
+	g_print ("query by scanning the archive: %6.1f ms, %.0f M records/s\n",
+	         seconds * 1e3, reports->len / seconds / 1e6);
+
+	/* Group by kernel release. */
+	start_time = g_get_monotonic_time ();
+	counts = os_version_archive_query_group_by (query, 3, &n_groups);
+	seconds = corpus_get_seconds (start_time);
+	g_print ("group by release:              %6.1f ms, %u groups\n",
+	         seconds * 1e3, n_groups);
+	g_free (counts);
+
+	os_version_archive_query_free (query);
+	os_version_archive_free (archive);
+
+	g_unlink (archive_path);
+	g_unlink (log_path);
+	g_rmdir (tmp_dir);
+
+	g_free (archive_path);
+	g_free (log_path);
+	g_free (tmp_dir);
+	g_string_free (log, TRUE);
+	g_ptr_array_unref (reports);
+
+	return 0;
+}
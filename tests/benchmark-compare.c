@@ -0,0 +1,137 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Time to sort version strings with qsort() using os_version_compare(),
+ * against glibc’s strverscmp() and plain strcmp(), over the release field of
+ * reports from a synthetic fleet corpus.
+ *
+ * Usage: benchmark-compare [N_STRINGS] */
+
+/* For strverscmp(). */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "corpus.h"
+
+
+static gint
+compare_os_version (gconstpointer a, gconstpointer b)
+{
+	return os_version_compare (*(const gchar * const *) a,
+	                           *(const gchar * const *) b);
+}
+
+#ifdef __GLIBC__
+static gint
+compare_strverscmp (gconstpointer a, gconstpointer b)
+{
+	return strverscmp (*(const gchar * const *) a,
+	                   *(const gchar * const *) b);
+}
+#endif
+
+static gint
+compare_strcmp (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar * const *) a,
+	               *(const gchar * const *) b);
+}
+
+/* Sort a copy of @strings with @compare, print the time taken, and return the
+ * sorted copy. */
+static const gchar **
+time_sort (const gchar *name,
+           GPtrArray/*<unowned string>*/ *strings,
+           GCompareFunc compare)
+{
+	const gchar **sorted;
+	gint64 start_time;
+
+	sorted = g_new (const gchar *, strings->len);
+	memcpy (sorted, strings->pdata, strings->len * sizeof (gchar *));
+	start_time = g_get_monotonic_time ();
+	qsort (sorted, strings->len, sizeof (gchar *), compare);
+	g_print ("%-27s %8.1f ms\n", name,
+	         corpus_get_seconds (start_time) * 1e3);
+
+	return sorted;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned GStrv>*/ *reports;
+	GPtrArray/*<unowned string>*/ *strings;
+	const gchar **sorted;
+	guint i, n_strings = 1000000;
+
+	if (argc > 1) {
+		n_strings = strtoul (argv[1], NULL, 10);
+	}
+
+	/* Android reports carry the kernel release in field 3; the others
+	 * carry their OS or kernel release in field 2. */
+	reports = corpus_new_fields (n_strings, 1);
+	strings = g_ptr_array_sized_new (n_strings);
+
+	for (i = 0; i < reports->len; i++) {
+		gchar **fields = reports->pdata[i];
+
+		g_ptr_array_add (strings,
+		                 fields[g_str_equal (fields[0], "Android") ? 3 : 2]);
+	}
+
+	g_print ("%u strings\n", strings->len);
+
+	g_free (time_sort ("qsort(strcmp):", strings, compare_strcmp));
+	sorted = time_sort ("qsort(os_version_compare):", strings,
+	                    compare_os_version);
+
+#ifdef __GLIBC__
+	{
+		const gchar **expected;
+
+		expected = time_sort ("qsort(strverscmp):", strings,
+		                      compare_strverscmp);
+
+		/* Only identical strings compare equal, so the orders must
+		 * match exactly. */
+		for (i = 0; i < strings->len; i++) {
+			g_assert_cmpstr (sorted[i], ==, expected[i]);
+		}
+
+		g_free (expected);
+	}
+#endif
+
+	g_free (sorted);
+	g_ptr_array_unref (strings);
+	g_ptr_array_unref (reports);
+
+	return 0;
+}
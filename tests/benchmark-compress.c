@@ -0,0 +1,116 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Compressed size and throughput of os_version_compress() and
+ * os_version_decompress() on single reports from a synthetic fleet corpus.
+ *
+ * Usage: benchmark-compress [N_REPORTS] */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion-codec.h"
+#include "corpus.h"
+
+
+#define N_ROUNDS 5
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned string>*/ *reports;
+	GPtrArray/*<owned GBytes>*/ *compressed;
+	guint i, round, n_reports = 100000;
+	gsize report_bytes = 0, compressed_bytes = 0;
+	gint64 start_time;
+	gdouble seconds;
+
+	if (argc > 1) {
+		n_reports = strtoul (argv[1], NULL, 10);
+	}
+
+	reports = corpus_new_reports (n_reports, 1);
+	compressed = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+
+	for (i = 0; i < reports->len; i++) {
+		report_bytes += strlen (reports->pdata[i]);
+	}
+
+	/* Compression. */
+	start_time = g_get_monotonic_time ();
+
+	for (round = 0; round < N_ROUNDS; round++) {
+		for (i = 0; i < reports->len; i++) {
+			GBytes *bytes = os_version_compress (reports->pdata[i],
+			                                     -1);
+
+			if (round == 0) {
+				compressed_bytes += g_bytes_get_size (bytes);
+				g_ptr_array_add (compressed, bytes);
+			} else {
+				g_bytes_unref (bytes);
+			}
+		}
+	}
+
+	seconds = corpus_get_seconds (start_time);
+
+	g_print ("%u reports, %.1f bytes/report\n", reports->len,
+	         (gdouble) report_bytes / reports->len);
+	g_print ("Compressed:     %.1f bytes/report, ratio %.2f\n",
+	         (gdouble) compressed_bytes / reports->len,
+	         (gdouble) report_bytes / compressed_bytes);
+	g_print ("Compression:    %8.1f MB/s\n",
+	         N_ROUNDS * report_bytes / seconds / 1e6);
+
+	/* Decompression, checking the result. */
+	for (i = 0; i < compressed->len; i++) {
+		GError *error = NULL;
+		gchar *report;
+
+		report = os_version_decompress (compressed->pdata[i], &error);
+		g_assert_no_error (error);
+		g_assert_cmpstr (report, ==, reports->pdata[i]);
+		g_free (report);
+	}
+
+	start_time = g_get_monotonic_time ();
+
+	for (round = 0; round < N_ROUNDS; round++) {
+		for (i = 0; i < compressed->len; i++) {
+			g_free (os_version_decompress (compressed->pdata[i],
+			                               NULL));
+		}
+	}
+
+	seconds = corpus_get_seconds (start_time);
+	g_print ("Decompression:  %8.1f MB/s\n",
+	         N_ROUNDS * report_bytes / seconds / 1e6);
+
+	g_ptr_array_unref (compressed);
+	g_ptr_array_unref (reports);
+
+	return 0;
+}
@@ -0,0 +1,297 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Bytes on the wire for reports sent as deltas against a server-known
+ * baseline, compared with sending the full get_os_version() strings, over a
+ * synthetic fleet corpus. Two kinds of baseline are measured:
+ *
+ *  • Fleet baselines, built from a separate training corpus as a server would
+ *    build them from earlier reports: one per OS and field count, taking the
+ *    most common value of each field.
+ *  • Each device’s own previous report, where a fraction of the devices have
+ *    since updated their kernel.
+ *
+ * Usage: benchmark-delta [N_REPORTS] */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-codec.h"
+#include "corpus.h"
+
+
+#define N_TRAINING_REPORTS 10000
+
+/* Percentage of devices whose kernel changed since their previous report. */
+#define UPDATE_PERCENTAGE 20
+
+/* Key identifying the baseline for @fields. */
+static gchar *
+get_baseline_key (const gchar * const *fields)
+{
+	return g_strdup_printf ("%s/%u", fields[0],
+	                        g_strv_length ((gchar **) fields));
+}
+
+/* Build a baseline for each key from @training, taking the most common value
+ * of each field. */
+static GHashTable/*<owned string, owned GStrv>*/ *
+new_baselines (GPtrArray/*<owned GStrv>*/ *training)
+{
+	GHashTable/*<owned string, owned GPtrArray<owned GHashTable<unowned string, count>>>*/ *counts;
+	GHashTable/*<owned string, owned GStrv>*/ *baselines;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint i, j;
+
+	counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                (GDestroyNotify) g_ptr_array_unref);
+
+	for (i = 0; i < training->len; i++) {
+		gchar **fields = training->pdata[i];
+		gchar *baseline_key = get_baseline_key ((const gchar * const *) fields);
+		GPtrArray *field_counts;
+
+		field_counts = g_hash_table_lookup (counts, baseline_key);
+
+		if (field_counts == NULL) {
+			field_counts = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+
+			for (j = 0; fields[j] != NULL; j++) {
+				g_ptr_array_add (field_counts,
+				                 g_hash_table_new (g_str_hash,
+				                                   g_str_equal));
+			}
+
+			g_hash_table_insert (counts, baseline_key,
+			                     field_counts);
+		} else {
+			g_free (baseline_key);
+		}
+
+		for (j = 0; fields[j] != NULL; j++) {
+			GHashTable *values = field_counts->pdata[j];
+			guint count;
+
+			count = GPOINTER_TO_UINT (g_hash_table_lookup (values,
+			                                               fields[j]));
+			g_hash_table_insert (values, fields[j],
+			                     GUINT_TO_POINTER (count + 1));
+		}
+	}
+
+	baselines = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                   (GDestroyNotify) g_strfreev);
+	g_hash_table_iter_init (&iter, counts);
+
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GPtrArray *field_counts = value;
+		gchar **baseline = g_new0 (gchar *, field_counts->len + 1);
+
+		for (j = 0; j < field_counts->len; j++) {
+			GHashTableIter value_iter;
+			gpointer field, count;
+			guint best_count = 0;
+
+			g_hash_table_iter_init (&value_iter,
+			                        field_counts->pdata[j]);
+
+			while (g_hash_table_iter_next (&value_iter, &field,
+			                               &count)) {
+				if (GPOINTER_TO_UINT (count) > best_count) {
+					best_count = GPOINTER_TO_UINT (count);
+					g_free (baseline[j]);
+					baseline[j] = g_strdup (field);
+				}
+			}
+		}
+
+		g_hash_table_insert (baselines, g_strdup (key), baseline);
+	}
+
+	g_hash_table_unref (counts);
+
+	return baselines;
+}
+
+/* Encode each report in @corpus against the corresponding baseline in
+ * @baseline_for_report, or against an empty baseline if that is %NULL, and
+ * print the sizes and timings. */
+static void
+measure (const gchar *name,
+         GPtrArray/*<owned GStrv>*/ *corpus,
+         GPtrArray/*<unowned GStrv>*/ *baseline_for_report)
+{
+	GPtrArray/*<owned GBytes>*/ *deltas;
+	gsize full_bytes = 0, delta_bytes = 0;
+	gdouble encode_seconds, decode_seconds;
+	gint64 start_time;
+	guint i;
+
+	for (i = 0; i < corpus->len; i++) {
+		gchar *report = corpus_format_report (corpus->pdata[i]);
+
+		full_bytes += strlen (report);
+		g_free (report);
+	}
+
+	deltas = g_ptr_array_new_with_free_func ((GDestroyNotify) g_bytes_unref);
+	start_time = g_get_monotonic_time ();
+
+	for (i = 0; i < corpus->len; i++) {
+		const gchar * const *baseline = baseline_for_report->pdata[i];
+		GBytes *delta;
+
+		delta = os_version_delta_encode (0, baseline,
+		                                 (baseline != NULL) ? -1 : 0,
+		                                 corpus->pdata[i], -1);
+		delta_bytes += g_bytes_get_size (delta);
+		g_ptr_array_add (deltas, delta);
+	}
+
+	encode_seconds = corpus_get_seconds (start_time);
+
+	/* Decoding, checking the result. */
+	start_time = g_get_monotonic_time ();
+
+	for (i = 0; i < deltas->len; i++) {
+		const gchar * const *baseline = baseline_for_report->pdata[i];
+		GError *error = NULL;
+		gchar **fields;
+
+		fields = os_version_delta_decode (deltas->pdata[i], baseline,
+		                                  (baseline != NULL) ? -1 : 0,
+		                                  &error);
+		g_assert_no_error (error);
+		g_assert_true (g_strv_equal ((const gchar * const *) fields,
+		                             corpus->pdata[i]));
+		g_strfreev (fields);
+	}
+
+	decode_seconds = corpus_get_seconds (start_time);
+
+	g_print ("%s:\n", name);
+	g_print ("  Full reports: %10" G_GSIZE_FORMAT " bytes, "
+	         "%6.1f bytes/report\n",
+	         full_bytes, (gdouble) full_bytes / corpus->len);
+	g_print ("  Deltas:       %10" G_GSIZE_FORMAT " bytes, "
+	         "%6.1f bytes/report, %.1f%% saved\n",
+	         delta_bytes, (gdouble) delta_bytes / corpus->len,
+	         100.0 * (1.0 - (gdouble) delta_bytes / full_bytes));
+	g_print ("  Encoding %.0f ns/report, decoding %.0f ns/report\n",
+	         encode_seconds * 1e9 / corpus->len,
+	         decode_seconds * 1e9 / deltas->len);
+
+	g_ptr_array_unref (deltas);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned GStrv>*/ *training, *corpus;
+	GPtrArray/*<owned GStrv>*/ *updated;
+	GPtrArray/*<unowned GStrv>*/ *baseline_for_report;
+	GHashTable/*<owned string, owned GStrv>*/ *baselines;
+	GRand *rand;
+	guint i, n_reports = 100000, n_without_baseline = 0;
+
+	if (argc > 1) {
+		n_reports = strtoul (argv[1], NULL, 10);
+	}
+
+	training = corpus_new_fields (N_TRAINING_REPORTS, 2);
+	baselines = new_baselines (training);
+	corpus = corpus_new_fields (n_reports, 1);
+
+	/* Look the baselines up first, so the timings below cover only the
+	 * encoding. Reports without a baseline are sent against an empty
+	 * one. */
+	baseline_for_report = g_ptr_array_sized_new (corpus->len);
+
+	for (i = 0; i < corpus->len; i++) {
+		gchar *baseline_key = get_baseline_key (corpus->pdata[i]);
+		gchar **baseline = g_hash_table_lookup (baselines,
+		                                        baseline_key);
+
+		if (baseline == NULL) {
+			n_without_baseline++;
+		}
+
+		g_ptr_array_add (baseline_for_report, baseline);
+		g_free (baseline_key);
+	}
+
+	g_print ("%u reports, %u fleet baselines, "
+	         "%u reports without a fleet baseline\n",
+	         corpus->len, g_hash_table_size (baselines),
+	         n_without_baseline);
+	measure ("Fleet baselines", corpus, baseline_for_report);
+
+	/* Each device’s previous report, taking the kernel of another device
+	 * with the same OS for those which have updated. */
+	rand = g_rand_new_with_seed (3);
+	updated = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+	g_ptr_array_set_size (baseline_for_report, 0);
+
+	for (i = 0; i < corpus->len; i++) {
+		gchar **previous = corpus->pdata[i];
+		gchar **fields = g_strdupv (previous);
+
+		if (g_rand_int_range (rand, 0, 100) < UPDATE_PERCENTAGE) {
+			gchar **other;
+
+			/* Index of the kernel release, which is followed
+			 * by the kernel version. */
+			guint release = (strcmp (fields[0], "Android") == 0) ?
+			                3 : 2;
+
+			other = corpus->pdata[g_rand_int_range (rand, 0,
+			                                         corpus->len)];
+
+			if (g_strv_length (other) == g_strv_length (fields) &&
+			    strcmp (other[0], fields[0]) == 0) {
+				g_free (fields[release]);
+				g_free (fields[release + 1]);
+				fields[release] = g_strdup (other[release]);
+				fields[release + 1] = g_strdup (other[release + 1]);
+			}
+		}
+
+		g_ptr_array_add (updated, fields);
+		g_ptr_array_add (baseline_for_report, previous);
+	}
+
+	measure ("Previous reports", updated, baseline_for_report);
+
+	g_rand_free (rand);
+	g_ptr_array_unref (updated);
+	g_ptr_array_unref (baseline_for_report);
+	g_ptr_array_unref (corpus);
+	g_hash_table_unref (baselines);
+	g_ptr_array_unref (training);
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Memory needed to store parsed reports as identifier tuples from
+ * os_version_parse_interned() rather than as string vectors from
+ * os_version_parse(), and the throughput of each, over a synthetic fleet
+ * corpus.
+ *
+ * Sizes count the bytes requested from the allocator, not its overheads. The
+ * interning table is estimated from its contents: an entry header, the value
+ * and its nul, and up to four slot and index pointers per value.
+ *
+ * Usage: benchmark-intern [N_REPORTS] */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-intern.h"
+#include "corpus.h"
+
+
+#define ENTRY_HEADER_SIZE 16
+#define POINTERS_PER_ENTRY 4
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned string>*/ *reports;
+	GPtrArray/*<owned GStrv>*/ *parsed;
+	GPtrArray/*<owned guint32 array>*/ *tuples;
+	OsVersionInternTable *table;
+	GHashTable/*<guint32>*/ *seen;
+	guint i, j, n_reports = 100000;
+	gsize report_bytes = 0, n_fields_total = 0;
+	gsize strv_bytes = 0, tuple_bytes = 0, table_bytes = 0;
+	gint64 start_time;
+	gdouble seconds;
+
+	if (argc > 1) {
+		n_reports = strtoul (argv[1], NULL, 10);
+	}
+
+	reports = corpus_new_reports (n_reports, 1);
+
+	for (i = 0; i < reports->len; i++) {
+		report_bytes += strlen (reports->pdata[i]);
+	}
+
+	/* String vectors. */
+	parsed = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+	start_time = g_get_monotonic_time ();
+
+	for (i = 0; i < reports->len; i++) {
+		g_ptr_array_add (parsed, os_version_parse (reports->pdata[i],
+		                                           -1, NULL));
+	}
+
+	seconds = corpus_get_seconds (start_time);
+
+	for (i = 0; i < parsed->len; i++) {
+		gchar **fields = parsed->pdata[i];
+
+		for (j = 0; fields[j] != NULL; j++) {
+			strv_bytes += strlen (fields[j]) + 1;
+		}
+
+		strv_bytes += (j + 1) * sizeof (gchar *);
+		n_fields_total += j;
+	}
+
+	g_print ("%u reports, %" G_GSIZE_FORMAT " fields\n", reports->len,
+	         n_fields_total);
+	g_print ("os_version_parse():          %8.1f MB/s, %6.2f MB\n",
+	         report_bytes / seconds / 1e6, strv_bytes / 1e6);
+
+	/* Identifier tuples. */
+	table = os_version_intern_table_new ();
+	tuples = g_ptr_array_new_with_free_func (g_free);
+	start_time = g_get_monotonic_time ();
+
+	for (i = 0; i < reports->len; i++) {
+		gsize n_fields;
+
+		g_ptr_array_add (tuples,
+		                 os_version_parse_interned (table,
+		                                            reports->pdata[i],
+		                                            -1, &n_fields,
+		                                            NULL));
+		tuple_bytes += n_fields * sizeof (guint32);
+	}
+
+	seconds = corpus_get_seconds (start_time);
+
+	/* Check the tuples against the string vectors, and size the table
+	 * from the distinct values. */
+	seen = g_hash_table_new (NULL, NULL);
+
+	for (i = 0; i < tuples->len; i++) {
+		gchar **fields = parsed->pdata[i];
+		guint32 *ids = tuples->pdata[i];
+
+		for (j = 0; fields[j] != NULL; j++) {
+			const gchar *value;
+			gsize length;
+
+			value = os_version_intern_table_get_value (table, ids[j],
+			                                           &length);
+			g_assert_cmpstr (value, ==, fields[j]);
+
+			if (g_hash_table_add (seen, GUINT_TO_POINTER (ids[j]))) {
+				table_bytes += ENTRY_HEADER_SIZE + length + 1 +
+				               POINTERS_PER_ENTRY *
+				               sizeof (gpointer);
+			}
+		}
+	}
+
+	g_hash_table_unref (seen);
+
+	g_print ("os_version_parse_interned(): %8.1f MB/s, %6.2f MB "
+	         "+ %.2f MB table for %u distinct values\n",
+	         report_bytes / seconds / 1e6, tuple_bytes / 1e6,
+	         table_bytes / 1e6, os_version_intern_table_get_size (table));
+
+	g_ptr_array_unref (tuples);
+	os_version_intern_table_free (table);
+	g_ptr_array_unref (parsed);
+	g_ptr_array_unref (reports);
+
+	return 0;
+}
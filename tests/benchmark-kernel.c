@@ -0,0 +1,201 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+
+/* Time to tokenize kernel release and version strings, and version strings
+ * with an #OsVersionKernelCache: over those in a synthetic fleet corpus, and
+ * over a small set of them repeated, which stays in the processor caches.
+ *
+ * Usage: benchmark-kernel [N_REPORTS] */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion-kernel.h"
+#include "corpus.h"
+
+
+/* Number of calls per measurement. */
+#define N_CALLS 5000000
+
+/* Number of distinct strings in the small set. */
+#define N_HOT 16
+
+typedef enum {
+	KIND_RELEASE,
+	KIND_VERSION,
+} Kind;
+
+/* Tokenize @strings in turn until N_CALLS calls have been made, and return the
+ * time per call in nanoseconds. */
+static gdouble
+time_tokenize (GPtrArray/*<unowned string>*/ *strings,
+               Kind kind,
+               OsVersionKernelCache *cache)
+{
+	OsVersionKernelRelease release;
+	OsVersionKernelVersion version;
+	gint64 start_time;
+	guint i, j;
+
+	start_time = g_get_monotonic_time ();
+
+	for (i = 0, j = 0; i < N_CALLS; i++, j = (j + 1) % strings->len) {
+		const gchar *string = strings->pdata[j];
+
+		if (kind == KIND_RELEASE) {
+			os_version_kernel_release_tokenize (string, -1,
+			                                    &release);
+		} else if (cache != NULL) {
+			os_version_kernel_cache_tokenize_version (cache, string,
+			                                          &version);
+		} else {
+			os_version_kernel_version_tokenize (string, -1,
+			                                    &version);
+		}
+	}
+
+	return corpus_get_seconds (start_time) * 1e9 / N_CALLS;
+}
+
+static void
+print_times (const gchar *name,
+             GPtrArray/*<unowned string>*/ *releases,
+             GPtrArray/*<unowned string>*/ *versions,
+             guint cache_size)
+{
+	OsVersionKernelCache *cache;
+
+	/* The cache has a few slots for every distinct string, so most fit, as
+	 * they would on a server which has been running for a while. */
+	cache = os_version_kernel_cache_new (4 * cache_size);
+
+	g_print ("%s:\n", name);
+	g_print ("  release:        %6.1f ns/call\n",
+	         time_tokenize (releases, KIND_RELEASE, NULL));
+	g_print ("  version:        %6.1f ns/call\n",
+	         time_tokenize (versions, KIND_VERSION, NULL));
+	g_print ("  cached version: %6.1f ns/call\n",
+	         time_tokenize (versions, KIND_VERSION, cache));
+
+	os_version_kernel_cache_free (cache);
+}
+
+/* The cache must give the same tokens as tokenizing afresh. */
+static void
+check_cache (GPtrArray/*<unowned string>*/ *versions)
+{
+	OsVersionKernelCache *cache;
+	guint i;
+
+	cache = os_version_kernel_cache_new (N_HOT);
+
+	for (i = 0; i < versions->len; i++) {
+		OsVersionKernelVersion version, version_expected;
+
+		os_version_kernel_version_tokenize (versions->pdata[i], -1,
+		                                    &version_expected);
+		os_version_kernel_cache_tokenize_version (cache,
+		                                          versions->pdata[i],
+		                                          &version);
+		g_assert (memcmp (&version, &version_expected,
+		                  sizeof (version)) == 0);
+	}
+
+	os_version_kernel_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned GStrv>*/ *reports;
+	GPtrArray/*<unowned string>*/ *releases, *versions;
+	GPtrArray/*<unowned string>*/ *hot_releases, *hot_versions;
+	GHashTable/*<unowned string, unowned string>*/ *distinct_releases,
+	                                                *distinct_versions;
+	guint i, n_reports = 1000000;
+	guint n_distinct_releases, n_distinct_versions;
+
+	if (argc > 1) {
+		n_reports = strtoul (argv[1], NULL, 10);
+	}
+
+	reports = corpus_new_fields (n_reports, 1);
+	releases = g_ptr_array_new ();
+	versions = g_ptr_array_new ();
+	hot_releases = g_ptr_array_new ();
+	hot_versions = g_ptr_array_new ();
+	distinct_releases = g_hash_table_new (g_str_hash, g_str_equal);
+	distinct_versions = g_hash_table_new (g_str_hash, g_str_equal);
+
+	/* Linux reports carry the kernel release and version in fields 2 and
+	 * 3; Android reports in fields 3 and 4. */
+	for (i = 0; i < reports->len; i++) {
+		gchar **fields = reports->pdata[i];
+		guint offset;
+
+		if (g_str_equal (fields[0], "Linux")) {
+			offset = 2;
+		} else if (g_str_equal (fields[0], "Android")) {
+			offset = 3;
+		} else {
+			continue;
+		}
+
+		g_ptr_array_add (releases, fields[offset]);
+		g_ptr_array_add (versions, fields[offset + 1]);
+
+		if (hot_releases->len < N_HOT &&
+		    !g_hash_table_contains (distinct_releases,
+		                            fields[offset])) {
+			g_ptr_array_add (hot_releases, fields[offset]);
+			g_ptr_array_add (hot_versions, fields[offset + 1]);
+		}
+
+		g_hash_table_add (distinct_releases, fields[offset]);
+		g_hash_table_add (distinct_versions, fields[offset + 1]);
+	}
+
+	n_distinct_releases = g_hash_table_size (distinct_releases);
+	n_distinct_versions = g_hash_table_size (distinct_versions);
+	g_print ("%u kernels, %u distinct releases, %u distinct versions\n",
+	         releases->len, n_distinct_releases, n_distinct_versions);
+
+	check_cache (versions);
+	print_times ("Fleet corpus", releases, versions,
+	             n_distinct_versions);
+	print_times ("Set of " G_STRINGIFY (N_HOT) " repeated", hot_releases,
+	             hot_versions, N_HOT);
+
+	g_hash_table_unref (distinct_versions);
+	g_hash_table_unref (distinct_releases);
+	g_ptr_array_unref (hot_versions);
+	g_ptr_array_unref (hot_releases);
+	g_ptr_array_unref (versions);
+	g_ptr_array_unref (releases);
+	g_ptr_array_unref (reports);
+
+	return 0;
+}
@@ -0,0 +1,384 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+
+/* Time the parser and formatter on inputs which could trigger worse than
+ * linear behaviour: the fuzzing seed corpus, and generated inputs of
+ * increasing size made of long runs of escapes, quotes or fields. Fails if the
+ * time per byte for any generated input grows by more than MAX_SLOWDOWN times
+ * between the smallest and largest size.
+ *
+ * Usage: benchmark-pathological [CORPUS_DIR]
+ * where CORPUS_DIR defaults to fuzz/corpus. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "corpus.h"
+
+
+/* Sizes of the generated inputs, from 16 KiB to 1 MiB. */
+static const gsize sizes[] = { 1 << 14, 1 << 16, 1 << 18, 1 << 20 };
+
+/* A linear-time input might get a few times slower per byte as it outgrows
+ * the caches, but a quadratic one gets 64 times slower over this range of
+ * sizes. */
+#define MAX_SLOWDOWN 8.0
+
+/* Minimum time to spend on each measurement, in seconds. */
+#define MIN_SECONDS 0.01
+
+typedef enum {
+	INPUT_REPORT,  /* passed to os_version_parse() */
+	INPUT_FIELDS,  /* passed to os_version_format_full() */
+	INPUT_VERSIONS,  /* a pair passed to os_version_compare() */
+} InputType;
+
+typedef struct {
+	InputType type;
+	OsVersionFormatFlags flags;
+	gchar **strv;  /* owned; for INPUT_FIELDS and INPUT_VERSIONS */
+	gchar *report;  /* owned; for INPUT_REPORT */
+	gsize length;  /* in bytes */
+} Input;
+
+static void
+input_clear (Input *input)
+{
+	g_strfreev (input->strv);
+	g_free (input->report);
+}
+
+static void
+input_run (const Input *input)
+{
+	gchar **fields;
+	gchar *report;
+
+	switch (input->type) {
+	case INPUT_REPORT:
+		fields = os_version_parse (input->report, input->length, NULL);
+		g_strfreev (fields);
+		break;
+	case INPUT_FIELDS:
+		report = os_version_format_full ((const gchar * const *) input->strv,
+		                                 -1, input->flags);
+		g_free (report);
+		break;
+	case INPUT_VERSIONS:
+		os_version_compare (input->strv[0], input->strv[1]);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/* Time per byte of input, in nanoseconds: the best of three measurements, each
+ * repeating @input until at least MIN_SECONDS have passed. */
+static gdouble
+input_time (const Input *input)
+{
+	gdouble best = G_MAXDOUBLE;
+	guint i;
+
+	for (i = 0; i < 3; i++) {
+		guint n_runs, j;
+		gint64 start_time;
+		gdouble seconds;
+
+		for (n_runs = 1; ; n_runs *= 2) {
+			start_time = g_get_monotonic_time ();
+
+			for (j = 0; j < n_runs; j++) {
+				input_run (input);
+			}
+
+			seconds = corpus_get_seconds (start_time);
+
+			if (seconds >= MIN_SECONDS) {
+				break;
+			}
+		}
+
+		best = MIN (best, seconds * 1e9 / n_runs / MAX (input->length, 1));
+	}
+
+	return best;
+}
+
+static gchar *
+new_repeated_string (const gchar *prefix,
+                     const gchar *unit,
+                     const gchar *suffix,
+                     gsize size)
+{
+	GString *string;
+
+	string = g_string_sized_new (size + 8);
+	g_string_append (string, prefix);
+
+	while (string->len < size) {
+		g_string_append (string, unit);
+	}
+
+	g_string_append (string, suffix);
+
+	return g_string_free (string, FALSE);
+}
+
+/* Generated inputs repeat @unit until they are the required size. Reports
+ * start with @prefix and end with @suffix. Fields are a single field, or if
+ * @unit is %NULL, a list of empty fields. Versions are a pair differing only
+ * in their last character. */
+typedef struct {
+	const gchar *name;
+	InputType type;
+	OsVersionFormatFlags flags;
+	const gchar *prefix;
+	const gchar *unit;
+	const gchar *suffix;
+} Generator;
+
+static const Generator generators[] = {
+	{ "parse backslashes", INPUT_REPORT, 0, "\"", "\\\\", "\"" },
+	{ "parse escaped quotes", INPUT_REPORT, 0, "\"", "\\\"", "\"" },
+	{ "parse octal escapes", INPUT_REPORT, 0, "\"", "\\101\\377", "\"" },
+	{ "parse plain bytes", INPUT_REPORT, 0, "\"", "a", "\"" },
+	{ "parse unterminated", INPUT_REPORT, 0, "\"", "\\\\", "" },
+	{ "parse empty fields", INPUT_REPORT, 0, "\"\"", ", \"\"", "" },
+	{ "format backslashes", INPUT_FIELDS, 0, NULL, "\\", NULL },
+	{ "format control bytes", INPUT_FIELDS, 0, NULL, "\001\t\177", NULL },
+	{ "format UTF-8", INPUT_FIELDS, OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8,
+	  NULL, "\303\251", NULL },
+	{ "format invalid UTF-8", INPUT_FIELDS,
+	  OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8, NULL, "\303", NULL },
+	{ "format empty fields", INPUT_FIELDS, 0, NULL, NULL, NULL },
+	{ "compare dotted versions", INPUT_VERSIONS, 0, NULL, "1.", NULL },
+	{ "compare digits", INPUT_VERSIONS, 0, NULL, "0", NULL },
+};
+
+static void
+input_init_generated (Input *input, const Generator *generator, gsize size)
+{
+	memset (input, 0, sizeof (*input));
+	input->type = generator->type;
+	input->flags = generator->flags;
+
+	if (generator->type == INPUT_REPORT) {
+		input->report = new_repeated_string (generator->prefix,
+		                                     generator->unit,
+		                                     generator->suffix, size);
+		input->length = strlen (input->report);
+	} else if (generator->type == INPUT_FIELDS &&
+	           generator->unit == NULL) {
+		gsize i;
+
+		input->strv = g_new (gchar *, size + 1);
+
+		for (i = 0; i < size; i++) {
+			input->strv[i] = g_strdup ("");
+		}
+
+		input->strv[size] = NULL;
+		input->length = size;
+	} else if (generator->type == INPUT_FIELDS) {
+		input->strv = g_new0 (gchar *, 2);
+		input->strv[0] = new_repeated_string ("", generator->unit, "",
+		                                      size);
+		input->length = strlen (input->strv[0]);
+	} else {
+		input->strv = g_new0 (gchar *, 3);
+		input->strv[0] = new_repeated_string ("", generator->unit, "",
+		                                      size);
+		input->strv[1] = g_strdup (input->strv[0]);
+		input->length = strlen (input->strv[0]);
+		input->strv[1][input->length - 1] = '9';
+	}
+}
+
+/* Inputs in the parse/ directory are reports; those in the format/ directory
+ * are fields, as used by fuzz/fuzz-format.c: a flags byte followed by
+ * nul-separated fields. */
+static gboolean
+input_init_from_file (Input *input, const gchar *path, InputType type)
+{
+	gchar *contents;
+	gsize length;
+
+	memset (input, 0, sizeof (*input));
+	input->type = type;
+
+	if (!g_file_get_contents (path, &contents, &length, NULL)) {
+		return FALSE;
+	}
+
+	if (type == INPUT_REPORT) {
+		input->report = contents;
+		input->length = length;
+	} else if (length == 0) {
+		g_free (contents);
+		return FALSE;
+	} else {
+		GPtrArray/*<owned string>*/ *fields;
+		const gchar *p = contents + 1, *end = contents + length;
+
+		fields = g_ptr_array_new ();
+
+		while (TRUE) {
+			const gchar *field_end = memchr (p, '\0', end - p);
+
+			if (field_end == NULL) {
+				field_end = end;
+			}
+
+			g_ptr_array_add (fields, g_strndup (p, field_end - p));
+
+			if (field_end == end) {
+				break;
+			}
+
+			p = field_end + 1;
+		}
+
+		g_ptr_array_add (fields, NULL);
+		input->flags = (contents[0] & 1) ?
+		               OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8 :
+		               OS_VERSION_FORMAT_FLAGS_NONE;
+		input->strv = (gchar **) g_ptr_array_free (fields, FALSE);
+		input->length = length;
+		g_free (contents);
+	}
+
+	return TRUE;
+}
+
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*((const gchar * const *) a),
+	               *((const gchar * const *) b));
+}
+
+static void
+run_corpus (const gchar *corpus_dir, const gchar *subdir, InputType type)
+{
+	gchar *dir_path;
+	GDir *dir;
+	GPtrArray/*<owned string>*/ *names;
+	const gchar *name;
+	guint i;
+
+	dir_path = g_build_filename (corpus_dir, subdir, NULL);
+	dir = g_dir_open (dir_path, 0, NULL);
+
+	if (dir == NULL) {
+		g_print ("%s: not found, skipping\n", dir_path);
+		g_free (dir_path);
+		return;
+	}
+
+	names = g_ptr_array_new_with_free_func (g_free);
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_ptr_array_add (names, g_strdup (name));
+	}
+
+	g_dir_close (dir);
+	g_ptr_array_sort (names, compare_strings);
+
+	for (i = 0; i < names->len; i++) {
+		gchar *path;
+		Input input;
+
+		path = g_build_filename (dir_path, names->pdata[i], NULL);
+
+		if (input_init_from_file (&input, path, type)) {
+			g_print ("%s/%-28s %8" G_GSIZE_FORMAT " bytes  "
+			         "%8.2f ns/byte\n",
+			         subdir, (const gchar *) names->pdata[i],
+			         input.length, input_time (&input));
+			input_clear (&input);
+		}
+
+		g_free (path);
+	}
+
+	g_ptr_array_unref (names);
+	g_free (dir_path);
+}
+
+int
+main (int argc, char *argv[])
+{
+	const gchar *corpus_dir = "fuzz/corpus";
+	guint i, j, n_failures = 0;
+
+	if (argc > 1) {
+		corpus_dir = argv[1];
+	}
+
+	g_print ("Seed corpus:\n");
+	run_corpus (corpus_dir, "parse", INPUT_REPORT);
+	run_corpus (corpus_dir, "format", INPUT_FIELDS);
+
+	g_print ("\nGenerated inputs, ns/byte at each size:\n");
+	g_print ("%-26s", "");
+
+	for (j = 0; j < G_N_ELEMENTS (sizes); j++) {
+		g_print ("%6" G_GSIZE_FORMAT " KiB", sizes[j] / 1024);
+	}
+
+	g_print ("\n");
+
+	for (i = 0; i < G_N_ELEMENTS (generators); i++) {
+		gdouble first = 0.0, last = 0.0;
+
+		g_print ("%-26s", generators[i].name);
+
+		for (j = 0; j < G_N_ELEMENTS (sizes); j++) {
+			Input input;
+
+			input_init_generated (&input, &generators[i], sizes[j]);
+			last = input_time (&input);
+			input_clear (&input);
+
+			if (j == 0) {
+				first = last;
+			}
+
+			g_print ("%10.2f", last);
+		}
+
+		if (last > first * MAX_SLOWDOWN) {
+			g_print ("  worse than linear\n");
+			n_failures++;
+		} else {
+			g_print ("\n");
+		}
+	}
+
+	return (n_failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Throughput of os_version_unescape() against g_strcompress(), and of
+ * os_version_parse(), over a synthetic fleet corpus.
+ *
+ * Usage: benchmark-unescape [N_REPORTS] */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "corpus.h"
+
+
+#define N_ROUNDS 10
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray/*<owned GStrv>*/ *corpus;
+	GPtrArray/*<owned string>*/ *escaped, *reports;
+	guint i, round, n_reports = 100000;
+	gsize escaped_bytes = 0, report_bytes = 0, max_length = 0;
+	gchar *dest;
+	gint64 start_time;
+	gdouble seconds;
+
+	if (argc > 1) {
+		n_reports = strtoul (argv[1], NULL, 10);
+	}
+
+	corpus = corpus_new_fields (n_reports, 1);
+	escaped = g_ptr_array_new_with_free_func (g_free);
+	reports = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < corpus->len; i++) {
+		gchar **fields = corpus->pdata[i];
+		gchar *report;
+		guint j;
+
+		for (j = 0; fields[j] != NULL; j++) {
+			gchar *field = g_strescape (fields[j], "");
+
+			escaped_bytes += strlen (field);
+			max_length = MAX (max_length, strlen (field));
+			g_ptr_array_add (escaped, field);
+		}
+
+		report = corpus_format_report ((const gchar * const *) fields);
+		report_bytes += strlen (report);
+		g_ptr_array_add (reports, report);
+	}
+
+	g_print ("%u reports, %u fields, %" G_GSIZE_FORMAT " escaped bytes\n",
+	         reports->len, escaped->len, escaped_bytes);
+
+	/* g_strcompress() */
+	start_time = g_get_monotonic_time ();
+
+	for (round = 0; round < N_ROUNDS; round++) {
+		for (i = 0; i < escaped->len; i++) {
+			g_free (g_strcompress (escaped->pdata[i]));
+		}
+	}
+
+	seconds = corpus_get_seconds (start_time);
+	g_print ("g_strcompress():       %8.1f MB/s\n",
+	         N_ROUNDS * escaped_bytes / seconds / 1e6);
+
+	/* os_version_unescape(), into a reused buffer. */
+	dest = g_malloc (max_length);
+	start_time = g_get_monotonic_time ();
+
+	for (round = 0; round < N_ROUNDS; round++) {
+		for (i = 0; i < escaped->len; i++) {
+			const gchar *field = escaped->pdata[i];
+
+			os_version_unescape (field, strlen (field), dest);
+		}
+	}
+
+	seconds = corpus_get_seconds (start_time);
+	g_print ("os_version_unescape(): %8.1f MB/s\n",
+	         N_ROUNDS * escaped_bytes / seconds / 1e6);
+	g_free (dest);
+
+	/* os_version_parse() of whole reports. */
+	start_time = g_get_monotonic_time ();
+
+	for (round = 0; round < N_ROUNDS; round++) {
+		for (i = 0; i < reports->len; i++) {
+			g_strfreev (os_version_parse (reports->pdata[i], -1,
+			                              NULL));
+		}
+	}
+
+	seconds = corpus_get_seconds (start_time);
+	g_print ("os_version_parse():    %8.1f MB/s, %.0f ns/report\n",
+	         N_ROUNDS * report_bytes / seconds / 1e6,
+	         seconds * 1e9 / (N_ROUNDS * reports->len));
+
+	g_ptr_array_unref (reports);
+	g_ptr_array_unref (escaped);
+	g_ptr_array_unref (corpus);
+
+	return 0;
+}
@@ -0,0 +1,367 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+#include "corpus.h"
+
+
+/*
+ * Synthetic fleet corpus for the benchmarks
+ *
+ * This generates reports shaped like those from a real fleet: mostly Linux and
+ * Android, with a skewed distribution of a few thousand distinct kernel
+ * releases and device models, and some device names which need escaping.
+ * Generation is deterministic for a given seed, so results are comparable
+ * between runs.
+ */
+
+static const gchar *
+pick (GRand *rand, const gchar * const *values, gsize n_values)
+{
+	/* Skew towards the start of @values, as real fleets are dominated by a
+	 * few configurations. */
+	gsize a = g_rand_int_range (rand, 0, n_values);
+	gsize b = g_rand_int_range (rand, 0, n_values);
+
+	return values[MIN (a, b)];
+}
+
+#define PICK(rand, values) pick ((rand), (values), G_N_ELEMENTS (values))
+
+static const gchar * const machines[] = {
+	"x86_64", "aarch64", "armv7l", "i686",
+};
+
+static const gchar * const vulnerabilities[] = {
+	"MMMMMNMNNMMNNMNN", "NNNNNNNNNNNNNNNN", "MMMMMMMMNMMMNMMM",
+	"MMVMMNMNNMVNNMNN", "MMMMM-MNNMMNNMNN",
+};
+
+static const gchar * const clocksources[] = {
+	"tsc", "kvm-clock", "arch_sys_counter", "hpet", "xen",
+};
+
+static const gchar * const thp_modes[] = {
+	"madvise", "always", "never",
+};
+
+static void
+add_linux_fields (GRand *rand, GPtrArray/*<owned string>*/ *fields)
+{
+	g_ptr_array_add (fields, g_strdup (PICK (rand, vulnerabilities)));
+	g_ptr_array_add (fields, g_strdup (PICK (rand, clocksources)));
+	g_ptr_array_add (fields, g_strdup (PICK (rand, thp_modes)));
+	g_ptr_array_add (fields, g_strdup ((g_rand_int_range (rand, 0, 10) == 0) ?
+	                                   "512" : "0"));
+	g_ptr_array_add (fields, g_strdup ("2097152"));
+}
+
+static const gchar * const kernel_bases[] = {
+	"6.8.0", "5.15.0", "6.1.0", "5.4.0", "6.5.0", "4.19.0", "6.6.15",
+};
+
+static const gchar * const kernel_flavours[] = {
+	"generic", "aws", "azure", "amd64", "lowlatency", "cloud-amd64", "gcp",
+};
+
+static const gchar * const weekdays[] = {
+	"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun",
+};
+
+static const gchar * const months[] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+	"Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+/* Build date of the kernel build identified by @build, formatted as in
+ * utsname.version. Each build has a single date, as in a real fleet. */
+static gchar *
+new_build_date (guint32 build)
+{
+	GRand *rand = g_rand_new_with_seed (build);
+	gchar *date;
+
+	date = g_strdup_printf ("%s %s %u %02u:%02u:%02u UTC %u",
+	                        PICK (rand, weekdays), PICK (rand, months),
+	                        g_rand_int_range (rand, 1, 29),
+	                        g_rand_int_range (rand, 0, 24),
+	                        g_rand_int_range (rand, 0, 60),
+	                        g_rand_int_range (rand, 0, 60),
+	                        g_rand_int_range (rand, 2019, 2025));
+	g_rand_free (rand);
+
+	return date;
+}
+
+static void
+add_linux_report (GRand *rand, GPtrArray/*<owned string>*/ *fields)
+{
+	const gchar *base = PICK (rand, kernel_bases);
+	guint abi = g_rand_int_range (rand, 1, 120);
+	guint32 build = g_str_hash (base) + abi;
+	gchar *date;
+
+	date = new_build_date (build);
+
+	g_ptr_array_add (fields, g_strdup ("Linux"));
+	g_ptr_array_add (fields, g_strdup ("Linux"));
+
+	switch (g_rand_int_range (rand, 0, 4)) {
+	case 0:
+	case 1:
+		/* Ubuntu */
+		g_ptr_array_add (fields,
+		                 g_strdup_printf ("%s-%u-%s", base, abi,
+		                                  PICK (rand,
+		                                        kernel_flavours)));
+		g_ptr_array_add (fields,
+		                 g_strdup_printf ("#%u-Ubuntu SMP "
+		                                  "PREEMPT_DYNAMIC %s",
+		                                  abi + 10, date));
+		break;
+	case 2:
+		/* Debian */
+		g_ptr_array_add (fields,
+		                 g_strdup_printf ("%s-%u-amd64", base, abi));
+		g_ptr_array_add (fields,
+		                 g_strdup_printf ("#1 SMP PREEMPT_DYNAMIC Debian "
+		                                  "%s.%u-1 (%u-%02u-%02u)",
+		                                  base, abi,
+		                                  2019 + build % 6,
+		                                  1 + build % 12,
+		                                  1 + build % 28));
+		break;
+	default:
+		/* Fedora */
+		g_ptr_array_add (fields,
+		                 g_strdup_printf ("%s-%u.fc%u.x86_64", base,
+		                                  abi + 100, 37 + build % 4));
+		g_ptr_array_add (fields,
+		                 g_strdup_printf ("#1 SMP PREEMPT_DYNAMIC %s",
+		                                  date));
+		break;
+	}
+
+	g_ptr_array_add (fields, g_strdup (PICK (rand, machines)));
+	add_linux_fields (rand, fields);
+
+	g_free (date);
+}
+
+static const gchar * const android_models[] = {
+	"SM-S918B", "Pixel 7", "Redmi Note 12", "M2101K6G", "CPH2473",
+	"moto g \"stylus\" 5G", "小米 13 Pro", "Galaxy A54 5G", "Nokia G21",
+	"HUAWEI P30 lite", "ASUS_I006D", "Xperia 5 Ⅳ",
+};
+
+static const gchar * const android_brands[] = {
+	"samsung", "google", "Redmi", "Xiaomi", "OPPO", "motorola", "HUAWEI",
+	"Nokia", "asus", "Sony",
+};
+
+static const gchar * const android_boards[] = {
+	"kalama", "gs201", "taro", "lahaina", "mt6789", "exynos2100",
+};
+
+static const gchar * const android_releases[] = {
+	"13", "14", "12", "11", "10", "9", "8.1.0",
+};
+
+static void
+add_android_report (GRand *rand, GPtrArray/*<owned string>*/ *fields)
+{
+	const gchar *release = PICK (rand, android_releases);
+	const gchar *model = PICK (rand, android_models);
+	const gchar *brand = PICK (rand, android_brands);
+	const gchar *board = PICK (rand, android_boards);
+	guint build = g_rand_int_range (rand, 1, 400);
+	guint32 kernel_build = g_str_hash (model) + build;
+	gchar *date = new_build_date (kernel_build);
+
+	g_ptr_array_add (fields, g_strdup ("Android"));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("%u", g_rand_int_range (rand, 26,
+	                                                          35)));
+	g_ptr_array_add (fields, g_strdup ("Linux"));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("%s-android%s-%u-g%08x-ab%u",
+	                                  kernel_bases[kernel_build %
+	                                               G_N_ELEMENTS (kernel_bases)],
+	                                  release, 1 + kernel_build % 11,
+	                                  kernel_build * 2654435761u,
+	                                  9000000 + kernel_build % 1000000));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("#1 SMP PREEMPT %s", date));
+	g_ptr_array_add (fields, g_strdup ("aarch64"));
+	g_ptr_array_add (fields, g_strdup (model));
+	g_ptr_array_add (fields, g_strdup (brand));
+	g_ptr_array_add (fields, g_strdup_printf ("%s_%s", board, brand));
+	g_ptr_array_add (fields, g_strdup (board));
+	g_ptr_array_add (fields, g_strdup (board));
+	g_ptr_array_add (fields, g_strdup (brand));
+	g_ptr_array_add (fields, g_strdup_printf ("TP1A.%06u.%03u",
+	                                          220000 + build,
+	                                          build % 20));
+	g_ptr_array_add (fields, g_strdup_printf ("TP1A.%06u.%03u release-keys",
+	                                          220000 + build,
+	                                          build % 20));
+	g_ptr_array_add (fields, g_strdup_printf ("%u", 9000000 + build));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("%u", g_rand_int_range (rand, 26,
+	                                                          35)));
+	g_ptr_array_add (fields, g_strdup ("REL"));
+	g_ptr_array_add (fields, g_strdup (release));
+	add_linux_fields (rand, fields);
+
+	g_free (date);
+}
+
+static void
+add_darwin_report (GRand *rand, GPtrArray/*<owned string>*/ *fields)
+{
+	guint major = g_rand_int_range (rand, 20, 24);
+	guint minor = g_rand_int_range (rand, 0, 7);
+
+	g_ptr_array_add (fields, g_strdup ("Darwin"));
+	g_ptr_array_add (fields, g_strdup ("Darwin"));
+	g_ptr_array_add (fields, g_strdup_printf ("%u.%u.0", major, minor));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("Darwin Kernel Version %u.%u.0: "
+	                                  "Fri Mar 15 00:10:42 PDT 2024; "
+	                                  "root:xnu-10063.101.17~1/"
+	                                  "RELEASE_ARM64_T6000",
+	                                  major, minor));
+	g_ptr_array_add (fields, g_strdup ("arm64"));
+	g_ptr_array_add (fields, g_strdup ("arm64"));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("MacBookPro18,%u",
+	                                  g_rand_int_range (rand, 1, 5)));
+}
+
+static void
+add_windows_report (GRand *rand, GPtrArray/*<owned string>*/ *fields)
+{
+	g_ptr_array_add (fields, g_strdup ("Windows"));
+	g_ptr_array_add (fields, g_strdup ("284"));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("10.0.%u",
+	                                  (g_rand_int_range (rand, 0, 2) == 0) ?
+	                                  19045 : 22631));
+	g_ptr_array_add (fields, g_strdup ("2"));
+	g_ptr_array_add (fields, g_strdup (""));
+	g_ptr_array_add (fields, g_strdup ("0.0"));
+	g_ptr_array_add (fields, g_strdup ("256"));
+	g_ptr_array_add (fields, g_strdup ("1"));
+	g_ptr_array_add (fields, g_strdup ("9"));
+	g_ptr_array_add (fields, g_strdup ("6"));
+	g_ptr_array_add (fields,
+	                 g_strdup_printf ("%u", g_rand_int_range (rand, 1000,
+	                                                          50000)));
+}
+
+/* Generate the fields of @n_reports reports. */
+GPtrArray/*<owned GStrv>*/ *
+corpus_new_fields (guint n_reports, guint32 seed)
+{
+	GPtrArray/*<owned GStrv>*/ *corpus;
+	GRand *rand;
+	guint i;
+
+	corpus = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+	rand = g_rand_new_with_seed (seed);
+
+	for (i = 0; i < n_reports; i++) {
+		GPtrArray/*<owned string>*/ *fields;
+		guint percentile = g_rand_int_range (rand, 0, 100);
+
+		fields = g_ptr_array_new ();
+
+		if (percentile < 50) {
+			add_linux_report (rand, fields);
+		} else if (percentile < 85) {
+			add_android_report (rand, fields);
+		} else if (percentile < 95) {
+			add_darwin_report (rand, fields);
+		} else {
+			add_windows_report (rand, fields);
+		}
+
+		g_ptr_array_add (fields, NULL);
+		g_ptr_array_add (corpus, g_ptr_array_free (fields, FALSE));
+	}
+
+	g_rand_free (rand);
+
+	return corpus;
+}
+
+/* Format the %NULL-terminated @fields as get_os_version() does. This does not
+ * use the library’s formatter, so the corpus can be used to check it. */
+gchar *
+corpus_format_report (const gchar * const *fields)
+{
+	GString *out;
+	guint j;
+
+	out = g_string_new ("");
+
+	for (j = 0; fields[j] != NULL; j++) {
+		gchar *escaped = g_strescape (fields[j], "");
+
+		g_string_append_printf (out, "%s\"%s\"",
+		                        (j > 0) ? ", " : "", escaped);
+		g_free (escaped);
+	}
+
+	return g_string_free (out, FALSE);
+}
+
+/* Generate @n_reports formatted reports, as from get_os_version(). */
+GPtrArray/*<owned string>*/ *
+corpus_new_reports (guint n_reports, guint32 seed)
+{
+	GPtrArray/*<owned GStrv>*/ *fields;
+	GPtrArray/*<owned string>*/ *reports;
+	guint i;
+
+	fields = corpus_new_fields (n_reports, seed);
+	reports = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < fields->len; i++) {
+		g_ptr_array_add (reports,
+		                 corpus_format_report (fields->pdata[i]));
+	}
+
+	g_ptr_array_unref (fields);
+
+	return reports;
+}
+
+/* Seconds elapsed since @start_time, from g_get_monotonic_time(). */
+gdouble
+corpus_get_seconds (gint64 start_time)
+{
+	return (gdouble) (g_get_monotonic_time () - start_time) /
+	       G_USEC_PER_SEC;
+}
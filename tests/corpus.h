@@ -0,0 +1,44 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+
+#ifndef _OS_VERSION_TESTS_CORPUS_H_
+#define _OS_VERSION_TESTS_CORPUS_H_
+
+
+GPtrArray/*<owned GStrv>*/ *
+corpus_new_fields (guint n_reports, guint32 seed);
+
+gchar *
+corpus_format_report (const gchar * const *fields);
+
+GPtrArray/*<owned string>*/ *
+corpus_new_reports (guint n_reports, guint32 seed);
+
+gdouble
+corpus_get_seconds (gint64 start_time);
+
+
+#endif /* _OS_VERSION_TESTS_CORPUS_H_ */
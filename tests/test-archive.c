@@ -0,0 +1,421 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "osversion.h"
+#include "osversion-archive.h"
+
+
+typedef struct {
+	gchar *tmp_dir;
+	gchar *archive_path;
+	gchar *log_path;
+} Fixture;
+
+static void
+setup (Fixture *fixture, gconstpointer user_data)
+{
+	GError *error = NULL;
+
+	fixture->tmp_dir = g_dir_make_tmp ("osversion-archive-XXXXXX", &error);
+	g_assert_no_error (error);
+	fixture->archive_path = g_build_filename (fixture->tmp_dir, "archive",
+	                                          NULL);
+	fixture->log_path = g_build_filename (fixture->tmp_dir, "log", NULL);
+}
+
+static void
+teardown (Fixture *fixture, gconstpointer user_data)
+{
+	g_unlink (fixture->log_path);
+	g_unlink (fixture->archive_path);
+	g_rmdir (fixture->tmp_dir);
+	g_free (fixture->log_path);
+	g_free (fixture->archive_path);
+	g_free (fixture->tmp_dir);
+}
+
+/* Number of records written by write_archive(). This spans several blocks. */
+#define N_RECORDS 150000
+
+/* Write N_RECORDS records: every record has ‘Linux’ or ‘Android’ in column 0
+ * and a release in column 1; every third record also has a machine in
+ * column 2. */
+static void
+write_archive (const gchar *path)
+{
+	OsVersionArchiveWriter *writer;
+	GError *error = NULL;
+	guint i;
+
+	writer = os_version_archive_writer_new (path, &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < N_RECORDS; i++) {
+		gchar *release = g_strdup_printf ("5.%u.0", i % 20);
+		const gchar *fields[] = {
+			(i % 4 == 0) ? "Android" : "Linux",
+			release,
+			(i % 2 == 0) ? "x86_64" : "aarch64",
+		};
+
+		os_version_archive_writer_add_fields (writer, fields,
+		                                      (i % 3 == 0) ? 3 : 2,
+		                                      &error);
+		g_assert_no_error (error);
+		g_free (release);
+	}
+
+	os_version_archive_writer_close (writer, &error);
+	g_assert_no_error (error);
+	os_version_archive_writer_free (writer);
+}
+
+static void
+test_archive_round_trip (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionArchive *archive;
+	GError *error = NULL;
+	guint64 row = 0;
+	guint block;
+
+	write_archive (fixture->archive_path);
+	archive = os_version_archive_new (fixture->archive_path, &error);
+	g_assert_no_error (error);
+
+	g_assert_cmpuint (os_version_archive_get_n_records (archive), ==,
+	                  N_RECORDS);
+	g_assert_cmpuint (os_version_archive_get_n_columns (archive), ==, 3);
+	g_assert_cmpuint (os_version_archive_get_n_values (archive, 0), ==, 2);
+	g_assert_cmpuint (os_version_archive_get_n_values (archive, 1), ==,
+	                  20);
+
+	for (block = 0; block < os_version_archive_get_n_blocks (archive);
+	     block++) {
+		const guint32 *codes;
+		guint i, n_rows;
+
+		codes = os_version_archive_get_block_codes (archive, block, 1,
+		                                            &n_rows);
+
+		for (i = 0; i < n_rows; i++, row++) {
+			gchar *release = g_strdup_printf ("5.%u.0",
+			                                  (guint) (row % 20));
+
+			g_assert_cmpstr (os_version_archive_get_value (archive,
+			                                               1,
+			                                               codes[i]),
+			                 ==, release);
+			g_free (release);
+		}
+	}
+
+	g_assert_cmpuint (row, ==, N_RECORDS);
+
+	os_version_archive_free (archive);
+}
+
+static void
+test_archive_query (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionArchive *archive;
+	OsVersionArchiveQuery *query;
+	GError *error = NULL;
+	guint64 *counts;
+	guint32 n_groups, code;
+	guint64 expected_absent = 0, expected_x86 = 0;
+	guint i;
+
+	write_archive (fixture->archive_path);
+	archive = os_version_archive_new (fixture->archive_path, &error);
+	g_assert_no_error (error);
+
+	/* Android records: i % 4 == 0. */
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_equals (query, 0, "Android");
+	g_assert_cmpuint (os_version_archive_query_count (query), ==,
+	                  N_RECORDS / 4);
+
+	/* Android records with a machine field: i % 12 == 0. */
+	counts = os_version_archive_query_group_by (query, 2, &n_groups);
+	g_assert_cmpuint (n_groups, ==, 3);
+	g_assert_cmpuint (counts[OS_VERSION_ARCHIVE_CODE_ABSENT], ==,
+	                  N_RECORDS / 4 - N_RECORDS / 12);
+
+	for (code = 1; code < n_groups; code++) {
+		const gchar *machine;
+
+		machine = os_version_archive_get_value (archive, 2, code);
+		g_assert_cmpuint (counts[code], ==,
+		                  g_str_equal (machine, "x86_64") ?
+		                  N_RECORDS / 12 : 0);
+	}
+
+	g_free (counts);
+
+	/* Absent fields. */
+	os_version_archive_query_add_equals (query, 2, NULL);
+	g_assert_cmpuint (os_version_archive_query_count (query), ==,
+	                  N_RECORDS / 4 - N_RECORDS / 12);
+	os_version_archive_query_free (query);
+
+	for (i = 0; i < N_RECORDS; i++) {
+		if (i % 3 != 0) {
+			expected_absent++;
+		} else if (i % 2 == 0) {
+			expected_x86++;
+		}
+	}
+
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_equals (query, 2, NULL);
+	g_assert_cmpuint (os_version_archive_query_count (query), ==,
+	                  expected_absent);
+	os_version_archive_query_free (query);
+
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_equals (query, 2, "x86_64");
+	g_assert_cmpuint (os_version_archive_query_count (query), ==,
+	                  expected_x86);
+	os_version_archive_query_free (query);
+
+	os_version_archive_free (archive);
+}
+
+static void
+test_archive_version_range (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionArchive *archive;
+	OsVersionArchiveVersionIndex *index;
+	OsVersionArchiveQuery *query;
+	GError *error = NULL;
+
+	write_archive (fixture->archive_path);
+	archive = os_version_archive_new (fixture->archive_path, &error);
+	g_assert_no_error (error);
+
+	/* [5.2, 5.11) covers 5.2.0 to 5.10.0, which is 9 of the 20 releases;
+	 * lexicographic comparison would get this wrong. */
+	index = os_version_archive_version_index_new (archive, 1);
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_version_range (query, index, "5.2",
+	                                            "5.11");
+	g_assert_cmpuint (os_version_archive_query_count (query), ==,
+	                  N_RECORDS / 20 * 9);
+
+	os_version_archive_query_free (query);
+	os_version_archive_version_index_free (index);
+	os_version_archive_free (archive);
+}
+
+/* Every truncation of a valid archive must be rejected. */
+static void
+test_archive_truncated (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionArchiveWriter *writer;
+	OsVersionArchive *archive;
+	const gchar *fields[] = { "Linux", "6.1.0", "x86_64" };
+	gchar *contents;
+	gsize length, i;
+	GError *error = NULL;
+
+	writer = os_version_archive_writer_new (fixture->archive_path, &error);
+	g_assert_no_error (error);
+	os_version_archive_writer_add_fields (writer, fields, 3, &error);
+	g_assert_no_error (error);
+	os_version_archive_writer_add_fields (writer, fields, 2, &error);
+	g_assert_no_error (error);
+	os_version_archive_writer_close (writer, &error);
+	g_assert_no_error (error);
+	os_version_archive_writer_free (writer);
+
+	g_file_get_contents (fixture->archive_path, &contents, &length,
+	                     &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < length; i++) {
+		g_file_set_contents (fixture->archive_path, contents, i,
+		                     &error);
+		g_assert_no_error (error);
+
+		archive = os_version_archive_new (fixture->archive_path,
+		                                  &error);
+		g_assert_error (error, OS_VERSION_ERROR,
+		                OS_VERSION_ERROR_INVALID_DATA);
+		g_assert_null (archive);
+		g_clear_error (&error);
+	}
+
+	g_free (contents);
+}
+
+/* Build a 96-byte archive with one block claiming @n_rows rows but no
+ * columns, so its code data is empty regardless of @n_rows. */
+static void
+write_crafted_archive (const gchar *path, guint32 n_rows)
+{
+	struct {
+		guint32 magic, version, byte_order_mark, reserved;
+		/* footer */
+		guint32 n_columns, n_blocks;
+		guint64 n_records;
+		/* block 0 */
+		guint64 block_offset;
+		guint32 block_n_rows, block_n_columns;
+		/* column 0 */
+		guint64 strings_offset, strings_length, offsets_offset;
+		guint32 n_values, column_reserved;
+		/* trailer */
+		guint64 footer_offset;
+		guint32 trailer_magic, trailer_reserved;
+	} data = {
+		0x4156534f, 1, 0x01020304, 0,
+		1, 1, n_rows,
+		16, n_rows, 0,
+		0, 0, 0, 0, 0,
+		16, 0x4156534f, 0,
+	};
+	GError *error = NULL;
+
+	G_STATIC_ASSERT (sizeof (data) == 96);
+
+	g_file_set_contents (path, (const gchar *) &data, sizeof (data),
+	                     &error);
+	g_assert_no_error (error);
+}
+
+/* A block must have between 1 and a full block of rows, even if it has no
+ * columns and hence no code data to check its row count against. */
+static void
+test_archive_invalid_block_rows (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionArchive *archive;
+	OsVersionArchiveQuery *query;
+	GError *error = NULL;
+	guint block_n_rows;
+	guint32 n_rows[] = { 0, 65537, 1000000, G_MAXUINT32 };
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (n_rows); i++) {
+		write_crafted_archive (fixture->archive_path, n_rows[i]);
+
+		archive = os_version_archive_new (fixture->archive_path,
+		                                  &error);
+		g_assert_error (error, OS_VERSION_ERROR,
+		                OS_VERSION_ERROR_INVALID_DATA);
+		g_assert_null (archive);
+		g_clear_error (&error);
+	}
+
+	/* A full block with no columns is valid, and all its fields are
+	 * absent. */
+	write_crafted_archive (fixture->archive_path, 65536);
+
+	archive = os_version_archive_new (fixture->archive_path, &error);
+	g_assert_no_error (error);
+
+	g_assert_cmpuint (os_version_archive_get_n_records (archive), ==,
+	                  65536);
+	g_assert_null (os_version_archive_get_block_codes (archive, 0, 0,
+	                                                   &block_n_rows));
+	g_assert_cmpuint (block_n_rows, ==, 65536);
+
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_equals (query, 0, NULL);
+	g_assert_cmpuint (os_version_archive_query_count (query), ==, 65536);
+	os_version_archive_query_free (query);
+
+	os_version_archive_free (archive);
+}
+
+/* Lines which cannot be archived are skipped and counted, rather than
+ * aborting the conversion. */
+static void
+test_archive_convert_invalid (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionArchive *archive;
+	OsVersionArchiveQuery *query;
+	GString *log;
+	GError *error = NULL;
+	guint64 n_invalid = 0;
+	guint i;
+
+	log = g_string_new ("\"Linux\", \"6.1.0\"\n"
+	                    "\"Linux\", \"6.1.0\n"  /* unterminated */
+	                    "\r\n"
+	                    "\"Linux\" \"6.1.0\"\n"  /* no separator */
+	                    "\"Android\", \"5.10.0\"\r\n");
+
+	/* More fields than the writer accepts. */
+	for (i = 0; i < 300; i++) {
+		g_string_append (log, (i == 0) ? "\"\"" : ", \"\"");
+	}
+
+	g_string_append (log, "\n\"Linux\", \"5.15.0\"");
+
+	g_file_set_contents (fixture->log_path, log->str, log->len, &error);
+	g_assert_no_error (error);
+
+	os_version_archive_convert (fixture->log_path, fixture->archive_path,
+	                            &n_invalid, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (n_invalid, ==, 3);
+
+	archive = os_version_archive_new (fixture->archive_path, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (os_version_archive_get_n_records (archive), ==, 3);
+	g_assert_cmpuint (os_version_archive_get_n_columns (archive), ==, 2);
+
+	query = os_version_archive_query_new (archive);
+	os_version_archive_query_add_equals (query, 0, "Linux");
+	g_assert_cmpuint (os_version_archive_query_count (query), ==, 2);
+	os_version_archive_query_free (query);
+
+	os_version_archive_free (archive);
+	g_string_free (log, TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/archive/round-trip", Fixture, NULL, setup,
+	            test_archive_round_trip, teardown);
+	g_test_add ("/archive/query", Fixture, NULL, setup,
+	            test_archive_query, teardown);
+	g_test_add ("/archive/version-range", Fixture, NULL, setup,
+	            test_archive_version_range, teardown);
+	g_test_add ("/archive/truncated", Fixture, NULL, setup,
+	            test_archive_truncated, teardown);
+	g_test_add ("/archive/invalid-block-rows", Fixture, NULL, setup,
+	            test_archive_invalid_block_rows, teardown);
+	g_test_add ("/archive/convert-invalid", Fixture, NULL, setup,
+	            test_archive_convert_invalid, teardown);
+
+	return g_test_run ();
+}
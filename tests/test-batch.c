@@ -0,0 +1,232 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "osversion.h"
+#include "osversion-batch.h"
+
+
+/* Files under proc/sys/kernel in a fixture root. */
+static const gchar * const kernel_file_names[] = {
+	"ostype", "osrelease", "version", "arch",
+};
+
+/* Create a fixture root under @parent containing whichever of the kernel
+ * files in @contents are non-%NULL: ostype, osrelease, version and arch. */
+static gchar *
+make_root (const gchar *parent, const gchar *name,
+           const gchar * const *contents)
+{
+	gchar *root, *kernel_dir;
+	gsize i;
+
+	root = g_build_filename (parent, name, NULL);
+	kernel_dir = g_build_filename (root, "proc", "sys", "kernel", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (kernel_dir, 0700), ==, 0);
+
+	for (i = 0; i < G_N_ELEMENTS (kernel_file_names); i++) {
+		gchar *path;
+		GError *error = NULL;
+
+		if (contents[i] == NULL) {
+			continue;
+		}
+
+		path = g_build_filename (kernel_dir, kernel_file_names[i],
+		                         NULL);
+		g_file_set_contents (path, contents[i], -1, &error);
+		g_assert_no_error (error);
+		g_free (path);
+	}
+
+	g_free (kernel_dir);
+
+	return root;
+}
+
+/* Remove a fixture root made by make_root(). */
+static void
+remove_root (const gchar *root)
+{
+	gchar *dir;
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (kernel_file_names); i++) {
+		gchar *path = g_build_filename (root, "proc", "sys", "kernel",
+		                                kernel_file_names[i], NULL);
+
+		g_unlink (path);
+		g_free (path);
+	}
+
+	dir = g_build_filename (root, "proc", "sys", "kernel", NULL);
+	g_rmdir (dir);
+	g_free (dir);
+	dir = g_build_filename (root, "proc", "sys", NULL);
+	g_rmdir (dir);
+	g_free (dir);
+	dir = g_build_filename (root, "proc", NULL);
+	g_rmdir (dir);
+	g_free (dir);
+	g_rmdir (root);
+}
+
+static const gchar * const full_contents[] = {
+	"Linux\n", "6.1.0-18-amd64\n",
+	"#1 SMP PREEMPT_DYNAMIC Debian 6.1.76-1 (2024-02-01)\n", "x86_64\n",
+};
+
+static const gchar * const full_fields[] = {
+	"Linux", "Linux", "6.1.0-18-amd64",
+	"#1 SMP PREEMPT_DYNAMIC Debian 6.1.76-1 (2024-02-01)", "x86_64", NULL,
+};
+
+/* Kernels before 6.1 have no arch file; the version needs escaping. */
+static const gchar * const partial_contents[] = {
+	"Linux\n", "5.4.0-generic\n", "#1 SMP \"test\" build\n", NULL,
+};
+
+static const gchar * const partial_fields[] = {
+	"Linux", "Linux", "5.4.0-generic", "#1 SMP \"test\" build", "Unknown",
+	NULL,
+};
+
+static const gchar * const missing_fields[] = {
+	"Linux", "Unknown", "Unknown", "Unknown", "Unknown", NULL,
+};
+
+/* The fields are read from the files under the root, and missing files are
+ * reported as ‘Unknown’. */
+static void
+test_batch_root (void)
+{
+	gchar *tmp_dir, *full_root, *partial_root, *missing_root;
+	gchar *report, *expected;
+	GError *error = NULL;
+
+	tmp_dir = g_dir_make_tmp ("osversion-batch-XXXXXX", &error);
+	g_assert_no_error (error);
+	full_root = make_root (tmp_dir, "full", full_contents);
+	partial_root = make_root (tmp_dir, "partial", partial_contents);
+	missing_root = g_build_filename (tmp_dir, "missing", NULL);
+
+	report = os_version_get_for_root (full_root);
+	expected = os_version_format (full_fields, -1);
+	g_assert_cmpstr (report, ==, expected);
+	g_free (expected);
+	g_free (report);
+
+	report = os_version_get_for_root (partial_root);
+	expected = os_version_format (partial_fields, -1);
+	g_assert_cmpstr (report, ==, expected);
+	g_free (expected);
+	g_free (report);
+
+	report = os_version_get_for_root (missing_root);
+	expected = os_version_format (missing_fields, -1);
+	g_assert_cmpstr (report, ==, expected);
+	g_free (expected);
+	g_free (report);
+
+	remove_root (partial_root);
+	remove_root (full_root);
+	g_rmdir (tmp_dir);
+	g_free (missing_root);
+	g_free (partial_root);
+	g_free (full_root);
+	g_free (tmp_dir);
+}
+
+/* Many roots give the same reports as probing each alone, in order, in a
+ * single allocation. */
+static void
+test_batch_roots (void)
+{
+	gchar *tmp_dir, *full_root, *partial_root, *missing_root;
+	const gchar *roots[100];
+	gchar *expected[3];
+	gchar **reports;
+	GError *error = NULL;
+	gsize i;
+
+	tmp_dir = g_dir_make_tmp ("osversion-batch-XXXXXX", &error);
+	g_assert_no_error (error);
+	full_root = make_root (tmp_dir, "full", full_contents);
+	partial_root = make_root (tmp_dir, "partial", partial_contents);
+	missing_root = g_build_filename (tmp_dir, "missing", NULL);
+
+	expected[0] = os_version_format (full_fields, -1);
+	expected[1] = os_version_format (partial_fields, -1);
+	expected[2] = os_version_format (missing_fields, -1);
+
+	for (i = 0; i < G_N_ELEMENTS (roots); i++) {
+		roots[i] = (i % 3 == 0) ? full_root :
+		           (i % 3 == 1) ? partial_root : missing_root;
+	}
+
+	reports = os_version_get_for_roots (roots, G_N_ELEMENTS (roots));
+	g_assert_cmpuint (g_strv_length (reports), ==, G_N_ELEMENTS (roots));
+
+	for (i = 0; i < G_N_ELEMENTS (roots); i++) {
+		g_assert_cmpstr (reports[i], ==, expected[i % 3]);
+	}
+
+	g_free (reports);
+
+	/* One root, and none. */
+	reports = os_version_get_for_roots (roots, 1);
+	g_assert_cmpstr (reports[0], ==, expected[0]);
+	g_assert_null (reports[1]);
+	g_free (reports);
+
+	reports = os_version_get_for_roots (roots, 0);
+	g_assert_null (reports[0]);
+	g_free (reports);
+
+	for (i = 0; i < G_N_ELEMENTS (expected); i++) {
+		g_free (expected[i]);
+	}
+
+	remove_root (partial_root);
+	remove_root (full_root);
+	g_rmdir (tmp_dir);
+	g_free (missing_root);
+	g_free (partial_root);
+	g_free (full_root);
+	g_free (tmp_dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/batch/root", test_batch_root);
+	g_test_add_func ("/batch/roots", test_batch_roots);
+
+	return g_test_run ();
+}
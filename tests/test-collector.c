@@ -0,0 +1,233 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#ifdef G_OS_UNIX
+#include <gio/gunixsocketaddress.h>
+#endif
+
+#include "osversion-collector.h"
+
+
+/* Datagrams sent by send_datagrams(), and the counts the collector should
+ * give for them. */
+static const struct {
+	const gchar *datagram;
+	const gchar *report;  /* NULL if invalid */
+} datagrams[] = {
+	{ "\"Linux\", \"6.1.0\"", "\"Linux\", \"6.1.0\"" },
+	{ "\"Linux\", \"6.1.0\"\n", "\"Linux\", \"6.1.0\"" },
+	{ "\"Linux\", \"6.1.0\"", "\"Linux\", \"6.1.0\"" },
+	{ "\"Android\", \"13\"", "\"Android\", \"13\"" },
+	{ "\"Android\", \"13\"\n", "\"Android\", \"13\"" },
+	{ "\"Linux\\\"", NULL },  /* escaped closing quote */
+	{ "\"Linux\", \"6.1.0", NULL },  /* unterminated */
+	{ "\"Linux\" \"6.1.0\"", NULL },  /* no separator */
+	{ "\n", NULL },
+};
+
+#define N_VALID 5
+#define N_INVALID 4
+
+/* Send each of @datagrams, an empty datagram, one with an embedded nul and
+ * one too long to be a report, to @address. */
+static void
+send_datagrams (GSocketAddress *address)
+{
+	GSocket *socket;
+	GError *error = NULL;
+	gchar *long_report;
+	gsize i;
+
+	socket = g_socket_new (g_socket_address_get_family (address),
+	                       G_SOCKET_TYPE_DATAGRAM,
+	                       G_SOCKET_PROTOCOL_DEFAULT, &error);
+	g_assert_no_error (error);
+
+	for (i = 0; i < G_N_ELEMENTS (datagrams); i++) {
+		g_socket_send_to (socket, address, datagrams[i].datagram,
+		                  strlen (datagrams[i].datagram), NULL, &error);
+		g_assert_no_error (error);
+	}
+
+	g_socket_send_to (socket, address, "", 0, NULL, &error);
+	g_assert_no_error (error);
+	g_socket_send_to (socket, address, "\"Linux\0\"", 8, NULL, &error);
+	g_assert_no_error (error);
+
+	long_report = g_strnfill (9000, 'a');
+	long_report[0] = '"';
+	long_report[8999] = '"';
+	g_socket_send_to (socket, address, long_report, 9000, NULL, &error);
+	g_assert_no_error (error);
+	g_free (long_report);
+
+	g_object_unref (socket);
+}
+
+static void
+add_count (const gchar *report, guint64 count, gpointer user_data)
+{
+	GHashTable/*<owned string, guint>*/ *counts = user_data;
+	guint old_count;
+
+	old_count = GPOINTER_TO_UINT (g_hash_table_lookup (counts, report));
+	g_hash_table_insert (counts, g_strdup (report),
+	                     GUINT_TO_POINTER (old_count + count));
+}
+
+static void
+add_total (const gchar *report, guint64 count, gpointer user_data)
+{
+	guint64 *total = user_data;
+
+	*total += count;
+}
+
+/* Send the test datagrams to a collector on @address, wait for them to be
+ * received, and check the snapshot counts. */
+static void
+check_collector (GSocketAddress *address)
+{
+	OsVersionCollector *collector;
+	GHashTable/*<owned string, guint>*/ *counts;
+	GError *error = NULL;
+	guint64 total = 0, n_invalid = 0;
+	gint64 deadline;
+	gsize i;
+
+	collector = os_version_collector_new (address, 2, &error);
+	g_assert_no_error (error);
+
+	send_datagrams (os_version_collector_get_address (collector));
+
+	/* Datagrams are received asynchronously by the workers. */
+	deadline = g_get_monotonic_time () + 10 * G_USEC_PER_SEC;
+
+	while (g_get_monotonic_time () < deadline) {
+		total = 0;
+		n_invalid = os_version_collector_snapshot (collector, FALSE,
+		                                           add_total, &total);
+
+		if (total == N_VALID && n_invalid == N_INVALID + 3) {
+			break;
+		}
+
+		g_usleep (10000);
+	}
+
+	g_assert_cmpuint (total, ==, N_VALID);
+	g_assert_cmpuint (n_invalid, ==, N_INVALID + 3);
+	g_assert_cmpuint (os_version_collector_get_n_invalid (collector), ==,
+	                  N_INVALID + 3);
+
+	/* A resetting snapshot returns the counts it resets. */
+	counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	n_invalid = os_version_collector_snapshot (collector, TRUE, add_count,
+	                                           counts);
+	g_assert_cmpuint (n_invalid, ==, N_INVALID + 3);
+	g_assert_cmpuint (g_hash_table_size (counts), ==, 2);
+
+	for (i = 0; i < G_N_ELEMENTS (datagrams); i++) {
+		const gchar *report = datagrams[i].report;
+		guint expected = 0;
+		gsize j;
+
+		if (report == NULL) {
+			continue;
+		}
+
+		for (j = 0; j < G_N_ELEMENTS (datagrams); j++) {
+			expected += (g_strcmp0 (datagrams[j].report, report) == 0);
+		}
+
+		g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (counts,
+		                                                         report)),
+		                  ==, expected);
+	}
+
+	g_hash_table_unref (counts);
+
+	g_assert_cmpuint (os_version_collector_get_n_invalid (collector), ==,
+	                  0);
+	total = 0;
+	n_invalid = os_version_collector_snapshot (collector, TRUE, add_total,
+	                                           &total);
+	g_assert_cmpuint (total, ==, 0);
+	g_assert_cmpuint (n_invalid, ==, 0);
+
+	os_version_collector_free (collector);
+}
+
+static void
+test_collector_udp (void)
+{
+	GSocketAddress *address;
+
+	address = g_inet_socket_address_new_from_string ("127.0.0.1", 0);
+	check_collector (address);
+	g_object_unref (address);
+}
+
+static void
+test_collector_unix (void)
+{
+#ifdef G_OS_UNIX
+	GSocketAddress *address;
+	GError *error = NULL;
+	gchar *tmp_dir, *path;
+
+	tmp_dir = g_dir_make_tmp ("osversion-collector-XXXXXX", &error);
+	g_assert_no_error (error);
+	path = g_build_filename (tmp_dir, "socket", NULL);
+
+	address = g_unix_socket_address_new (path);
+	check_collector (address);
+	g_object_unref (address);
+
+	/* The socket file is removed when the collector is freed. */
+	g_assert_false (g_file_test (path, G_FILE_TEST_EXISTS));
+
+	g_rmdir (tmp_dir);
+	g_free (path);
+	g_free (tmp_dir);
+#else
+	g_test_skip ("Unix sockets are not supported");
+#endif
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/collector/udp", test_collector_udp);
+	g_test_add_func ("/collector/unix", test_collector_unix);
+
+	return g_test_run ();
+}
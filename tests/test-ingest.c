@@ -0,0 +1,249 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "osversion-ingest.h"
+
+
+/* Must match the chunk size in osversion-ingest.c, so the log spans several
+ * chunks and has lines on either side of each boundary. */
+#define CHUNK_SIZE (1 << 20)
+#define N_CHUNKS 3
+#define N_THREADS 4
+
+typedef struct {
+	gchar *tmp_dir;
+	gchar *path;
+	GArray/*<guint64>*/ *offsets;  /* of each valid report, by index */
+	guint n_invalid;
+} Log;
+
+typedef struct {
+	GMutex lock;
+	const Log *log;
+	guint *n_delivered;  /* by report index */
+	guint64 last_offset;
+	gboolean in_order;
+} Delivery;
+
+/* Append a report line for valid report @index, padded to @length bytes
+ * before the line ending. */
+static void
+append_report (GString *contents, Log *log, guint index, gsize length,
+               const gchar *line_ending)
+{
+	gsize start = contents->len;
+
+	g_array_append_val (log->offsets, start);
+	g_string_append_printf (contents, "\"Linux\", \"%u\", \"", index);
+	g_assert_cmpuint (contents->len - start + 1, <=, length);
+
+	while (contents->len - start + 1 < length) {
+		g_string_append_c (contents, 'x');
+	}
+
+	g_string_append_c (contents, '"');
+	g_string_append (contents, line_ending);
+}
+
+/* Write a log of more than %N_CHUNKS chunks, with lines of varying length and
+ * mixed LF and CRLF endings. One line starts exactly on the first chunk
+ * boundary, and others straddle the later ones. Empty and invalid lines are
+ * mixed in, and the last line is truncated without a newline. */
+static void
+log_init (Log *log)
+{
+	GString *contents;
+	GError *error = NULL;
+	guint index = 0, line;
+	gsize boundary = CHUNK_SIZE;
+
+	log->tmp_dir = g_dir_make_tmp ("osversion-ingest-XXXXXX", &error);
+	g_assert_no_error (error);
+	log->path = g_build_filename (log->tmp_dir, "log", NULL);
+	log->offsets = g_array_new (FALSE, FALSE, sizeof (guint64));
+	log->n_invalid = 0;
+
+	contents = g_string_new ("");
+
+	for (line = 0; contents->len < N_CHUNKS * CHUNK_SIZE + 1000; line++) {
+		const gchar *line_ending = (line % 3 == 0) ? "\r\n" : "\n";
+		gsize length = 40 + (line * 7919) % 300;
+
+		if (line % 1000 == 999) {
+			g_string_append (contents, "\"Linux\\\"\n");
+			log->n_invalid++;
+			continue;
+		} else if (line % 500 == 0) {
+			g_string_append (contents, "\n");
+			continue;
+		}
+
+		if (contents->len < boundary &&
+		    contents->len + 2 * length >= boundary) {
+			if (boundary == CHUNK_SIZE &&
+			    boundary - contents->len >= 40) {
+				/* Finish exactly on the first boundary. */
+				length = boundary - contents->len - 1;
+				line_ending = "\n";
+			} else if (boundary > CHUNK_SIZE) {
+				/* Straddle the later boundaries. */
+				length = boundary - contents->len + 20;
+			}
+
+			if (contents->len + length + 1 >= boundary) {
+				boundary += CHUNK_SIZE;
+			}
+		}
+
+		append_report (contents, log, index++, length, line_ending);
+	}
+
+	g_assert_cmpuint (contents->len, >, N_CHUNKS * CHUNK_SIZE);
+	g_assert_cmpint (contents->str[CHUNK_SIZE - 1], ==, '\n');
+
+	for (boundary = 2 * CHUNK_SIZE; boundary <= N_CHUNKS * CHUNK_SIZE;
+	     boundary += CHUNK_SIZE) {
+		g_assert_cmpint (contents->str[boundary - 1], ==, 'x');
+	}
+
+	/* Truncated mid-report. */
+	g_string_append (contents, "\"Linux\", \"trunc");
+	log->n_invalid++;
+
+	g_file_set_contents (log->path, contents->str, contents->len, &error);
+	g_assert_no_error (error);
+	g_string_free (contents, TRUE);
+}
+
+static void
+log_clear (Log *log)
+{
+	g_unlink (log->path);
+	g_rmdir (log->tmp_dir);
+	g_free (log->path);
+	g_free (log->tmp_dir);
+	g_array_unref (log->offsets);
+}
+
+static void
+deliver_cb (gchar **fields, guint64 offset, gpointer user_data)
+{
+	Delivery *delivery = user_data;
+	guint index;
+	gsize pad_length;
+
+	g_assert_cmpuint (g_strv_length (fields), ==, 3);
+	g_assert_cmpstr (fields[0], ==, "Linux");
+	index = strtoul (fields[1], NULL, 10);
+	g_assert_cmpuint (index, <, delivery->log->offsets->len);
+	g_assert_cmpuint (offset, ==,
+	                  g_array_index (delivery->log->offsets, guint64,
+	                                 index));
+
+	/* The CR of a CRLF line ending is not part of the report. */
+	pad_length = strspn (fields[2], "x");
+	g_assert_cmpuint (pad_length, ==, strlen (fields[2]));
+
+	g_mutex_lock (&delivery->lock);
+	delivery->n_delivered[index]++;
+
+	if (offset < delivery->last_offset) {
+		delivery->in_order = FALSE;
+	}
+
+	delivery->last_offset = offset;
+	g_mutex_unlock (&delivery->lock);
+}
+
+/* Every valid report is delivered exactly once, with its offset; ordered mode
+ * delivers them in offset order. */
+static void
+test_ingest (gconstpointer user_data)
+{
+	OsVersionIngestFlags flags = GPOINTER_TO_UINT (user_data);
+	Log log;
+	Delivery delivery = { { NULL, }, };
+	guint64 n_invalid = 0;
+	GError *error = NULL;
+	guint i;
+
+	log_init (&log);
+	g_mutex_init (&delivery.lock);
+	delivery.log = &log;
+	delivery.n_delivered = g_new0 (guint, log.offsets->len);
+	delivery.in_order = TRUE;
+
+	g_assert_true (os_version_ingest_file (log.path, N_THREADS, flags,
+	                                       deliver_cb, &delivery,
+	                                       &n_invalid, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (n_invalid, ==, log.n_invalid);
+
+	for (i = 0; i < log.offsets->len; i++) {
+		g_assert_cmpuint (delivery.n_delivered[i], ==, 1);
+	}
+
+	if (flags & OS_VERSION_INGEST_FLAGS_ORDERED) {
+		g_assert_true (delivery.in_order);
+	}
+
+	g_free (delivery.n_delivered);
+	g_mutex_clear (&delivery.lock);
+	log_clear (&log);
+}
+
+/* A missing file is an error. */
+static void
+test_ingest_missing (void)
+{
+	GError *error = NULL;
+
+	g_assert_false (os_version_ingest_file ("/nonexistent/log", N_THREADS,
+	                                        OS_VERSION_INGEST_FLAGS_NONE,
+	                                        deliver_cb, NULL, NULL,
+	                                        &error));
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+	g_clear_error (&error);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_data_func ("/ingest/unordered",
+	                      GUINT_TO_POINTER (OS_VERSION_INGEST_FLAGS_NONE),
+	                      test_ingest);
+	g_test_add_data_func ("/ingest/ordered",
+	                      GUINT_TO_POINTER (OS_VERSION_INGEST_FLAGS_ORDERED),
+	                      test_ingest);
+	g_test_add_func ("/ingest/missing", test_ingest_missing);
+
+	return g_test_run ();
+}
@@ -0,0 +1,187 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion-kernel.h"
+
+
+/* Assert that @span covers @expected within @string, or is absent if
+ * @expected is %NULL. */
+static void
+assert_span (const gchar *string, OsVersionSpan span, const gchar *expected)
+{
+	if (expected == NULL) {
+		g_assert_cmpuint (span.length, ==, 0);
+	} else {
+		g_assert_cmpuint (span.offset + span.length, <=,
+		                  strlen (string));
+		g_assert_cmpmem (string + span.offset, span.length,
+		                 expected, strlen (expected));
+	}
+}
+
+/* The documented examples, and some edge cases. */
+static const struct {
+	const gchar *release;
+	const gchar *version;
+	const gchar *abi;
+	const gchar *flavour;
+} release_cases[] = {
+	{ "5.15.0-91-generic", "5.15.0", "91", "generic" },
+	{ "6.1.0-18-rt-amd64", "6.1.0", "18", "rt-amd64" },
+	{ "5.14.0-362.8.1.el9_3.x86_64", "5.14.0", "362.8.1", "el9_3.x86_64" },
+	{ "6.6.1-arch1-1", "6.6.1", NULL, "arch1-1" },
+	{ "6.8.0", "6.8.0", NULL, NULL },
+	{ "4.4.", "4.4", NULL, NULL },
+	{ "4.19.157-perf+", "4.19.157", NULL, "perf+" },
+	{ "5.10.0+", "5.10.0", NULL, "+" },
+	{ "", NULL, NULL, NULL },
+};
+
+static void
+test_kernel_release (void)
+{
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (release_cases); i++) {
+		const gchar *release = release_cases[i].release;
+		OsVersionKernelRelease out;
+
+		g_test_message ("Release: %s", release);
+		os_version_kernel_release_tokenize (release, -1, &out);
+
+		assert_span (release, out.version, release_cases[i].version);
+		assert_span (release, out.abi, release_cases[i].abi);
+		assert_span (release, out.flavour, release_cases[i].flavour);
+	}
+}
+
+static const struct {
+	const gchar *version;
+	const gchar *build_number;
+	const gchar *build_tag;
+	OsVersionKernelFlags flags;
+	const gchar *build_date;
+	gint64 build_time;
+} version_cases[] = {
+	{ "#45-Ubuntu SMP PREEMPT_DYNAMIC Fri Aug 30 12:02:04 UTC 2024",
+	  "45", "Ubuntu",
+	  OS_VERSION_KERNEL_FLAGS_SMP | OS_VERSION_KERNEL_FLAGS_PREEMPT_DYNAMIC,
+	  "Fri Aug 30 12:02:04 UTC 2024", 1725019324 },
+	/* Debian’s ISO date. */
+	{ "#1 SMP PREEMPT_DYNAMIC Debian 6.1.76-1 (2024-02-01)",
+	  "1", NULL,
+	  OS_VERSION_KERNEL_FLAGS_SMP | OS_VERSION_KERNEL_FLAGS_PREEMPT_DYNAMIC,
+	  "2024-02-01", 1706745600 },
+	/* No time zone. */
+	{ "#1 SMP Thu Nov 16 12:34:56 2023",
+	  "1", NULL, OS_VERSION_KERNEL_FLAGS_SMP,
+	  "Thu Nov 16 12:34:56 2023", 1700138096 },
+	{ "#1 SMP PREEMPT_RT",
+	  "1", NULL,
+	  OS_VERSION_KERNEL_FLAGS_SMP | OS_VERSION_KERNEL_FLAGS_PREEMPT_RT,
+	  NULL, -1 },
+	/* Missing date. */
+	{ "#1 SMP PREEMPT",
+	  "1", NULL,
+	  OS_VERSION_KERNEL_FLAGS_SMP | OS_VERSION_KERNEL_FLAGS_PREEMPT,
+	  NULL, -1 },
+	/* Truncated dates are found, but can’t be parsed. */
+	{ "#1 SMP Fri Aug 30 12:02",
+	  "1", NULL, OS_VERSION_KERNEL_FLAGS_SMP,
+	  "Fri Aug 30 12:02", -1 },
+	{ "#1 SMP Fri Aug 30 12:02:04 UTC",
+	  "1", NULL, OS_VERSION_KERNEL_FLAGS_SMP,
+	  "Fri Aug 30 12:02:04 UTC", -1 },
+	{ "#1 SMP Debian 6.1.76-1 (2024-02)",
+	  "1", NULL, OS_VERSION_KERNEL_FLAGS_SMP,
+	  "2024-02", -1 },
+	{ "", NULL, NULL, OS_VERSION_KERNEL_FLAGS_NONE, NULL, -1 },
+};
+
+static void
+test_kernel_version (void)
+{
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (version_cases); i++) {
+		const gchar *version = version_cases[i].version;
+		OsVersionKernelVersion out;
+
+		g_test_message ("Version: %s", version);
+		os_version_kernel_version_tokenize (version, -1, &out);
+
+		assert_span (version, out.build_number,
+		             version_cases[i].build_number);
+		assert_span (version, out.build_tag,
+		             version_cases[i].build_tag);
+		g_assert_cmpuint (out.flags, ==, version_cases[i].flags);
+		assert_span (version, out.build_date,
+		             version_cases[i].build_date);
+		g_assert_cmpint (out.build_time, ==,
+		                 version_cases[i].build_time);
+	}
+}
+
+/* The cache gives the same tokens as tokenizing afresh, including after
+ * strings evict each other from its slots. */
+static void
+test_kernel_cache (void)
+{
+	OsVersionKernelCache *cache;
+	guint round;
+	gsize i;
+
+	cache = os_version_kernel_cache_new (2);
+
+	for (round = 0; round < 3; round++) {
+		for (i = 0; i < G_N_ELEMENTS (version_cases); i++) {
+			const gchar *version = version_cases[i].version;
+			OsVersionKernelVersion out, expected;
+
+			os_version_kernel_version_tokenize (version, -1,
+			                                    &expected);
+			os_version_kernel_cache_tokenize_version (cache, version,
+			                                          &out);
+			g_assert_cmpmem (&out, sizeof (out),
+			                 &expected, sizeof (expected));
+		}
+	}
+
+	os_version_kernel_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/kernel/release", test_kernel_release);
+	g_test_add_func ("/kernel/version", test_kernel_version);
+	g_test_add_func ("/kernel/cache", test_kernel_cache);
+
+	return g_test_run ();
+}
@@ -0,0 +1,186 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion-probe.h"
+#include "osversion-private.h"
+
+
+/* Real contents of vulnerabilities files, including the prefixes added under
+ * KVM and on older kernels, and some which are not understood. */
+static const struct {
+	const gchar *contents;
+	OsVersionCpuVulnerabilityStatus status;
+} vulnerability_cases[] = {
+	{ "Not affected\n", OS_VERSION_CPU_VULNERABILITY_STATUS_NOT_AFFECTED },
+	{ "Mitigation: PTI\n", OS_VERSION_CPU_VULNERABILITY_STATUS_MITIGATED },
+	{ "Mitigation: Clear CPU buffers; SMT vulnerable\n",
+	  OS_VERSION_CPU_VULNERABILITY_STATUS_MITIGATED },
+	{ "Vulnerable\n", OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE },
+	{ "Vulnerable: Clear CPU buffers attempted, no microcode\n",
+	  OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE },
+	{ "Processor vulnerable\n",
+	  OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE },
+	{ "KVM: Mitigation: VMX disabled\n",
+	  OS_VERSION_CPU_VULNERABILITY_STATUS_MITIGATED },
+	{ "KVM: Vulnerable\n", OS_VERSION_CPU_VULNERABILITY_STATUS_VULNERABLE },
+	{ "KVM: Not affected\n",
+	  OS_VERSION_CPU_VULNERABILITY_STATUS_NOT_AFFECTED },
+	{ "KVM: Unknown\n", OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN },
+	{ "KVM:Vulnerable\n", OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN },
+	{ "Unknown: No mitigations\n",
+	  OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN },
+	{ "vulnerable\n", OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN },
+	{ " Mitigation: PTI\n", OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN },
+	{ "", OS_VERSION_CPU_VULNERABILITY_STATUS_UNKNOWN },
+};
+
+static void
+test_probe_vulnerability_parse (void)
+{
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (vulnerability_cases); i++) {
+		const gchar *contents = vulnerability_cases[i].contents;
+		OsVersionCpuVulnerabilityStatus status;
+
+		g_test_message ("Contents: %s", contents);
+		status = os_version_parse_cpu_vulnerability_status (contents);
+		g_assert_cmpint (status, ==, vulnerability_cases[i].status);
+	}
+}
+
+/* The status of each vulnerability matches its character in the string. */
+static void
+test_probe_vulnerability_status (void)
+{
+	const gchar *chars = os_version_get_cpu_vulnerabilities ();
+	guint i;
+
+	g_assert_cmpuint (strlen (chars), ==, OS_VERSION_N_CPU_VULNERABILITIES);
+
+	for (i = 0; i < OS_VERSION_N_CPU_VULNERABILITIES; i++) {
+		OsVersionCpuVulnerabilityStatus status;
+
+		status = os_version_get_cpu_vulnerability_status (i);
+		g_assert_cmpint (chars[i], ==, "-NMV"[status]);
+	}
+}
+
+/* Contents of /sys/kernel/mm/transparent_hugepage/enabled, and of other files
+ * in the same format. */
+static const struct {
+	const gchar *contents;
+	const gchar *option;
+} selected_option_cases[] = {
+	{ "always [madvise] never", "madvise" },
+	{ "[always] madvise never", "always" },
+	{ "always madvise [never]", "never" },
+	{ "always within_size advise [never] deny force", "never" },
+	{ "[]", "" },
+	{ "always madvise never", NULL },
+	{ "always [madvise never", NULL },
+	{ "always madvise] never", NULL },
+	{ "", NULL },
+};
+
+static void
+test_probe_selected_option (void)
+{
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (selected_option_cases); i++) {
+		const gchar *contents = selected_option_cases[i].contents;
+		gchar *option;
+
+		g_test_message ("Contents: %s", contents);
+		option = os_version_parse_selected_option (contents);
+		g_assert_cmpstr (option, ==, selected_option_cases[i].option);
+		g_free (option);
+	}
+}
+
+static const gchar meminfo_fixture[] =
+	"MemTotal:       16131516 kB\n"
+	"MemFree:         1043208 kB\n"
+	"AnonHugePages:     43008 kB\n"
+	"HugePages_Total:      16\n"
+	"HugePages_Free:       12\n"
+	"HugePages_Rsvd:        0\n"
+	"HugePages_Surp:        0\n"
+	"Hugepagesize:       2048 kB\n"
+	"Hugetlb:           32768 kB\n"
+	"DirectMap1G:     2097152 kB";
+
+/* Keys must match a whole key at the start of a line, including the first
+ * and last lines; values in kB are converted to bytes. */
+static const struct {
+	const gchar *key;
+	guint64 value;
+} meminfo_cases[] = {
+	{ "MemTotal", G_GUINT64_CONSTANT (16131516) * 1024 },
+	{ "HugePages_Total", 16 },
+	{ "HugePages_Free", 12 },
+	{ "Hugepagesize", 2048 * 1024 },
+	{ "DirectMap1G", G_GUINT64_CONSTANT (2097152) * 1024 },
+	{ "HugePages", 0 },
+	{ "Hugepage", 0 },
+	{ "Total", 0 },
+	{ "Missing", 0 },
+};
+
+static void
+test_probe_meminfo (void)
+{
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (meminfo_cases); i++) {
+		const gchar *key = meminfo_cases[i].key;
+
+		g_test_message ("Key: %s", key);
+		g_assert_cmpuint (os_version_get_meminfo_value (meminfo_fixture,
+		                                                key),
+		                  ==, meminfo_cases[i].value);
+	}
+
+	g_assert_cmpuint (os_version_get_meminfo_value ("", "MemTotal"), ==,
+	                  0);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/probe/vulnerability/parse",
+	                 test_probe_vulnerability_parse);
+	g_test_add_func ("/probe/vulnerability/status",
+	                 test_probe_vulnerability_status);
+	g_test_add_func ("/probe/selected-option", test_probe_selected_option);
+	g_test_add_func ("/probe/meminfo", test_probe_meminfo);
+
+	return g_test_run ();
+}
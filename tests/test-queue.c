@@ -0,0 +1,347 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "osversion-queue.h"
+
+
+#ifdef G_OS_UNIX
+
+typedef struct {
+	gchar *tmp_dir;
+	gchar *spool_path;
+	gint fds[2];  /* a pipe or socket pair; [1] is used as the sink */
+} Fixture;
+
+static void
+setup (Fixture *fixture, gconstpointer user_data)
+{
+	GError *error = NULL;
+
+	fixture->tmp_dir = g_dir_make_tmp ("osversion-queue-XXXXXX", &error);
+	g_assert_no_error (error);
+	fixture->spool_path = g_build_filename (fixture->tmp_dir, "spool",
+	                                        NULL);
+	fixture->fds[0] = fixture->fds[1] = -1;
+}
+
+static void
+teardown (Fixture *fixture, gconstpointer user_data)
+{
+	if (fixture->fds[0] >= 0) {
+		close (fixture->fds[0]);
+		close (fixture->fds[1]);
+	}
+
+	g_unlink (fixture->spool_path);
+	g_rmdir (fixture->tmp_dir);
+	g_free (fixture->spool_path);
+	g_free (fixture->tmp_dir);
+}
+
+/* Read everything which is available from the non-blocking @fd. */
+static gchar *
+read_available (gint fd)
+{
+	GString *data;
+	gchar buffer[4096];
+	gssize n;
+
+	data = g_string_new ("");
+
+	while ((n = read (fd, buffer, sizeof (buffer))) > 0) {
+		g_string_append_len (data, buffer, n);
+	}
+
+	g_assert_true (n == 0 || errno == EAGAIN || errno == EWOULDBLOCK);
+
+	return g_string_free (data, FALSE);
+}
+
+static void
+make_pipe (Fixture *fixture)
+{
+	g_assert_cmpint (pipe (fixture->fds), ==, 0);
+	g_assert_cmpint (fcntl (fixture->fds[0], F_SETFL, O_NONBLOCK), ==, 0);
+}
+
+static gchar *
+get_spool_contents (Fixture *fixture)
+{
+	gchar *contents = NULL;
+	GError *error = NULL;
+
+	g_file_get_contents (fixture->spool_path, &contents, NULL, &error);
+	g_assert_no_error (error);
+
+	return contents;
+}
+
+/* When the queue is full, records with duplicates are dropped first: the new
+ * record if it is already queued, otherwise the oldest duplicate. */
+static void
+test_queue_dedupe (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionReportQueue *queue;
+	GError *error = NULL;
+	gchar *sent;
+
+	queue = os_version_report_queue_new (fixture->spool_path, 4);
+
+	g_assert_true (os_version_report_queue_push (queue, "A", -1));
+	g_assert_true (os_version_report_queue_push (queue, "B", -1));
+	g_assert_true (os_version_report_queue_push (queue, "A", -1));
+	g_assert_true (os_version_report_queue_push (queue, "C", -1));
+	g_assert_cmpuint (os_version_report_queue_get_n_queued (queue), ==, 4);
+
+	/* Drops the first A. */
+	g_assert_true (os_version_report_queue_push (queue, "D", -1));
+	/* B is already queued, so the new one is dropped. */
+	g_assert_false (os_version_report_queue_push (queue, "B", -1));
+	/* There are no duplicates left, so the oldest record, B, goes. */
+	g_assert_true (os_version_report_queue_push (queue, "Exx", 1));
+
+	g_assert_cmpuint (os_version_report_queue_get_n_queued (queue), ==, 4);
+	g_assert_cmpuint (os_version_report_queue_get_n_dropped (queue), ==,
+	                  3);
+
+	make_pipe (fixture);
+	os_version_report_queue_set_sink (queue, fixture->fds[1]);
+	g_assert_true (os_version_report_queue_flush (queue, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (os_version_report_queue_get_n_queued (queue), ==, 0);
+
+	sent = read_available (fixture->fds[0]);
+	g_assert_cmpstr (sent, ==, "A\nC\nD\nE\n");
+	g_free (sent);
+
+	os_version_report_queue_free (queue);
+}
+
+/* Records flushed while offline are spooled, and sent ahead of newer records
+ * once there is a sink. */
+static void
+test_queue_offline (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionReportQueue *queue;
+	GError *error = NULL;
+	gchar *contents;
+
+	queue = os_version_report_queue_new (fixture->spool_path, 100);
+
+	/* Flushing an empty queue while offline does nothing. */
+	g_assert_true (os_version_report_queue_flush (queue, &error));
+	g_assert_no_error (error);
+	g_assert_false (g_file_test (fixture->spool_path, G_FILE_TEST_EXISTS));
+
+	os_version_report_queue_push (queue, "one", -1);
+	os_version_report_queue_push (queue, "two", -1);
+	g_assert_true (os_version_report_queue_flush (queue, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (os_version_report_queue_get_n_queued (queue), ==, 0);
+
+	os_version_report_queue_push (queue, "three", -1);
+	g_assert_true (os_version_report_queue_flush (queue, &error));
+	g_assert_no_error (error);
+
+	contents = get_spool_contents (fixture);
+	g_assert_cmpstr (contents, ==, "one\ntwo\nthree\n");
+	g_free (contents);
+
+	/* Back online. */
+	make_pipe (fixture);
+	os_version_report_queue_set_sink (queue, fixture->fds[1]);
+	os_version_report_queue_push (queue, "four", -1);
+	g_assert_true (os_version_report_queue_flush (queue, &error));
+	g_assert_no_error (error);
+
+	contents = read_available (fixture->fds[0]);
+	g_assert_cmpstr (contents, ==, "one\ntwo\nthree\nfour\n");
+	g_free (contents);
+
+	g_assert_false (g_file_test (fixture->spool_path, G_FILE_TEST_EXISTS));
+
+	os_version_report_queue_free (queue);
+}
+
+/* If the spool file cannot be written, the error is returned and the records
+ * stay queued. */
+static void
+test_queue_spool_error (Fixture *fixture, gconstpointer user_data)
+{
+	OsVersionReportQueue *queue;
+	GError *error = NULL;
+	gchar *spool_path;
+
+	spool_path = g_build_filename (fixture->tmp_dir, "missing", "spool",
+	                               NULL);
+	queue = os_version_report_queue_new (spool_path, 100);
+
+	os_version_report_queue_push (queue, "one", -1);
+	g_assert_false (os_version_report_queue_flush (queue, &error));
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+	g_clear_error (&error);
+	g_assert_cmpuint (os_version_report_queue_get_n_queued (queue), ==, 1);
+
+	os_version_report_queue_free (queue);
+	g_free (spool_path);
+}
+
+/* Number of records spooled before, and queued for, a flush to a sink which
+ * only accepts part of the data. */
+typedef struct {
+	guint n_spooled;
+	guint n_queued;
+} PartialWriteData;
+
+/* The sink is a non-blocking socket with a small buffer, so a flush sends
+ * only part of the data and then fails. Everything not sent must be spooled,
+ * starting with the whole record which was cut off, and sent by the next
+ * flush. */
+static void
+test_queue_partial_write (Fixture *fixture, gconstpointer user_data)
+{
+	const PartialWriteData *data = user_data;
+	OsVersionReportQueue *queue;
+	GPtrArray/*<owned string>*/ *expected;
+	GError *error = NULL;
+	gchar *first, *second, *tail, *retry_path;
+	gchar **lines;
+	gint buffer_size = 4096, retry_fd;
+	guint i, n_lines;
+
+	queue = os_version_report_queue_new (fixture->spool_path,
+	                                     data->n_spooled + data->n_queued);
+	expected = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 0; i < data->n_spooled + data->n_queued; i++) {
+		gchar *record = g_strdup_printf ("\"Linux\", \"record %u\"", i);
+
+		os_version_report_queue_push (queue, record, -1);
+		g_ptr_array_add (expected, record);
+
+		/* Spool the first batch while offline. */
+		if (i + 1 == data->n_spooled) {
+			g_assert_true (os_version_report_queue_flush (queue,
+			                                              &error));
+			g_assert_no_error (error);
+		}
+	}
+
+	g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM, 0, fixture->fds),
+	                 ==, 0);
+	g_assert_cmpint (fcntl (fixture->fds[0], F_SETFL, O_NONBLOCK), ==, 0);
+	g_assert_cmpint (fcntl (fixture->fds[1], F_SETFL, O_NONBLOCK), ==, 0);
+	setsockopt (fixture->fds[1], SOL_SOCKET, SO_SNDBUF, &buffer_size,
+	            sizeof (buffer_size));
+
+	os_version_report_queue_set_sink (queue, fixture->fds[1]);
+	g_assert_false (os_version_report_queue_flush (queue, &error));
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_AGAIN);
+	g_clear_error (&error);
+	g_assert_cmpuint (os_version_report_queue_get_n_queued (queue), ==, 0);
+
+	first = read_available (fixture->fds[0]);
+	g_assert_cmpuint (strlen (first), >, 0);
+
+	/* Retry into a file, which accepts everything. */
+	retry_path = g_build_filename (fixture->tmp_dir, "retry", NULL);
+	retry_fd = g_open (retry_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	g_assert_cmpint (retry_fd, >=, 0);
+
+	os_version_report_queue_set_sink (queue, retry_fd);
+	g_assert_true (os_version_report_queue_flush (queue, &error));
+	g_assert_no_error (error);
+	g_assert_false (g_file_test (fixture->spool_path, G_FILE_TEST_EXISTS));
+	close (retry_fd);
+
+	g_file_get_contents (retry_path, &second, NULL, &error);
+	g_assert_no_error (error);
+
+	/* The second connection starts with a whole record, which may repeat
+	 * the record cut off at the end of the first. */
+	tail = strrchr (first, '\n');
+	tail = (tail != NULL) ? tail + 1 : first;
+	g_assert_true (g_str_has_prefix (second, tail));
+	*tail = '\0';
+
+	tail = g_strconcat (first, second, NULL);
+	lines = g_strsplit (tail, "\n", -1);
+	n_lines = g_strv_length (lines);
+
+	g_assert_cmpuint (n_lines, ==, expected->len + 1);
+	g_assert_cmpstr (lines[n_lines - 1], ==, "");
+
+	for (i = 0; i < expected->len; i++) {
+		g_assert_cmpstr (lines[i], ==, expected->pdata[i]);
+	}
+
+	g_strfreev (lines);
+	g_free (tail);
+	g_free (second);
+	g_free (first);
+	g_unlink (retry_path);
+	g_free (retry_path);
+	g_ptr_array_unref (expected);
+	os_version_report_queue_free (queue);
+}
+
+#endif /* G_OS_UNIX */
+
+int
+main (int argc, char *argv[])
+{
+#ifdef G_OS_UNIX
+	/* Cut off in the spool file, and in the queued records. */
+	static const PartialWriteData cut_in_spool = { 5000, 10 };
+	static const PartialWriteData cut_in_queue = { 1, 5000 };
+#endif
+
+	g_test_init (&argc, &argv, NULL);
+
+#ifdef G_OS_UNIX
+	g_test_add ("/queue/dedupe", Fixture, NULL, setup, test_queue_dedupe,
+	            teardown);
+	g_test_add ("/queue/offline", Fixture, NULL, setup,
+	            test_queue_offline, teardown);
+	g_test_add ("/queue/spool-error", Fixture, NULL, setup,
+	            test_queue_spool_error, teardown);
+	g_test_add ("/queue/partial-write/spool", Fixture, &cut_in_spool,
+	            setup, test_queue_partial_write, teardown);
+	g_test_add ("/queue/partial-write/queue", Fixture, &cut_in_queue,
+	            setup, test_queue_partial_write, teardown);
+#endif
+
+	return g_test_run ();
+}
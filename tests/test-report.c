@@ -0,0 +1,185 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <sys/uio.h>
+#endif
+
+#include "osversion.h"
+#include "osversion-probe.h"
+
+
+/* Concatenating the segments gives get_os_version(), and the array is cached
+ * between calls. */
+static void
+test_report_iov (void)
+{
+#ifdef G_OS_UNIX
+	const struct iovec *iov;
+	GString *concatenated;
+	gchar *expected;
+	gsize i, n_iov, n_iov_again, n_fields;
+
+	iov = os_version_get_report_iov (&n_iov);
+	os_version_get_fields (&n_fields);
+	g_assert_cmpuint (n_iov, ==, 2 * n_fields + 1);
+
+	concatenated = g_string_new ("");
+
+	for (i = 0; i < n_iov; i++) {
+		g_string_append_len (concatenated, iov[i].iov_base,
+		                     iov[i].iov_len);
+	}
+
+	expected = get_os_version ();
+	g_assert_cmpstr (concatenated->str, ==, expected);
+	g_free (expected);
+	g_string_free (concatenated, TRUE);
+
+	g_assert_true (os_version_get_report_iov (&n_iov_again) == iov);
+	g_assert_cmpuint (n_iov_again, ==, n_iov);
+#else
+	g_test_skip ("struct iovec is only available on Unix");
+#endif
+}
+
+/* The log fields are the names from os_version_get_field_names() and the
+ * values from os_version_get_fields(), in order. */
+static void
+test_report_log_fields (void)
+{
+#if GLIB_CHECK_VERSION (2, 50, 0)
+	const GLogField *log_fields;
+	const gchar * const *fields, * const *names;
+	gsize i, n_log_fields, n_fields, n_names;
+
+	log_fields = os_version_get_log_fields (&n_log_fields);
+	fields = os_version_get_fields (&n_fields);
+	names = os_version_get_field_names (&n_names);
+
+	g_assert_cmpuint (n_fields, >, 0);
+	g_assert_cmpuint (n_log_fields, ==, n_fields);
+	g_assert_cmpuint (n_names, ==, n_fields);
+
+	for (i = 0; i < n_log_fields; i++) {
+		g_assert_cmpstr (log_fields[i].key, ==, names[i]);
+
+		if (log_fields[i].length < 0) {
+			g_assert_cmpstr (log_fields[i].value, ==, fields[i]);
+		} else {
+			g_assert_cmpmem (log_fields[i].value,
+			                 log_fields[i].length,
+			                 fields[i], strlen (fields[i]));
+		}
+	}
+#else
+	g_test_skip ("GLogField needs GLib 2.50");
+#endif
+}
+
+/* The variant maps each field name to its value as a bytestring, unchanged,
+ * and round-trips through its serialised form. */
+static void
+test_report_variant (void)
+{
+	GVariant *variant, *loaded;
+	GBytes *data;
+	const gchar * const *fields, * const *names;
+	gsize i, n_fields;
+
+	variant = os_version_get_variant ();
+	fields = os_version_get_fields (&n_fields);
+	names = os_version_get_field_names (NULL);
+
+	g_assert_cmpstr (g_variant_get_type_string (variant), ==, "a{say}");
+	g_assert_cmpuint (g_variant_n_children (variant), ==, n_fields);
+
+	data = g_variant_get_data_as_bytes (variant);
+	loaded = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE ("a{say}"),
+	                                                       data, TRUE));
+
+	for (i = 0; i < n_fields; i++) {
+		const gchar *name;
+		GVariant *value;
+
+		g_variant_get_child (loaded, i, "{&s@ay}", &name, &value);
+		g_assert_cmpstr (name, ==, names[i]);
+		g_assert_cmpstr (g_variant_get_bytestring (value), ==,
+		                 fields[i]);
+		g_variant_unref (value);
+	}
+
+	g_variant_unref (loaded);
+	g_bytes_unref (data);
+	g_variant_unref (variant);
+}
+
+/* The kernel capabilities field is appended only when it is requested, after
+ * the fields of get_os_version(). */
+static void
+test_report_caps (void)
+{
+	gchar *report, *expected, *caps;
+	gchar **fields;
+	gsize n_fields;
+	GError *error = NULL;
+
+	os_version_get_fields (&n_fields);
+	expected = get_os_version ();
+
+	report = os_version_get_report (OS_VERSION_REPORT_FLAGS_NONE);
+	g_assert_cmpstr (report, ==, expected);
+	g_free (report);
+
+	report = os_version_get_report (OS_VERSION_REPORT_FLAGS_KERNEL_CAPS);
+	g_assert_true (g_str_has_prefix (report, expected));
+
+	fields = os_version_parse (report, -1, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (g_strv_length (fields), ==, n_fields + 1);
+
+	caps = g_strdup_printf ("%x", os_version_get_kernel_caps ());
+	g_assert_cmpstr (fields[n_fields], ==, caps);
+
+	g_free (caps);
+	g_strfreev (fields);
+	g_free (report);
+	g_free (expected);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/report/iov", test_report_iov);
+	g_test_add_func ("/report/log-fields", test_report_log_fields);
+	g_test_add_func ("/report/variant", test_report_variant);
+	g_test_add_func ("/report/caps", test_report_caps);
+
+	return g_test_run ();
+}
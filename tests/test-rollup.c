@@ -0,0 +1,242 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <glib.h>
+
+#include "osversion-rollup.h"
+
+
+#define HOUR 3600
+#define DAY (24 * HOUR)
+
+/* Assert that bucket @index starts at @start, is @width wide, and contains
+ * exactly the (key, count) pairs in @expected, which must be sorted by key. */
+static void
+assert_bucket (OsVersionRollup *rollup,
+               guint index,
+               gint64 start,
+               gint64 width,
+               const OsVersionRollupEntry *expected,
+               gsize n_expected)
+{
+	const OsVersionRollupEntry *entries;
+	gint64 bucket_start, bucket_width;
+	gsize n_entries, i;
+
+	entries = os_version_rollup_get_bucket (rollup, index, &bucket_start,
+	                                        &bucket_width, &n_entries);
+	g_assert_cmpint (bucket_start, ==, start);
+	g_assert_cmpint (bucket_width, ==, width);
+	g_assert_cmpuint (n_entries, ==, n_expected);
+
+	for (i = 0; i < n_entries; i++) {
+		g_assert_cmpuint (entries[i].key, ==, expected[i].key);
+		g_assert_cmpuint (entries[i].count, ==, expected[i].count);
+	}
+}
+
+/* Timestamps are bucketed on multiples of the width from the epoch, including
+ * before it, and buckets are kept in time order whatever order the reports
+ * arrive in. */
+static void
+test_rollup_bucketing (void)
+{
+	OsVersionRollup *rollup;
+	const OsVersionRollupEntry first[] = { { 1, 2 }, { 7, 1 } };
+	const OsVersionRollupEntry second[] = { { 3, 5 } };
+	const OsVersionRollupEntry before_epoch[] = { { 1, 1 } };
+
+	rollup = os_version_rollup_new (HOUR);
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==, 0);
+
+	os_version_rollup_add (rollup, 10 * HOUR + 5, 7, 1);
+	os_version_rollup_add (rollup, 10 * HOUR + HOUR - 1, 1, 1);
+	os_version_rollup_add (rollup, 12 * HOUR, 3, 5);
+	os_version_rollup_add (rollup, 10 * HOUR, 1, 1);
+	os_version_rollup_add (rollup, -1, 1, 1);
+
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==, 3);
+	assert_bucket (rollup, 0, -HOUR, HOUR, before_epoch,
+	               G_N_ELEMENTS (before_epoch));
+	assert_bucket (rollup, 1, 10 * HOUR, HOUR, first, G_N_ELEMENTS (first));
+	assert_bucket (rollup, 2, 12 * HOUR, HOUR, second,
+	               G_N_ELEMENTS (second));
+
+	g_assert_cmpuint (os_version_rollup_count (rollup, 0, 24 * HOUR, 1), ==,
+	                  2);
+	g_assert_cmpuint (os_version_rollup_count (rollup, -HOUR, 24 * HOUR, 1),
+	                  ==, 3);
+	g_assert_cmpuint (os_version_rollup_count (rollup, 11 * HOUR,
+	                                           12 * HOUR, 3), ==, 0);
+	g_assert_cmpuint (os_version_rollup_count (rollup, 11 * HOUR,
+	                                           13 * HOUR, 3), ==, 5);
+	g_assert_cmpuint (os_version_rollup_count (rollup, 0, 24 * HOUR, 2), ==,
+	                  0);
+
+	os_version_rollup_free (rollup);
+}
+
+/* Counts added in any order, enough to trigger several incremental merges and
+ * interleaved with reads, match a straightforward hash table count. */
+static void
+test_rollup_incremental_merge (void)
+{
+	OsVersionRollup *rollup;
+	GHashTable/*<owned guint64, owned guint64>*/ *expected[4];
+	guint i, bucket;
+
+	rollup = os_version_rollup_new (HOUR);
+
+	for (bucket = 0; bucket < G_N_ELEMENTS (expected); bucket++) {
+		expected[bucket] = g_hash_table_new_full (g_int64_hash,
+		                                          g_int64_equal,
+		                                          g_free, g_free);
+	}
+
+	for (i = 0; i < 50000; i++) {
+		guint64 key = g_test_rand_int_range (0, 3000);
+		guint64 count = g_test_rand_int_range (1, 4);
+		guint64 *total;
+
+		bucket = g_test_rand_int_range (0, G_N_ELEMENTS (expected));
+		os_version_rollup_add (rollup,
+		                       bucket * HOUR +
+		                       g_test_rand_int_range (0, HOUR),
+		                       key, count);
+
+		total = g_hash_table_lookup (expected[bucket], &key);
+
+		if (total == NULL) {
+			guint64 *owned_key = g_new (guint64, 1);
+
+			*owned_key = key;
+			total = g_new0 (guint64, 1);
+			g_hash_table_insert (expected[bucket], owned_key, total);
+		}
+
+		*total += count;
+
+		/* Reading a bucket merges its pending counts early. */
+		if (i % 7919 == 0) {
+			os_version_rollup_count (rollup, 0, DAY, key);
+		}
+	}
+
+	os_version_rollup_flush (rollup);
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==,
+	                  G_N_ELEMENTS (expected));
+
+	for (bucket = 0; bucket < G_N_ELEMENTS (expected); bucket++) {
+		const OsVersionRollupEntry *entries;
+		gsize n_entries, j;
+
+		entries = os_version_rollup_get_bucket (rollup, bucket, NULL,
+		                                        NULL, &n_entries);
+		g_assert_cmpuint (n_entries, ==,
+		                  g_hash_table_size (expected[bucket]));
+
+		for (j = 0; j < n_entries; j++) {
+			const guint64 *total;
+
+			if (j > 0) {
+				g_assert_cmpuint (entries[j - 1].key, <,
+				                  entries[j].key);
+			}
+
+			total = g_hash_table_lookup (expected[bucket],
+			                             &entries[j].key);
+			g_assert_nonnull (total);
+			g_assert_cmpuint (entries[j].count, ==, *total);
+		}
+
+		g_hash_table_unref (expected[bucket]);
+	}
+
+	os_version_rollup_free (rollup);
+}
+
+/* Compaction merges old hourly buckets into daily ones, summing counts for
+ * the same key, and leaves recent buckets alone. */
+static void
+test_rollup_compact (void)
+{
+	OsVersionRollup *rollup;
+	const OsVersionRollupEntry day0[] = { { 1, 3 }, { 2, 1 }, { 5, 4 } };
+	const OsVersionRollupEntry day1[] = { { 1, 1 } };
+	const OsVersionRollupEntry recent[] = { { 2, 6 } };
+	const OsVersionRollupEntry two_days[] = {
+		{ 1, 4 }, { 2, 1 }, { 5, 4 }, { 9, 1 },
+	};
+	guint i;
+
+	rollup = os_version_rollup_new (HOUR);
+
+	for (i = 0; i < 3; i++) {
+		os_version_rollup_add (rollup, i * HOUR, 1, 1);
+	}
+
+	os_version_rollup_add (rollup, 5 * HOUR, 2, 1);
+	os_version_rollup_add (rollup, 23 * HOUR, 5, 4);
+	os_version_rollup_add (rollup, DAY + 2 * HOUR, 1, 1);
+	os_version_rollup_add (rollup, 2 * DAY + HOUR, 2, 6);
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==, 7);
+
+	/* The third day does not end before the cutoff, so stays hourly. */
+	os_version_rollup_compact (rollup, 2 * DAY + 12 * HOUR, DAY);
+
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==, 3);
+	assert_bucket (rollup, 0, 0, DAY, day0, G_N_ELEMENTS (day0));
+	assert_bucket (rollup, 1, DAY, DAY, day1, G_N_ELEMENTS (day1));
+	assert_bucket (rollup, 2, 2 * DAY + HOUR, HOUR, recent,
+	               G_N_ELEMENTS (recent));
+
+	g_assert_cmpuint (os_version_rollup_count (rollup, 0, DAY, 1), ==, 3);
+	g_assert_cmpuint (os_version_rollup_count (rollup, 0, 3 * DAY, 2), ==,
+	                  7);
+
+	/* Late reports for a compacted day go into its daily bucket. */
+	os_version_rollup_add (rollup, 20 * HOUR, 9, 1);
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==, 3);
+
+	/* Compacted buckets can be compacted again into coarser ones. */
+	os_version_rollup_compact (rollup, 2 * DAY, 2 * DAY);
+	g_assert_cmpuint (os_version_rollup_get_n_buckets (rollup), ==, 2);
+	assert_bucket (rollup, 0, 0, 2 * DAY, two_days, G_N_ELEMENTS (two_days));
+	assert_bucket (rollup, 1, 2 * DAY + HOUR, HOUR, recent,
+	               G_N_ELEMENTS (recent));
+
+	os_version_rollup_free (rollup);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/rollup/bucketing", test_rollup_bucketing);
+	g_test_add_func ("/rollup/incremental-merge",
+	                 test_rollup_incremental_merge);
+	g_test_add_func ("/rollup/compact", test_rollup_compact);
+
+	return g_test_run ();
+}
@@ -0,0 +1,513 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+
+/* Property-based tests that every formatter and parser pair round-trips random
+ * field sets, and that the fast paths give the same results, byte for byte,
+ * as straightforward reference implementations. GTest prints
+ * the random seed; rerun with --seed to reproduce a failure. */
+
+/* For strverscmp(). */
+#define _GNU_SOURCE
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-codec.h"
+#include "osversion-intern.h"
+
+
+/* Number of random cases per test. */
+#define N_CASES (g_test_quick () ? 5000 : 50000)
+
+/* Fragments which exercise the escaping: separators, quotes, backslashes,
+ * control characters, and valid, invalid and control UTF-8 sequences. */
+static const gchar * const atoms[] = {
+	"\"", "\\", ",", ", ", "\", \"", " ", "\n", "\r", "\t", "\b", "\f",
+	"\v", "\001", "\037", "\177",
+	"\303\251",  /* U+00E9 */
+	"\342\202\254",  /* U+20AC */
+	"\360\237\230\200",  /* U+1F600 */
+	"\302\205",  /* U+0085, a C1 control character */
+	"\302\240",  /* U+00A0, the first character copied through */
+	"\357\277\277",  /* U+FFFF */
+	"\303",  /* truncated sequence */
+	"\200",  /* stray continuation byte */
+	"\300\200",  /* overlong encoding */
+	"\355\240\200",  /* surrogate */
+	"\364\220\200\200",  /* beyond U+10FFFF */
+	"\377",
+};
+
+/* Characters for version strings, so that digit runs, leading zeros and
+ * separators are common. */
+static const gchar version_alphabet[] = "0123456789.-a";
+
+/* A random field: a mixture of atoms and runs of plain ASCII of random
+ * lengths, so that special bytes fall at every offset within a word; or
+ * occasionally, arbitrary non-nul bytes. */
+static gchar *
+new_random_field (void)
+{
+	GString *field;
+	guint i, n_parts;
+
+	field = g_string_new ("");
+
+	if (g_test_rand_int_range (0, 8) == 0) {
+		guint length = g_test_rand_int_range (0, 40);
+
+		for (i = 0; i < length; i++) {
+			g_string_append_c (field,
+			                   (gchar) g_test_rand_int_range (1, 256));
+		}
+
+		return g_string_free (field, FALSE);
+	}
+
+	n_parts = g_test_rand_int_range (0, 8);
+
+	for (i = 0; i < n_parts; i++) {
+		guint j, length;
+
+		if (g_test_rand_bit ()) {
+			j = g_test_rand_int_range (0, G_N_ELEMENTS (atoms));
+			g_string_append (field, atoms[j]);
+			continue;
+		}
+
+		length = g_test_rand_int_range (0, 20);
+
+		for (j = 0; j < length; j++) {
+			g_string_append_c (field,
+			                   (gchar) g_test_rand_int_range (0x20,
+			                                                  0x7f));
+		}
+	}
+
+	return g_string_free (field, FALSE);
+}
+
+static gchar **
+new_random_fields (void)
+{
+	gchar **fields;
+	guint i, n_fields;
+
+	n_fields = g_test_rand_int_range (0, 10);
+	fields = g_new0 (gchar *, n_fields + 1);
+
+	for (i = 0; i < n_fields; i++) {
+		fields[i] = new_random_field ();
+	}
+
+	return fields;
+}
+
+static gchar *
+new_random_version (guint max_length)
+{
+	GString *version;
+	guint i, length;
+
+	version = g_string_new ("");
+	length = g_test_rand_int_range (0, max_length + 1);
+
+	for (i = 0; i < length; i++) {
+		guint j;
+
+		j = g_test_rand_int_range (0, sizeof (version_alphabet) - 1);
+		g_string_append_c (version, version_alphabet[j]);
+	}
+
+	return g_string_free (version, FALSE);
+}
+
+/* The report format, as built by get_os_version(). */
+static gchar *
+reference_format (const gchar * const *fields)
+{
+	GString *report;
+	guint i;
+
+	report = g_string_new ("");
+
+	for (i = 0; fields[i] != NULL; i++) {
+		gchar *escaped = g_strescape (fields[i], "");
+
+		g_string_append_printf (report, "%s\"%s\"",
+		                        (i > 0) ? ", " : "", escaped);
+		g_free (escaped);
+	}
+
+	return g_string_free (report, FALSE);
+}
+
+/* The report format with %OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8, built one
+ * byte or character at a time. */
+static gchar *
+reference_format_utf8 (const gchar * const *fields)
+{
+	GString *report;
+	guint i;
+
+	report = g_string_new ("");
+
+	for (i = 0; fields[i] != NULL; i++) {
+		const gchar *p, *end;
+
+		g_string_append (report, (i > 0) ? ", \"" : "\"");
+
+		for (p = fields[i], end = p + strlen (p); p < end; p++) {
+			guchar c = *p;
+			gunichar ch;
+
+			ch = g_utf8_get_char_validated (p, end - p);
+
+			if (c >= 0x80 && ch != (gunichar) -1 &&
+			    ch != (gunichar) -2 && ch >= 0xa0) {
+				const gchar *next = g_utf8_next_char (p);
+
+				g_string_append_len (report, p, next - p);
+				p = next - 1;
+			} else if (c == '"' || c == '\\') {
+				g_string_append_c (report, '\\');
+				g_string_append_c (report, c);
+			} else if (c == '\b') {
+				g_string_append (report, "\\b");
+			} else if (c == '\f') {
+				g_string_append (report, "\\f");
+			} else if (c == '\n') {
+				g_string_append (report, "\\n");
+			} else if (c == '\r') {
+				g_string_append (report, "\\r");
+			} else if (c == '\t') {
+				g_string_append (report, "\\t");
+			} else if (c < 0x20 || c >= 0x7f) {
+				g_string_append_printf (report, "\\%03o", c);
+			} else {
+				g_string_append_c (report, c);
+			}
+		}
+
+		g_string_append_c (report, '"');
+	}
+
+	return g_string_free (report, FALSE);
+}
+
+static void
+assert_fields_equal (gchar **fields, gchar **expected)
+{
+	guint i;
+
+	g_assert_nonnull (fields);
+	g_assert_cmpuint (g_strv_length (fields), ==,
+	                  g_strv_length (expected));
+
+	for (i = 0; expected[i] != NULL; i++) {
+		g_assert_cmpstr (fields[i], ==, expected[i]);
+	}
+}
+
+/* os_version_format() matches get_os_version()’s formatting, and
+ * os_version_parse() reverses it. */
+static void
+test_format_escaped (void)
+{
+	guint i;
+
+	for (i = 0; i < N_CASES; i++) {
+		gchar **fields, **parsed;
+		gchar *report, *expected;
+		GError *error = NULL;
+
+		fields = new_random_fields ();
+		report = os_version_format ((const gchar * const *) fields, -1);
+		expected = reference_format ((const gchar * const *) fields);
+		g_assert_cmpstr (report, ==, expected);
+
+		parsed = os_version_parse (report, -1, &error);
+		g_assert_no_error (error);
+		assert_fields_equal (parsed, fields);
+
+		g_strfreev (parsed);
+		g_free (expected);
+		g_free (report);
+		g_strfreev (fields);
+	}
+}
+
+/* The word-at-a-time UTF-8 escaper matches the reference, its output is valid
+ * UTF-8, and os_version_parse() reverses it. */
+static void
+test_format_utf8 (void)
+{
+	guint i;
+
+	for (i = 0; i < N_CASES; i++) {
+		gchar **fields, **parsed;
+		gchar *report, *expected;
+		GError *error = NULL;
+
+		fields = new_random_fields ();
+		report = os_version_format_full ((const gchar * const *) fields,
+		                                 -1,
+		                                 OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8);
+		expected = reference_format_utf8 ((const gchar * const *) fields);
+		g_assert_cmpstr (report, ==, expected);
+		g_assert_true (g_utf8_validate (report, -1, NULL));
+
+		parsed = os_version_parse (report, -1, &error);
+		g_assert_no_error (error);
+		assert_fields_equal (parsed, fields);
+
+		g_strfreev (parsed);
+		g_free (expected);
+		g_free (report);
+		g_strfreev (fields);
+	}
+}
+
+/* The bulk-copying os_version_unescape() matches g_strcompress(), including
+ * when unescaping in place. */
+static void
+test_unescape (void)
+{
+	guint i;
+
+	for (i = 0; i < N_CASES; i++) {
+		gchar *field, *escaped, *expected, *dest;
+		gsize length, n_written;
+
+		field = new_random_field ();
+		escaped = g_strescape (field, "");
+		expected = g_strcompress (escaped);
+		g_assert_cmpstr (expected, ==, field);
+
+		length = strlen (escaped);
+		dest = g_malloc (length + 1);
+		n_written = os_version_unescape (escaped, length, dest);
+		g_assert_cmpmem (dest, n_written, expected, strlen (expected));
+
+		n_written = os_version_unescape (escaped, length, escaped);
+		g_assert_cmpmem (escaped, n_written,
+		                 expected, strlen (expected));
+
+		g_free (dest);
+		g_free (expected);
+		g_free (escaped);
+		g_free (field);
+	}
+}
+
+/* os_version_parse_interned() gives the same fields as os_version_parse(),
+ * for reports in either format. Zero is never a valid identifier. */
+static void
+test_parse_interned (void)
+{
+	OsVersionInternTable *table;
+	guint i;
+
+	table = os_version_intern_table_new ();
+
+	for (i = 0; i < N_CASES; i++) {
+		OsVersionFormatFlags flags;
+		gchar **fields;
+		gchar *report;
+		guint32 *ids;
+		gsize n_fields, j;
+		GError *error = NULL;
+
+		fields = new_random_fields ();
+		flags = g_test_rand_bit () ? OS_VERSION_FORMAT_FLAGS_PRESERVE_UTF8 :
+		                             OS_VERSION_FORMAT_FLAGS_NONE;
+		report = os_version_format_full ((const gchar * const *) fields,
+		                                 -1, flags);
+
+		ids = os_version_parse_interned (table, report, -1, &n_fields,
+		                                 &error);
+		g_assert_no_error (error);
+		g_assert_cmpuint (n_fields, ==, g_strv_length (fields));
+
+		for (j = 0; j < n_fields; j++) {
+			const gchar *value;
+			gsize length;
+
+			g_assert_cmpuint (ids[j], !=, 0);
+			value = os_version_intern_table_get_value (table,
+			                                           ids[j],
+			                                           &length);
+			g_assert_cmpmem (value, length,
+			                 fields[j], strlen (fields[j]));
+		}
+
+		g_free (ids);
+		g_free (report);
+		g_strfreev (fields);
+	}
+
+	g_assert_null (os_version_intern_table_get_value (table, 0, NULL));
+	os_version_intern_table_free (table);
+}
+
+/* Compressed reports decompress to the original. */
+static void
+test_compress (void)
+{
+	guint i;
+
+	for (i = 0; i < N_CASES; i++) {
+		gchar **fields;
+		gchar *report, *decompressed;
+		GBytes *compressed;
+		GError *error = NULL;
+
+		fields = new_random_fields ();
+		report = os_version_format ((const gchar * const *) fields, -1);
+
+		compressed = os_version_compress (report, -1);
+		decompressed = os_version_decompress (compressed, &error);
+		g_assert_no_error (error);
+		g_assert_cmpstr (decompressed, ==, report);
+
+		g_free (decompressed);
+		g_bytes_unref (compressed);
+		g_free (report);
+		g_strfreev (fields);
+	}
+}
+
+/* Deltas against a baseline sharing a random subset of the fields decode to
+ * the original fields. */
+static void
+test_delta (void)
+{
+	guint i;
+
+	for (i = 0; i < N_CASES; i++) {
+		gchar **fields, **baseline, **decoded;
+		GBytes *delta;
+		guint64 baseline_id, decoded_id = 0;
+		guint j, n_fields, n_baseline;
+		GError *error = NULL;
+
+		fields = new_random_fields ();
+		n_fields = g_strv_length (fields);
+		n_baseline = g_test_rand_int_range (0, 10);
+		baseline = g_new0 (gchar *, n_baseline + 1);
+
+		for (j = 0; j < n_baseline; j++) {
+			if (j < n_fields && g_test_rand_bit ()) {
+				baseline[j] = g_strdup (fields[j]);
+			} else {
+				baseline[j] = new_random_field ();
+			}
+		}
+
+		baseline_id = ((guint64) g_test_rand_int () << 32) |
+		              (guint32) g_test_rand_int ();
+		delta = os_version_delta_encode (baseline_id,
+		                                 (const gchar * const *) baseline,
+		                                 -1,
+		                                 (const gchar * const *) fields,
+		                                 -1);
+
+		g_assert_true (os_version_delta_get_baseline_id (delta,
+		                                                 &decoded_id,
+		                                                 &error));
+		g_assert_no_error (error);
+		g_assert_cmpuint (decoded_id, ==, baseline_id);
+
+		decoded = os_version_delta_decode (delta,
+		                                   (const gchar * const *) baseline,
+		                                   -1, &error);
+		g_assert_no_error (error);
+		assert_fields_equal (decoded, fields);
+
+		g_strfreev (decoded);
+		g_bytes_unref (delta);
+		g_strfreev (baseline);
+		g_strfreev (fields);
+	}
+}
+
+static gint
+sign (gint value)
+{
+	return (value > 0) - (value < 0);
+}
+
+/* os_version_compare(), which skips common prefixes a word at a time, agrees
+ * with glibc’s byte-at-a-time strverscmp(). */
+static void
+test_compare (void)
+{
+#ifdef __GLIBC__
+	guint i;
+
+	for (i = 0; i < N_CASES; i++) {
+		gchar *prefix, *suffix_a, *suffix_b, *a, *b;
+
+		/* Share a prefix of up to 40 bytes, so the first difference
+		 * falls at every offset within a word. */
+		prefix = new_random_version (40);
+		suffix_a = new_random_version (12);
+		suffix_b = new_random_version (12);
+		a = g_strconcat (prefix, suffix_a, NULL);
+		b = g_strconcat (prefix, suffix_b, NULL);
+
+		g_assert_cmpint (sign (os_version_compare (a, b)), ==,
+		                 sign (strverscmp (a, b)));
+		g_assert_cmpint (sign (os_version_compare (b, a)), ==,
+		                 sign (strverscmp (b, a)));
+		g_assert_cmpint (os_version_compare (a, a), ==, 0);
+
+		g_free (b);
+		g_free (a);
+		g_free (suffix_b);
+		g_free (suffix_a);
+		g_free (prefix);
+	}
+#else
+	g_test_skip ("strverscmp() is only available with glibc");
+#endif
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/round-trip/format/escaped", test_format_escaped);
+	g_test_add_func ("/round-trip/format/utf8", test_format_utf8);
+	g_test_add_func ("/round-trip/unescape", test_unescape);
+	g_test_add_func ("/round-trip/parse-interned", test_parse_interned);
+	g_test_add_func ("/round-trip/compress", test_compress);
+	g_test_add_func ("/round-trip/delta", test_delta);
+	g_test_add_func ("/round-trip/compare", test_compare);
+
+	return g_test_run ();
+}
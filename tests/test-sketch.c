@@ -0,0 +1,281 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+#include "osversion-sketch.h"
+
+
+static void
+assert_top_k_equal (const OsVersionTopK *a, const OsVersionTopK *b)
+{
+	GArray/*<OsVersionTopKEntry>*/ *entries_a, *entries_b;
+	guint i;
+
+	entries_a = os_version_top_k_get_entries (a);
+	entries_b = os_version_top_k_get_entries (b);
+	g_assert_cmpuint (entries_a->len, ==, entries_b->len);
+
+	for (i = 0; i < entries_a->len; i++) {
+		const OsVersionTopKEntry *entry_a, *entry_b;
+
+		entry_a = &g_array_index (entries_a, OsVersionTopKEntry, i);
+		entry_b = &g_array_index (entries_b, OsVersionTopKEntry, i);
+
+		g_assert_cmpstr (entry_a->report, ==, entry_b->report);
+		g_assert_cmpuint (entry_a->count, ==, entry_b->count);
+		g_assert_cmpuint (entry_a->error, ==, entry_b->error);
+	}
+
+	g_array_unref (entries_b);
+	g_array_unref (entries_a);
+}
+
+static void
+test_top_k_exact (void)
+{
+	OsVersionTopK *top_k;
+	GArray/*<OsVersionTopKEntry>*/ *entries;
+	const OsVersionTopKEntry *entry;
+
+	top_k = os_version_top_k_new (4);
+	os_version_top_k_add (top_k, "\"Linux\"", 3);
+	os_version_top_k_add (top_k, "\"Android\"", 5);
+	os_version_top_k_add (top_k, "\"Linux\"", 4);
+	os_version_top_k_add (top_k, "\"Darwin\"", 0);
+
+	entries = os_version_top_k_get_entries (top_k);
+	g_assert_cmpuint (entries->len, ==, 2);
+
+	entry = &g_array_index (entries, OsVersionTopKEntry, 0);
+	g_assert_cmpstr (entry->report, ==, "\"Linux\"");
+	g_assert_cmpuint (entry->count, ==, 7);
+	g_assert_cmpuint (entry->error, ==, 0);
+
+	entry = &g_array_index (entries, OsVersionTopKEntry, 1);
+	g_assert_cmpstr (entry->report, ==, "\"Android\"");
+	g_assert_cmpuint (entry->count, ==, 5);
+
+	g_array_unref (entries);
+	os_version_top_k_free (top_k);
+}
+
+/* A report making up more than 1/capacity of the stream is always kept, and
+ * its count is never underestimated. */
+static void
+test_top_k_heavy_hitter (void)
+{
+	OsVersionTopK *top_k, *other;
+	GArray/*<OsVersionTopKEntry>*/ *entries;
+	const OsVersionTopKEntry *entry;
+	guint i;
+
+	top_k = os_version_top_k_new (8);
+	other = os_version_top_k_new (8);
+
+	for (i = 0; i < 10000; i++) {
+		gchar *report = g_strdup_printf ("\"Linux\", \"%u\"", i);
+
+		os_version_top_k_add ((i % 2) ? top_k : other, report, 1);
+		os_version_top_k_add ((i % 2) ? top_k : other, "\"Android\"",
+		                      1);
+		g_free (report);
+	}
+
+	os_version_top_k_merge (top_k, other);
+
+	entries = os_version_top_k_get_entries (top_k);
+	entry = &g_array_index (entries, OsVersionTopKEntry, 0);
+	g_assert_cmpstr (entry->report, ==, "\"Android\"");
+	g_assert_cmpuint (entry->count, >=, 10000);
+	g_assert_cmpuint (entry->count - entry->error, <=, 10000);
+
+	g_array_unref (entries);
+	os_version_top_k_free (other);
+	os_version_top_k_free (top_k);
+}
+
+static void
+test_top_k_serialize (void)
+{
+	OsVersionTopK *top_k, *loaded;
+	GBytes *bytes;
+	GError *error = NULL;
+	guint i;
+
+	top_k = os_version_top_k_new (16);
+
+	for (i = 0; i < 1000; i++) {
+		gchar *report = g_strdup_printf ("\"%u\"", (i * i) % 37);
+
+		os_version_top_k_add (top_k, report, i % 3 + 1);
+		g_free (report);
+	}
+
+	bytes = os_version_top_k_serialize (top_k);
+	loaded = os_version_top_k_deserialize (bytes, &error);
+	g_assert_no_error (error);
+	assert_top_k_equal (top_k, loaded);
+
+	g_bytes_unref (bytes);
+	os_version_top_k_free (loaded);
+	os_version_top_k_free (top_k);
+}
+
+static GBytes *
+new_top_k_header (guint32 capacity, guint32 n_counters, gsize padding)
+{
+	guint32 header[] = {
+		GUINT32_TO_LE (0x4b54534f),  /* magic */
+		GUINT32_TO_LE (1),  /* version */
+		GUINT32_TO_LE (capacity),
+		GUINT32_TO_LE (n_counters),
+	};
+	guint8 *data;
+
+	data = g_malloc0 (sizeof (header) + padding);
+	memcpy (data, header, sizeof (header));
+
+	return g_bytes_new_take (data, sizeof (header) + padding);
+}
+
+/* Headers claiming a huge capacity or more entries than the data could hold
+ * must be rejected before anything is allocated for them. */
+static void
+test_top_k_deserialize_invalid (void)
+{
+	struct {
+		guint32 capacity;
+		guint32 n_counters;
+		gsize padding;
+	} vectors[] = {
+		{ 0, 0, 0 },
+		{ G_MAXUINT32, 0, 0 },
+		{ OS_VERSION_TOP_K_MAX_CAPACITY + 1, 0, 0 },
+		{ 4, 5, 200 },
+		{ OS_VERSION_TOP_K_MAX_CAPACITY, OS_VERSION_TOP_K_MAX_CAPACITY,
+		  0 },
+		{ 4, 1, 19 },
+		{ 4, 2, 20 },
+	};
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (vectors); i++) {
+		GBytes *bytes;
+		OsVersionTopK *top_k;
+		GError *error = NULL;
+
+		bytes = new_top_k_header (vectors[i].capacity,
+		                          vectors[i].n_counters,
+		                          vectors[i].padding);
+		top_k = os_version_top_k_deserialize (bytes, &error);
+		g_assert_error (error, OS_VERSION_ERROR,
+		                OS_VERSION_ERROR_INVALID_DATA);
+		g_assert_null (top_k);
+
+		g_clear_error (&error);
+		g_bytes_unref (bytes);
+	}
+}
+
+static void
+test_top_k_deserialize_empty_entries (void)
+{
+	GBytes *bytes;
+	OsVersionTopK *top_k;
+	GArray/*<OsVersionTopKEntry>*/ *entries;
+	GError *error = NULL;
+
+	/* One entry with an empty report, count 0 and error 0. */
+	bytes = new_top_k_header (OS_VERSION_TOP_K_MAX_CAPACITY, 1, 20);
+	top_k = os_version_top_k_deserialize (bytes, &error);
+	g_assert_no_error (error);
+
+	entries = os_version_top_k_get_entries (top_k);
+	g_assert_cmpuint (entries->len, ==, 1);
+	g_assert_cmpstr (g_array_index (entries, OsVersionTopKEntry,
+	                                0).report, ==, "");
+
+	g_array_unref (entries);
+	os_version_top_k_free (top_k);
+	g_bytes_unref (bytes);
+}
+
+static void
+test_hll_estimate (void)
+{
+	OsVersionHll *hll, *other, *loaded;
+	GBytes *bytes;
+	GError *error = NULL;
+	guint i;
+	guint64 estimate;
+
+	hll = os_version_hll_new (14);
+	other = os_version_hll_new (14);
+
+	for (i = 0; i < 100000; i++) {
+		gchar *value = g_strdup_printf ("%u", i);
+
+		os_version_hll_add ((i % 2) ? hll : other, value, -1);
+		/* Duplicates don’t count. */
+		os_version_hll_add (hll, value, -1);
+		g_free (value);
+	}
+
+	os_version_hll_merge (hll, other);
+	estimate = os_version_hll_estimate (hll);
+
+	/* The standard error at precision 14 is 0.8%; allow 5σ. */
+	g_assert_cmpuint (estimate, >, 96000);
+	g_assert_cmpuint (estimate, <, 104000);
+
+	bytes = os_version_hll_serialize (hll);
+	loaded = os_version_hll_deserialize (bytes, &error);
+	g_assert_no_error (error);
+	g_assert_cmpuint (os_version_hll_estimate (loaded), ==, estimate);
+
+	g_bytes_unref (bytes);
+	os_version_hll_free (loaded);
+	os_version_hll_free (other);
+	os_version_hll_free (hll);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/top-k/exact", test_top_k_exact);
+	g_test_add_func ("/top-k/heavy-hitter", test_top_k_heavy_hitter);
+	g_test_add_func ("/top-k/serialize", test_top_k_serialize);
+	g_test_add_func ("/top-k/deserialize/invalid",
+	                 test_top_k_deserialize_invalid);
+	g_test_add_func ("/top-k/deserialize/empty-entries",
+	                 test_top_k_deserialize_empty_entries);
+	g_test_add_func ("/hll/estimate", test_hll_estimate);
+
+	return g_test_run ();
+}
@@ -0,0 +1,275 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "osversion.h"
+
+
+/* Check that os_version_unescape() reverses g_strescape() on @value, both
+ * into a separate buffer and in place. */
+static void
+assert_round_trip (const gchar *value)
+{
+	gchar *escaped, *dest;
+	gsize escaped_length, length;
+
+	escaped = g_strescape (value, "");
+	escaped_length = strlen (escaped);
+
+	dest = g_malloc (escaped_length + 1);
+	length = os_version_unescape (escaped, escaped_length, dest);
+	g_assert_cmpmem (dest, length, value, strlen (value));
+	g_free (dest);
+
+	length = os_version_unescape (escaped, escaped_length, escaped);
+	g_assert_cmpmem (escaped, length, value, strlen (value));
+
+	g_free (escaped);
+}
+
+/* Check that os_version_unescape() gives the same result as g_strcompress()
+ * on @escaped, which must not end in a backslash. g_strcompress() returns a
+ * nul-terminated string, so only compare up to the first nul byte. */
+static void
+assert_matches_strcompress (const gchar *escaped)
+{
+	gchar *expected, *dest;
+	const gchar *nul;
+	gsize length;
+
+	expected = g_strcompress (escaped);
+	dest = g_malloc (strlen (escaped) + 1);
+	length = os_version_unescape (escaped, strlen (escaped), dest);
+
+	nul = memchr (dest, '\0', length);
+
+	if (nul != NULL) {
+		length = nul - dest;
+	}
+
+	g_assert_cmpmem (dest, length, expected, strlen (expected));
+
+	g_free (dest);
+	g_free (expected);
+}
+
+static void
+test_unescape_single_bytes (void)
+{
+	guint c;
+
+	for (c = 1; c <= 0xff; c++) {
+		gchar value[] = { (gchar) c, '\0' };
+
+		assert_round_trip (value);
+	}
+}
+
+static void
+test_unescape_byte_pairs (void)
+{
+	guint c, d;
+
+	for (c = 1; c <= 0xff; c++) {
+		for (d = 1; d <= 0xff; d++) {
+			gchar value[] = { (gchar) c, (gchar) d, '\0' };
+
+			assert_round_trip (value);
+		}
+	}
+}
+
+/* Every escape sequence of up to three characters after the backslash, drawn
+ * from characters which exercise the octal, named and pass-through cases,
+ * between plain bytes. The trailing ‘z’ avoids a trailing backslash, for which
+ * g_strcompress() warns. */
+static void
+test_unescape_strcompress (void)
+{
+	const gchar alphabet[] = "01378btnrfv\\\"xZ";
+	gsize i, j, k, n_chars = strlen (alphabet);
+	guint c;
+
+	for (c = 1; c <= 0xff; c++) {
+		gchar escaped[] = { 'a', '\\', (gchar) c, 'z', '\0' };
+
+		assert_matches_strcompress (escaped);
+	}
+
+	for (i = 0; i < n_chars; i++) {
+		for (j = 0; j < n_chars; j++) {
+			for (k = 0; k < n_chars; k++) {
+				gchar escaped[] = { 'a', '\\', alphabet[i],
+				                    alphabet[j], alphabet[k],
+				                    'z', '\0' };
+
+				assert_matches_strcompress (escaped);
+			}
+		}
+	}
+}
+
+static void
+test_unescape_trailing_backslash (void)
+{
+	gchar dest[8];
+	gsize length;
+
+	length = os_version_unescape ("abc\\", 4, dest);
+	g_assert_cmpmem (dest, length, "abc", 3);
+
+	length = os_version_unescape ("\\", 1, dest);
+	g_assert_cmpuint (length, ==, 0);
+}
+
+static void
+test_unescape_unterminated (void)
+{
+	const gchar source[] = "ab\\nc\\101d";
+	gchar dest[sizeof (source)];
+	gsize length;
+
+	/* The length is respected, even when it ends within an escape. */
+	length = os_version_unescape (source, 7, dest);
+	g_assert_cmpmem (dest, length, "ab\nc\001", 5);
+
+	length = os_version_unescape (source, 0, dest);
+	g_assert_cmpuint (length, ==, 0);
+}
+
+static void
+test_unescape_random (void)
+{
+	guint i, n_iterations = g_test_quick () ? 10000 : 200000;
+
+	for (i = 0; i < n_iterations; i++) {
+		gchar value[65];
+		gsize j, length = g_test_rand_int_range (0, sizeof (value));
+
+		for (j = 0; j < length; j++) {
+			value[j] = (gchar) g_test_rand_int_range (1, 0x100);
+		}
+
+		value[length] = '\0';
+
+		assert_round_trip (value);
+	}
+}
+
+static void
+test_parse_round_trip (void)
+{
+	guint i, n_iterations = g_test_quick () ? 10000 : 100000;
+
+	for (i = 0; i < n_iterations; i++) {
+		GPtrArray/*<owned string>*/ *fields;
+		GString *report;
+		gchar **parsed;
+		GError *error = NULL;
+		guint j, n_fields = g_test_rand_int_range (0, 8);
+
+		fields = g_ptr_array_new_with_free_func (g_free);
+		report = g_string_new ("");
+
+		for (j = 0; j < n_fields; j++) {
+			gchar value[17], *escaped;
+			gsize k, length = g_test_rand_int_range (0,
+			                                         sizeof (value));
+
+			for (k = 0; k < length; k++) {
+				value[k] = (gchar) g_test_rand_int_range (1,
+				                                          0x100);
+			}
+
+			value[length] = '\0';
+
+			/* Format as get_os_version() did originally. */
+			escaped = g_strescape (value, "");
+			g_string_append_printf (report, "%s\"%s\"",
+			                        (j > 0) ? ", " : "", escaped);
+			g_free (escaped);
+
+			g_ptr_array_add (fields, g_strdup (value));
+		}
+
+		g_ptr_array_add (fields, NULL);
+
+		parsed = os_version_parse (report->str, report->len, &error);
+		g_assert_no_error (error);
+		g_assert_cmpuint (g_strv_length (parsed), ==, n_fields);
+
+		for (j = 0; j < n_fields; j++) {
+			g_assert_cmpstr (parsed[j], ==, fields->pdata[j]);
+		}
+
+		g_strfreev (parsed);
+		g_string_free (report, TRUE);
+		g_ptr_array_unref (fields);
+	}
+}
+
+static void
+test_parse_invalid (void)
+{
+	const gchar *reports[] = {
+		"\"unterminated",
+		"\"escaped quote\\\"",
+		"\"a\"\"b\"",
+		"\"a\",\"b\"",
+		"\"a\", \"b",
+	};
+	gsize i;
+
+	for (i = 0; i < G_N_ELEMENTS (reports); i++) {
+		gchar **parsed;
+		GError *error = NULL;
+
+		parsed = os_version_parse (reports[i], -1, &error);
+		g_assert_error (error, OS_VERSION_ERROR,
+		                OS_VERSION_ERROR_INVALID_REPORT);
+		g_assert_null (parsed);
+		g_clear_error (&error);
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/unescape/single-bytes",
+	                 test_unescape_single_bytes);
+	g_test_add_func ("/unescape/byte-pairs", test_unescape_byte_pairs);
+	g_test_add_func ("/unescape/strcompress", test_unescape_strcompress);
+	g_test_add_func ("/unescape/trailing-backslash",
+	                 test_unescape_trailing_backslash);
+	g_test_add_func ("/unescape/unterminated", test_unescape_unterminated);
+	g_test_add_func ("/unescape/random", test_unescape_random);
+	g_test_add_func ("/parse/round-trip", test_parse_round_trip);
+	g_test_add_func ("/parse/invalid", test_parse_invalid);
+
+	return g_test_run ();
+}
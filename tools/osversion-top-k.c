@@ -0,0 +1,319 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * OS version library
+ * Copyright (C) 2014 Collabora Ltd.
+ *
+ * OS version library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * OS version library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with OS version library.
+ * If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Authors:
+ *     Philip Withnall <philip.withnall@collabora.co.uk>
+ */
+
+/* Summarise the most common reports in streams of newline-delimited reports,
+ * as written by get_os_version(), read from files or stdin.
+ *
+ * With --window, a summary of the last --n-windows windows is printed after
+ * each window of reports, giving a sliding view over an unbounded stream.
+ * Summaries can be saved with --output and combined with --merge, so streams
+ * can be summarised by several processes and merged afterwards. Saved
+ * summaries do not record when their reports were seen, so --merge cannot be
+ * used with --window. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "osversion-sketch.h"
+
+
+static gint capacity = 1000;
+static gint n_shown = 20;
+static gint window = 0;
+static gint n_windows = 1;
+static gchar **merge_paths = NULL;
+static gchar *output_path = NULL;
+
+static const GOptionEntry entries[] = {
+	{ "capacity", 'k', 0, G_OPTION_ARG_INT, &capacity,
+	  "Number of distinct reports to track (default: 1000)", "N" },
+	{ "count", 'n', 0, G_OPTION_ARG_INT, &n_shown,
+	  "Number of reports to print (default: 20)", "N" },
+	{ "window", 'w', 0, G_OPTION_ARG_INT, &window,
+	  "Print a summary after every N reports", "N" },
+	{ "n-windows", 'W', 0, G_OPTION_ARG_INT, &n_windows,
+	  "Number of windows each summary covers (default: 1)", "N" },
+	{ "merge", 'm', 0, G_OPTION_ARG_FILENAME_ARRAY, &merge_paths,
+	  "Merge in a summary saved with --output", "FILE" },
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path,
+	  "Save the final summary to FILE", "FILE" },
+	{ NULL, }
+};
+
+static void
+print_summary (const OsVersionTopK *top_k, guint64 n_reports)
+{
+	GArray/*<OsVersionTopKEntry>*/ *top_entries;
+	guint i;
+
+	top_entries = os_version_top_k_get_entries (top_k);
+
+	g_print ("# %" G_GUINT64_FORMAT " reports read; count, maximum "
+	         "overestimate, report:\n", n_reports);
+
+	for (i = 0; i < top_entries->len && i < (guint) n_shown; i++) {
+		const OsVersionTopKEntry *entry;
+
+		entry = &g_array_index (top_entries, OsVersionTopKEntry, i);
+		g_print ("%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t%s\n",
+		         entry->count, entry->error, entry->report);
+	}
+
+	g_array_unref (top_entries);
+}
+
+typedef struct {
+	OsVersionTopK *total;
+	OsVersionTopK **windows;  /* ring of @n_windows summaries */
+	guint current_window;
+	guint64 n_reports;
+	guint64 n_window_reports;
+} Summary;
+
+/* Print the summary of the last @n_windows windows and start a new one. */
+static void
+end_window (Summary *summary)
+{
+	OsVersionTopK *merged;
+	guint i;
+
+	merged = os_version_top_k_new (capacity);
+
+	for (i = 0; i < (guint) n_windows; i++) {
+		os_version_top_k_merge (merged, summary->windows[i]);
+	}
+
+	print_summary (merged, summary->n_reports);
+	os_version_top_k_free (merged);
+
+	summary->current_window = (summary->current_window + 1) % n_windows;
+	os_version_top_k_clear (summary->windows[summary->current_window]);
+	summary->n_window_reports = 0;
+}
+
+static gboolean
+add_stream (Summary *summary, GIOChannel *channel, GError **error)
+{
+	gchar *line;
+	gsize length, terminator_position;
+	GIOStatus status;
+
+	while ((status = g_io_channel_read_line (channel, &line, &length,
+	                                         &terminator_position,
+	                                         error)) ==
+	       G_IO_STATUS_NORMAL) {
+		line[terminator_position] = '\0';
+
+		if (*line != '\0') {
+			OsVersionTopK *current;
+
+			os_version_top_k_add (summary->total, line, 1);
+			summary->n_reports++;
+
+			if (window > 0) {
+				current = summary->windows[summary->current_window];
+				os_version_top_k_add (current, line, 1);
+
+				if (++summary->n_window_reports ==
+				    (guint64) window) {
+					end_window (summary);
+				}
+			}
+		}
+
+		g_free (line);
+	}
+
+	return (status != G_IO_STATUS_ERROR);
+}
+
+/* Add the reports from @path, or from stdin if it is ‘-’. */
+static gboolean
+add_path (Summary *summary, const gchar *path, GError **error)
+{
+	GIOChannel *channel;
+	gboolean success;
+
+	if (strcmp (path, "-") == 0) {
+#ifdef G_OS_WIN32
+		channel = g_io_channel_win32_new_fd (0);
+#else
+		channel = g_io_channel_unix_new (STDIN_FILENO);
+#endif
+	} else {
+		channel = g_io_channel_new_file (path, "r", error);
+
+		if (channel == NULL) {
+			return FALSE;
+		}
+	}
+
+	/* Reports are not necessarily valid UTF-8. */
+	g_io_channel_set_encoding (channel, NULL, NULL);
+
+	success = add_stream (summary, channel, error);
+	g_io_channel_unref (channel);
+
+	return success;
+}
+
+static gboolean
+merge_file (Summary *summary, const gchar *path, GError **error)
+{
+	gchar *contents;
+	gsize length;
+	GBytes *bytes;
+	OsVersionTopK *loaded;
+
+	if (!g_file_get_contents (path, &contents, &length, error)) {
+		return FALSE;
+	}
+
+	bytes = g_bytes_new_take (contents, length);
+	loaded = os_version_top_k_deserialize (bytes, error);
+	g_bytes_unref (bytes);
+
+	if (loaded == NULL) {
+		g_prefix_error (error, "%s: ", path);
+		return FALSE;
+	}
+
+	os_version_top_k_merge (summary->total, loaded);
+	os_version_top_k_free (loaded);
+
+	return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	Summary summary;
+	GError *error = NULL;
+	gint i, status = 0;
+
+	context = g_option_context_new ("[FILE…]");
+	g_option_context_set_summary (context,
+	                              "Summarise the most common reports in "
+	                              "newline-delimited report streams, read "
+	                              "from each FILE, or stdin if no files or "
+	                              "summaries to merge are given.");
+	g_option_context_add_main_entries (context, entries, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+
+		return 2;
+	}
+
+	g_option_context_free (context);
+
+	if (capacity <= 0 || capacity > OS_VERSION_TOP_K_MAX_CAPACITY ||
+	    n_shown < 0 || window < 0 || n_windows <= 0) {
+		g_printerr ("Invalid option value.\n");
+		return 2;
+	}
+
+	if (merge_paths != NULL && window > 0) {
+		g_printerr ("--merge cannot be used with --window.\n");
+		return 2;
+	}
+
+	summary.total = os_version_top_k_new (capacity);
+	summary.windows = g_new0 (OsVersionTopK *, n_windows);
+	summary.current_window = 0;
+	summary.n_reports = 0;
+	summary.n_window_reports = 0;
+
+	for (i = 0; i < n_windows; i++) {
+		summary.windows[i] = os_version_top_k_new (capacity);
+	}
+
+	for (i = 0; merge_paths != NULL && merge_paths[i] != NULL; i++) {
+		if (!merge_file (&summary, merge_paths[i], &error)) {
+			goto error;
+		}
+	}
+
+	/* Read stdin if no files are given, unless only merging. */
+	if (argc < 2 && merge_paths == NULL &&
+	    !add_path (&summary, "-", &error)) {
+		goto error;
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (!add_path (&summary, argv[i], &error)) {
+			goto error;
+		}
+	}
+
+	if (window == 0) {
+		print_summary (summary.total, summary.n_reports);
+	} else if (summary.n_window_reports > 0) {
+		end_window (&summary);
+	}
+
+	if (output_path != NULL) {
+		GBytes *bytes;
+		gconstpointer data;
+		gsize length;
+		gboolean success;
+
+		bytes = os_version_top_k_serialize (summary.total);
+		data = g_bytes_get_data (bytes, &length);
+		success = g_file_set_contents (output_path, data, length,
+		                               &error);
+		g_bytes_unref (bytes);
+
+		if (!success) {
+			goto error;
+		}
+	}
+
+	goto done;
+
+error:
+	g_printerr ("%s\n", error->message);
+	g_error_free (error);
+	status = 1;
+
+done:
+	for (i = 0; i < n_windows; i++) {
+		os_version_top_k_free (summary.windows[i]);
+	}
+
+	g_free (summary.windows);
+	os_version_top_k_free (summary.total);
+	g_strfreev (merge_paths);
+	g_free (output_path);
+
+	return status;
+}